@@ -0,0 +1,138 @@
+/**
+ * Lexer throughput benchmark.
+ *
+ * Generates two synthetic programs, one heavy on comments, indentation and
+ * string literals and one dense with operators and array literals, lexes
+ * each repeatedly with every available scanner and reports MB/s. A last
+ * row lexes into a token list on every core of the shared thread pool.
+ * Usage: build/bench_lexer [size_mb] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "core/tokenizer.h"
+#include "core/scan.h"
+#include "utils/thread_pool.h"
+
+static const char *TEXT_SAMPLE =
+	"# -------------------------------------------------------------------\n"
+	"# Section header comment describing the block below in some detail\n"
+	"# -------------------------------------------------------------------\n"
+	"keep greeting = \"Hello, this is a reasonably long string literal value\";\n"
+	"        total = total + 1;   // trailing comment after an assignment\n"
+	"do greet(name) {\n"
+	"                say(\"Greetings to everybody reading this benchmark\");\n"
+	"}\n"
+	"when (total > 10) { say(\"big\"); } else { say(\"small\"); }\n"
+	"\n\n\n";
+
+static const char *OPERATOR_SAMPLE =
+	"x=(a+b)*c-d/e;y=[1,2,3,4,5,6,7,8];z=y[3]+x*(x-1);when(z==x){say(z);}\n"
+	"t=a*b+c*d-e/f;u=[a,b,c,d];v=u[0]+u[1]*u[2]-u[3];w=(v>t);q=(v<t);\n";
+
+static char *generate_source(const char *sample, size_t target)
+{
+	size_t unit = strlen(sample);
+	size_t copies = target / unit + 1;
+	char *source = malloc(copies * unit + 1);
+	if (!source)
+		return NULL;
+
+	for (size_t i = 0; i < copies; i++)
+		memcpy(source + i * unit, sample, unit);
+	source[copies * unit] = '\0';
+	return source;
+}
+
+static double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(JechScanMode requested, const char *source, size_t size, int iterations)
+{
+	JechScanMode mode = _JechScan_SetMode(requested);
+	if (mode != requested)
+	{
+		printf("%-8s unsupported on this CPU\n", _JechScan_ModeName(requested));
+		return;
+	}
+
+	double best = 0;
+	long tokens = 0;
+	for (int it = 0; it < iterations; it++)
+	{
+		JechLexer lexer;
+		_JechTokenizer_Init(&lexer, source);
+
+		double start = now_seconds();
+		tokens = 0;
+		while (_JechTokenizer_Next(&lexer).type != TOKEN_EOF)
+			tokens++;
+		double elapsed = now_seconds() - start;
+
+		double mbps = (size / (1024.0 * 1024.0)) / elapsed;
+		if (mbps > best)
+			best = mbps;
+	}
+
+	printf("%-8s %8.1f MB/s  (%ld tokens)\n", _JechScan_ModeName(mode), best, tokens);
+}
+
+static void run_parallel(const char *source, size_t size, int iterations)
+{
+	_JechScan_SetMode(JECH_SCAN_AUTO);
+	int threads = thread_pool_size(thread_pool_shared());
+
+	double best = 0;
+	long tokens = 0;
+	for (int it = 0; it < iterations; it++)
+	{
+		double start = now_seconds();
+		JechTokenList list = _JechTokenizer_LexParallel(source, threads * 4);
+		double elapsed = now_seconds() - start;
+
+		tokens = list.count - 1;
+		_JechTokenizer_Free(&list);
+
+		double mbps = (size / (1024.0 * 1024.0)) / elapsed;
+		if (mbps > best)
+			best = mbps;
+	}
+
+	printf("%-8s %8.1f MB/s  (%ld tokens, %d threads)\n", "parallel", best, tokens, threads);
+}
+
+static int bench_workload(const char *name, const char *sample, size_t size_mb, int iterations)
+{
+	char *source = generate_source(sample, size_mb * 1024 * 1024);
+	if (!source)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	size_t size = strlen(source);
+
+	printf("%s: lexing %.1f MB, best of %d runs\n", name, size / (1024.0 * 1024.0), iterations);
+	run(JECH_SCAN_SCALAR, source, size, iterations);
+	run(JECH_SCAN_SSE2, source, size, iterations);
+	run(JECH_SCAN_AVX2, source, size, iterations);
+	run_parallel(source, size, iterations);
+
+	free(source);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t size_mb = argc > 1 ? (size_t)atoi(argv[1]) : 32;
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+	if (bench_workload("text", TEXT_SAMPLE, size_mb, iterations))
+		return 1;
+	printf("\n");
+	return bench_workload("operators", OPERATOR_SAMPLE, size_mb, iterations);
+}
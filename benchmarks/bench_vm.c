@@ -0,0 +1,131 @@
+/**
+ * VM throughput benchmark.
+ *
+ * Generates two synthetic programs, one of arithmetic, output and
+ * comparisons on a few variables and one of function calls that keep and
+ * say their results, compiles each once and runs it repeatedly with the
+ * output discarded. Built with JECH_PROFILE=1 (build/bench_vm_profile) it
+ * also reports the dispatches of one run and its most frequent opcode
+ * pairs.
+ * Usage: build/bench_vm [units] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "core/tokenizer.h"
+#include "core/parser/parser.h"
+#include "core/bytecode.h"
+#include "core/vm.h"
+#include "core/flat_ast.h"
+#include "debug/debug_vm.h"
+#include "config.h"
+
+static const char *ARITHMETIC_PRELUDE =
+	"keep total = 0;\n"
+	"keep step = 3;\n"
+	"keep limit = 500;\n";
+
+static const char *ARITHMETIC_SAMPLE =
+	"total = total + step * 2;\n"
+	"say(total);\n"
+	"when (total * 2 > limit) { say(\"over\"); } else { say(\"under\"); }\n"
+	"total = total - step;\n";
+
+static const char *CALL_PRELUDE =
+	"keep total = 1;\n"
+	"do scale(v, k) { return v * k + 1; }\n"
+	"do report(v) { say(v); }\n";
+
+// %1$d numbers each copy, so every copy keeps new variables
+static const char *CALL_SAMPLE =
+	"keep r%1$d = scale(total, 2);\n"
+	"say(r%1$d + 1);\n"
+	"report(r%1$d);\n";
+
+static char *generate_source(const char *prelude, const char *sample, int units)
+{
+	size_t unit = strlen(sample) + 16;
+	size_t capacity = strlen(prelude) + unit * (size_t)units + 1;
+	char *source = malloc(capacity);
+	if (!source)
+		return NULL;
+
+	char *cursor = source + sprintf(source, "%s", prelude);
+	for (int i = 0; i < units; i++)
+		cursor += snprintf(cursor, capacity - (size_t)(cursor - source), sample, i);
+	return source;
+}
+
+static double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_workload(const char *name, const char *prelude, const char *sample, int units, int iterations)
+{
+	char *source = generate_source(prelude, sample, units);
+	FILE *sink = fopen("/dev/null", "w");
+	if (!source || !sink)
+	{
+		fprintf(stderr, "Cannot set up the %s workload\n", name);
+		free(source);
+		if (sink)
+			fclose(sink);
+		return 1;
+	}
+
+	JechTokenList tokens = _JechTokenizer_Lex(source);
+	JechFlatAST ast;
+	_JechFlatAST_Init(&ast);
+	_JechParser_ParseAll(&ast, &tokens);
+	int count = ast.root_count;
+	Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+	double best = 0;
+	FILE *console = stdout;
+	for (int it = 0; it < iterations; it++)
+	{
+		// The profile printed below is that of the last run
+		_JechVM_ClearState();
+		memset(_JechVM_Profile(), 0, sizeof(JechVMProfile));
+
+		stdout = sink;
+		double start = now_seconds();
+		_JechVM_Execute(&bc);
+		double elapsed = now_seconds() - start;
+		stdout = console;
+
+		if (best == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	printf("%s: %d statements, %d instructions, best of %d runs\n", name, count, bc.count, iterations);
+	printf("  %8.2f ms", best * 1000);
+	if (JECH_PROFILE)
+		printf("  (%llu dispatches per run)", _JechVM_Profile()->dispatches);
+	printf("\n");
+	fflush(stdout);
+	if (JECH_PROFILE)
+		debug_print_profile();
+
+	_JechBytecode_Free(&bc);
+	_JechFlatAST_Free(&ast);
+	_JechTokenizer_Free(&tokens);
+	fclose(sink);
+	free(source);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int units = argc > 1 ? atoi(argv[1]) : 50000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+	if (bench_workload("arithmetic", ARITHMETIC_PRELUDE, ARITHMETIC_SAMPLE, units, iterations))
+		return 1;
+	printf("\n");
+	return bench_workload("calls", CALL_PRELUDE, CALL_SAMPLE, units, iterations);
+}
@@ -5,4 +5,8 @@
 #define JECH_DEBUG 0
 #endif
 
+#ifndef JECH_PROFILE
+#define JECH_PROFILE 0
+#endif
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef JECH_AST_H
 #define JECH_AST_H
 
+#include <stdint.h>
 #include "constants.h"
 #include "tokenizer.h"
 
@@ -30,30 +31,9 @@ typedef enum
 } JechASTType;
 
 /**
- * Abstract Syntax Tree node (binary structure)
+ * Bits of JechFlatAST.flags
  */
-typedef struct JechASTNode
-{
-    JechASTType type;
-    char value[MAX_STRING];
-    char name[MAX_STRING];
-    JechTokenType token_type;
-
-    struct JechASTNode *left;
-    struct JechASTNode *right;
-    struct JechASTNode *else_branch;
-
-    struct JechASTNode **body; 
-    int body_count;
-
-    JechTokenType op;
-} JechASTNode;
-
-/**
- * AST helper functions
- */
-JechASTNode *_JechAST_CreateNode(JechASTType type, const char *value, const char *name, JechTokenType token_type);
-void _JechAST_Free(JechASTNode *node);
-void _JechAST_Print(const JechASTNode *node, int depth);
+#define JECH_AST_FLOAT 0x01 // number literal stored as a double
+#define JECH_AST_LAZY 0x02  // FUNCTION_DECL whose body is still source text
 
 #endif
@@ -1,6 +1,12 @@
 #ifndef JECH_BYTECODE_H
 #define JECH_BYTECODE_H
+#include <stddef.h>
+#include <stdint.h>
 #include "ast.h"
+#include "flat_ast.h"
+
+/** Most parameters a function declaration or call can carry */
+#define JECH_MAX_OPERANDS 8
 
 /**
  * Enum for bytecode operation types
@@ -24,43 +30,281 @@ typedef enum
 	OP_END
 } OpCode;
 
+#define JECH_OPCODE_COUNT (OP_END + 1)
+
 /**
- * Instruction structure used in bytecode
+ * Where OP_BIN_OP and OP_FUNCTION_CALL deliver their result. The compiler
+ * emits the defaults; the peephole pass rewrites an instruction followed
+ * by the one consuming its result into the direct forms, which run both
+ * in one dispatch. An OP_BIN_OP in a direct form also stores its result
+ * in `name` unless it is NULL.
+ */
+typedef enum
+{
+	JECH_TO_DEFAULT, // OP_BIN_OP: the variable `name`; OP_FUNCTION_CALL: nowhere
+	JECH_TO_SAY,     // OP_BIN_OP: print it
+	JECH_TO_RETURN,  // OP_BIN_OP: return it from the running body
+	JECH_TO_KEEP,    // OP_FUNCTION_CALL: keep the return value as `operand`
+	JECH_TO_WHEN     // OP_BIN_OP: say the `then` value if it is "true", else the `else` one
+} JechDestination;
+
+/**
+ * The VM's result register, which holds a value from one instruction to
+ * the next. It is written and read like a variable of this name; the
+ * peephole pass routes temporaries through it. Decoded as JECH_RESULT_SLOT.
+ */
+#define JECH_RESULT_REGISTER "__result"
+#define JECH_RESULT_SLOT UINT32_MAX
+
+/**
+ * One instruction in decoded form. The compiler fills one in and appends
+ * it with _JechBytecode_Emit; the VM reads it back with _JechBytecode_Decode.
+ * Only the fields `op` uses are meaningful, and decoded strings point into
+ * the chunk's constant pool.
  */
 typedef struct
 {
 	OpCode op;						// operation type: OP_SAY, OP_ASSIGN, etc.
-	char name[MAX_STRING];			// target variable name (for assign) or condition var
-	char operand[MAX_STRING];		// left operand or single value (then branch)
-	char operand_right[MAX_STRING]; // right operand (for BIN_OP) or say value in when
-	char else_operand[MAX_STRING];  // else branch value (for WHEN_BOOL)
+	const char *name;				// target variable name (for assign) or condition var
+	uint32_t slot;                  // chunk slot of `name` when it is a variable
+	const char *operand;			// left operand or single value (then branch)
+	const char *operand_right;		// right operand (for BIN_OP) or say value in when
+	const char *else_operand;		// else branch value (for WHEN_BOOL)
+	const char *then_operand;       // then branch value of a BIN_OP that branches
+	uint32_t operand_slot;          // slots of the values above that are identifiers
+	uint32_t operand_right_slot;
+	uint32_t else_slot;
+	uint32_t then_slot;
+	JechNumber operand_number;       // decoded `operand` when it is a number literal
+	JechNumber operand_right_number; // decoded `operand_right` when it is a number literal
 	JechTokenType bin_op;			// BIN_OP operator (+, -, ==, <, >)
 	JechTokenType token_type;		// then value type (say)
 	JechTokenType cmp_operand_type; // comparison operand type (STRING, NUMBER, IDENTIFIER)
 	JechTokenType else_token_type;  // else value type
+	JechTokenType then_token_type;  // then value type of a BIN_OP that branches
 	int has_else;                   // flag for else branch
-	char params[8][MAX_STRING];     // function parameters (for FUNCTION_DECL)
+	JechDestination dest;           // result of BIN_OP and FUNCTION_CALL
+	const char *params[JECH_MAX_OPERANDS]; // function parameters (for FUNCTION_DECL)
+	uint32_t param_slots[JECH_MAX_OPERANDS];
 	int param_count;                // number of parameters
-	char args[8][MAX_STRING];       // function arguments (for FUNCTION_CALL)
-	JechTokenType arg_types[8];     // argument types
+	const char *args[JECH_MAX_OPERANDS];   // function arguments (for FUNCTION_CALL)
+	JechTokenType arg_types[JECH_MAX_OPERANDS]; // argument types
+	uint32_t arg_slots[JECH_MAX_OPERANDS];
 	int arg_count;                  // number of arguments
 	struct Bytecode *body_bc;        // compiled function body (for FUNCTION_DECL)
-	int line;
-	int column;
+	const char *body_source;        // program text of a lazy body, or NULL
+	int body_offset;                // lazy body span within body_source
+	int body_length;
 } Instruction;
 
 /**
- * Bytecode structure containing an array of instructions
+ * A pooled constant: its NUL-terminated text, at `text` in the chunk's
+ * `strings`, and the number it decodes to when it is a number literal
+ */
+typedef struct
+{
+	uint32_t text;
+	JechNumber number;
+} JechConstant;
+
+/**
+ * Source offset of the statement whose code starts at `pc`
+ */
+typedef struct
+{
+	uint32_t pc;
+	int32_t offset;
+} JechLineEntry;
+
+/**
+ * A compiled chunk. `code` is a stream of one-byte opcodes, each followed
+ * by its operands as unsigned LEB128 varints: strings and numbers are
+ * indices into the constant pool, variables indices into `slots`, function
+ * bodies indices into `functions`. Slot 0 on the wire is the result
+ * register; variable slots are written one higher.
+ * Every buffer is heap-allocated; release them with _JechBytecode_Free.
  */
 typedef struct Bytecode
 {
-	Instruction instructions[128];
-	int count;
+	uint8_t *code;
+	int length;
+	int capacity;
+	int count; // number of instructions
+
+	JechConstant *constants;
+	int constant_count;
+	int constant_capacity;
+	char *strings; // text of every constant, back to back
+	int strings_length;
+	int strings_capacity;
+	int *lookup; // hash of constant indices, only while compiling
+	int lookup_capacity;
+
+	uint32_t *slots; // name constant of each variable slot
+	int slot_count;
+	int slot_capacity;
+	int *slot_lookup; // slot of each constant, or -1; only while compiling
+	int slot_lookup_capacity;
+	JechSymbol *links; // VM variable of each slot, set by _JechBytecode_Link
+
+	struct Bytecode **functions; // bodies of the functions this chunk declares
+	int function_count;
+	int function_capacity;
+
+	JechLineEntry *lines; // sorted by pc
+	int line_count;
+	int line_capacity;
+
+	const char *source; // program text lazy function bodies point into
+	int borrowed;       // code and tables point into a loaded image
+	int removed;        // instructions the peephole pass removed from the chunk
 } Bytecode;
 
 /**
- * Compiles the AST into bytecode
+ * Appends `inst` to the chunk, pooling its strings and numbers. NULL
+ * strings are stored as "".
+ */
+void _JechBytecode_Emit(Bytecode *bc, const Instruction *inst);
+
+/**
+ * Attributes the code emitted from here on to the statement at `offset`
+ */
+void _JechBytecode_SetOffset(Bytecode *bc, int offset);
+
+/**
+ * Drops the state only needed while emitting, once the chunk is complete
+ */
+void _JechBytecode_Finish(Bytecode *bc);
+
+/**
+ * Binds the chunk's variable slots, and those of the function bodies it
+ * declares, to the VM's variables (interned symbols). The compile entry
+ * points link what they return; call it on the main thread.
+ */
+void _JechBytecode_Link(Bytecode *bc);
+
+/**
+ * Decodes the instruction at `pc` into `out`; returns the pc of the next
+ * instruction
+ */
+int _JechBytecode_Decode(const Bytecode *bc, int pc, Instruction *out);
+
+/*
+ * Operand readers, each advancing `pc` past what it reads. The VM reads
+ * only the operands of the instruction it is running, in the case that
+ * runs it, rather than filling a whole Instruction; _JechBytecode_Decode
+ * is built on the same readers.
+ */
+
+static inline uint32_t _JechBytecode_ReadVarint(const Bytecode *bc, int *pc)
+{
+	uint32_t value = 0;
+	int shift = 0;
+	uint8_t byte;
+	do
+	{
+		byte = bc->code[(*pc)++];
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	return value;
+}
+
+static inline const JechConstant *_JechBytecode_ReadConstant(const Bytecode *bc, int *pc)
+{
+	return &bc->constants[_JechBytecode_ReadVarint(bc, pc)];
+}
+
+static inline const char *_JechBytecode_Text(const Bytecode *bc, const JechConstant *constant)
+{
+	return bc->strings + constant->text;
+}
+
+static inline const char *_JechBytecode_ReadString(const Bytecode *bc, int *pc)
+{
+	return _JechBytecode_Text(bc, _JechBytecode_ReadConstant(bc, pc));
+}
+
+/**
+ * A variable's slot, or JECH_RESULT_SLOT
+ */
+static inline uint32_t _JechBytecode_ReadSlot(const Bytecode *bc, int *pc)
+{
+	uint32_t encoded = _JechBytecode_ReadVarint(bc, pc);
+	return encoded ? encoded - 1 : JECH_RESULT_SLOT;
+}
+
+/**
+ * A typed value: sets `slot` for an identifier and `constant` for a
+ * literal, and returns the type
+ */
+static inline JechTokenType _JechBytecode_ReadValue(const Bytecode *bc, int *pc, uint32_t *slot,
+													const JechConstant **constant)
+{
+	JechTokenType type = (JechTokenType)_JechBytecode_ReadVarint(bc, pc);
+	if (type == TOKEN_IDENTIFIER)
+		*slot = _JechBytecode_ReadSlot(bc, pc);
+	else
+		*constant = _JechBytecode_ReadConstant(bc, pc);
+	return type;
+}
+
+/**
+ * Name of the variable in `slot`, or JECH_RESULT_REGISTER
+ */
+const char *_JechBytecode_SlotName(const Bytecode *bc, uint32_t slot);
+
+/**
+ * Checks a chunk read from outside, and the bodies it declares, before it
+ * is decoded: every table index, every operand of every instruction and
+ * every lazy body span, against a program text of `source_length` bytes.
+ * _JechBytecode_Decode trusts all of them. Returns 0 on the first bad one.
+ */
+int _JechBytecode_Verify(const Bytecode *bc, size_t source_length);
+
+/**
+ * Source offset of the statement the instruction at `pc` belongs to, or -1
+ */
+int _JechBytecode_OffsetAt(const Bytecode *bc, int pc);
+
+/**
+ * Bytes held by the chunk itself, excluding the function bodies it declares
+ */
+size_t _JechBytecode_Size(const Bytecode *bc);
+
+/**
+ * Releases the chunk's buffers, except those borrowed from an image. The
+ * function bodies it declares stay alive: the VM keeps calling them after
+ * the declaring chunk has run.
+ */
+void _JechBytecode_Free(Bytecode *bc);
+
+/**
+ * Compiles the AST's roots into bytecode; release it with _JechBytecode_Free.
+ * An AST with many parsed function bodies, as `--compile` and the REPL
+ * produce, is handed to _JechBytecode_CompileAllParallel.
+ */
+Bytecode _JechBytecode_CompileAll(const JechFlatAST *ast);
+
+/**
+ * Compiles like _JechBytecode_CompileAll, but compiles every parsed
+ * function body as its own job on the shared thread pool first. The
+ * bytecode is identical; only the compile time changes.
+ */
+Bytecode _JechBytecode_CompileAllParallel(const JechFlatAST *ast);
+
+/**
+ * Compiles the roots of `count` ASTs, in order, as a single program; a
+ * document keeps one AST per statement
+ */
+Bytecode _JechBytecode_CompileParts(JechFlatAST **parts, int count);
+
+/**
+ * Parses and compiles the function body at source[offset, offset + length).
+ * Used on the first call of a function whose body was left lazy; offsets in
+ * diagnostics stay relative to `source`. Returns a malloc'd Bytecode, or
+ * NULL when the body is empty.
  */
-Bytecode _JechBytecode_CompileAll(JechASTNode **roots, int count);
+Bytecode *_JechBytecode_CompileBody(const char *source, int offset, int length);
 
 #endif
\ No newline at end of file
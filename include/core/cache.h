@@ -0,0 +1,43 @@
+#ifndef JECH_CACHE_H
+#define JECH_CACHE_H
+
+#include <stddef.h>
+#include "core/bytecode.h"
+#include "utils/read_file.h"
+
+/**
+ * A program loaded from the bytecode cache. Its bytecode borrows from the
+ * mapped image, which stays mapped until _JechCache_Release.
+ */
+typedef struct
+{
+    Bytecode bytecode;
+    JechSourceFile image;
+} JechCacheEntry;
+
+/**
+ * Writes the cache directory into `path` and returns 1, or returns 0 when
+ * caching is off. It is $JECH_CACHE_DIR, or $XDG_CACHE_HOME/jech, or
+ * $HOME/.cache/jech; an empty JECH_CACHE_DIR turns caching off.
+ */
+int _JechCache_Directory(char *path, size_t size);
+
+/**
+ * Loads the cached image of the program `source[0, length)`, keyed by its
+ * content hash. Returns 0 on a miss or an unusable image.
+ */
+int _JechCache_Load(const char *source, size_t length, JechCacheEntry *entry);
+
+/**
+ * Saves the compiled program as `<hash>.jcb` in the cache directory. The
+ * file is written under a temporary name and renamed, so processes running
+ * the same script never see a partial image. Failures are ignored.
+ */
+void _JechCache_Store(const char *source, size_t length, const Bytecode *bc);
+
+/**
+ * Frees a loaded program and unmaps its image
+ */
+void _JechCache_Release(JechCacheEntry *entry);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef JECH_DOCUMENT_H
+#define JECH_DOCUMENT_H
+
+#include "core/tokenizer.h"
+#include "core/flat_ast.h"
+#include "errors/error.h"
+
+/**
+ * An editable source buffer that keeps its token stream and parsed
+ * statements up to date incrementally. Each edit re-lexes only the damaged
+ * region (until the new tokens resynchronise with the old ones) and
+ * re-parses only the top-level statements those tokens belong to.
+ *
+ * Tokens are slices of `text`, so they stay valid until the next edit.
+ * Each statement's nodes live in its own AST and are released with it.
+ */
+
+/**
+ * A top-level statement window: the token range the statement parsers saw
+ * and the nodes they produced from it
+ */
+typedef struct
+{
+	int first_token;
+	int token_count;
+	JechFlatAST ast; // its roots are the statement's top-level nodes
+	int ok;
+	JechDiagnostics diagnostics; // parse errors, offsets from the first token
+} JechDocStatement;
+
+typedef struct
+{
+	char *text;
+	int length;
+	int capacity;
+
+	JechTokenList tokens; // whole document, always ending with TOKEN_EOF
+
+	JechDocStatement *statements;
+	int statement_count;
+	int statement_capacity;
+
+	JechTokenList window; // scratch window handed to the statement parsers
+
+	// Work done by the last init or edit
+	int relexed_tokens;
+	int reparsed_statements;
+} JechDocument;
+
+/**
+ * Loads `source` into a new document, lexing and parsing it in full.
+ * Returns 0 if out of memory.
+ */
+int _JechDocument_Init(JechDocument *doc, const char *source);
+
+/**
+ * Replaces `removed` bytes at `offset` with `inserted_length` bytes of
+ * `inserted`, then brings tokens and statements up to date.
+ * Returns 0 if the range is invalid or memory runs out.
+ */
+int _JechDocument_Edit(JechDocument *doc, int offset, int removed, const char *inserted, int inserted_length);
+
+/**
+ * Collects the ASTs of the statements before the first that failed to
+ * parse, in order, for _JechBytecode_CompileParts. The array is the
+ * caller's to free; the ASTs remain owned by the document. `out_failed`
+ * is set to 1 if any statement failed.
+ */
+JechFlatAST **_JechDocument_Parts(const JechDocument *doc, int *out_count, int *out_failed);
+
+/**
+ * Prints the parse errors of every statement up to the first that failed,
+ * as a full parse of the text would. Statements keep their errors, so
+ * this reports them again however many edits ago they were parsed.
+ */
+void _JechDocument_Report(const JechDocument *doc);
+
+/**
+ * Releases the text, tokens and AST nodes held by the document
+ */
+void _JechDocument_Free(JechDocument *doc);
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef JECH_FLAT_AST_H
+#define JECH_FLAT_AST_H
+
+#include <stdint.h>
+#include "core/ast.h"
+
+/**
+ * Index of a node in a JechFlatAST
+ */
+typedef uint32_t JechNodeId;
+
+#define JECH_NO_NODE ((JechNodeId)0xFFFFFFFFu)
+
+// A node value with no text
+#define JECH_NO_TEXT ((uint32_t)0xFFFFFFFFu)
+
+/**
+ * The AST stored as parallel columns indexed by node id (structure of
+ * arrays). The parser appends nodes as it builds them, so children come
+ * before the operators that combine them, and children are ids rather
+ * than pointers: a program is a handful of contiguous arrays that can be
+ * walked, copied or written out as they are.
+ *
+ * Top-level statements are listed in `roots`. Each function body is one
+ * contiguous run of `lists`. A lazy function body has no nodes; its
+ * payload packs the body's offset and length in `source` instead.
+ *
+ * Names are identifiers and are interned as symbols. Values can be any
+ * literal, so their text is copied into `text` and freed with the AST:
+ * a long-lived process that keeps reparsing (the REPL, an edited
+ * document) would otherwise grow the global symbol table forever.
+ */
+typedef struct
+{
+    int count;
+    int capacity;
+
+    // Columns share one allocation, owned through `payload`
+    int64_t *payload;    // number literal; FUNCTION_DECL: body length
+                         // (lazy: offset | length << 32)
+    uint32_t *value;     // offset of the node's text in `text`, or JECH_NO_TEXT
+    JechSymbol *name;
+    JechNodeId *left;
+    JechNodeId *right;
+    JechNodeId *extra;   // WHEN: else branch; FUNCTION_DECL: body start in `lists`
+    int32_t *offset;     // source offset of a statement's first token, or -1
+    uint8_t *type;       // JechASTType
+    uint8_t *token_type; // JechTokenType
+    uint8_t *op;         // JechTokenType
+    uint8_t *flags;      // JECH_AST_FLOAT, JECH_AST_LAZY
+
+    JechNodeId *lists;
+    int list_count;
+    int list_capacity;
+
+    JechNodeId *roots;
+    int root_count;
+    int root_capacity;
+
+    char *text; // NUL-terminated value strings
+    int text_length;
+    int text_capacity;
+
+    const char *source; // program text lazy bodies point into, or NULL
+} JechFlatAST;
+
+/**
+ * Starts an empty AST
+ */
+void _JechFlatAST_Init(JechFlatAST *ast);
+
+/**
+ * Appends a node with no value, name or children and returns its id.
+ * Growth failure is fatal, so building never fails.
+ */
+JechNodeId _JechFlatAST_AddNode(JechFlatAST *ast, JechASTType type, JechTokenType token_type);
+
+/**
+ * Appends a node whose value and name are taken from token slices; either
+ * token may be NULL. A number token's decoded value is kept as well.
+ */
+JechNodeId _JechFlatAST_AddTokenNode(JechFlatAST *ast, JechASTType type, const JechToken *value, const JechToken *name, JechTokenType token_type);
+
+/**
+ * Appends a top-level statement to `roots`
+ */
+void _JechFlatAST_AddRoot(JechFlatAST *ast, JechNodeId id);
+
+/**
+ * Stores `count` statements as the body of the FUNCTION_DECL at `id`
+ */
+void _JechFlatAST_SetBody(JechFlatAST *ast, JechNodeId id, const JechNodeId *statements, int count);
+
+/**
+ * Marks the FUNCTION_DECL at `id` lazy, its body being `length` bytes at
+ * `offset` in `source`. Every lazy body of an AST shares one `source`.
+ */
+void _JechFlatAST_SetLazyBody(JechFlatAST *ast, JechNodeId id, const char *source, int offset, int length);
+
+/**
+ * Sets the name of the node at `id` to the symbol of the `name` token, or
+ * clears it when `name` is NULL. Every name is resolved here, so a name is
+ * stored under the same symbol the lexer gave it.
+ */
+void _JechFlatAST_SetName(JechFlatAST *ast, JechNodeId id, const JechToken *name);
+
+/**
+ * Copies `text` into the AST as the value of the node at `id`
+ */
+void _JechFlatAST_SetValue(JechFlatAST *ast, JechNodeId id, const char *text);
+
+/**
+ * Stores `number` as the decoded value of the node at `id`
+ */
+void _JechFlatAST_SetNumber(JechFlatAST *ast, JechNodeId id, JechNumber number);
+
+/**
+ * String and number accessors; strings are "" when empty
+ */
+const char *_JechFlatAST_Value(const JechFlatAST *ast, JechNodeId id);
+const char *_JechFlatAST_Name(const JechFlatAST *ast, JechNodeId id);
+JechNumber _JechFlatAST_Number(const JechFlatAST *ast, JechNodeId id);
+
+/**
+ * Statements of a FUNCTION_DECL body, as a run of `lists`
+ */
+const JechNodeId *_JechFlatAST_Body(const JechFlatAST *ast, JechNodeId id, int *out_count);
+
+/**
+ * Returns 1 if the FUNCTION_DECL at `id` is lazy, with its body's source
+ * offset and length
+ */
+int _JechFlatAST_LazyBody(const JechFlatAST *ast, JechNodeId id, int *out_offset, int *out_length);
+
+/**
+ * Prints the subtree at `id` indented according to depth
+ */
+void _JechFlatAST_Print(const JechFlatAST *ast, JechNodeId id, int depth);
+
+void _JechFlatAST_Free(JechFlatAST *ast);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef JECH_IMAGE_H
+#define JECH_IMAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "core/bytecode.h"
+
+#define JECH_IMAGE_MAGIC "JCB"
+#define JECH_IMAGE_VERSION 5
+
+/**
+ * Start of a serialised bytecode image (.jcb). `source_hash` and
+ * `source_length` identify the program text the image was compiled from.
+ * The start offsets of its `line_count` lines follow, so diagnostics can
+ * give line numbers without the text, then the text itself, so a cached
+ * image is only used for the exact program it was compiled from, then the
+ * chunks: the top-level chunk first, each chunk followed by the bodies it
+ * declares.
+ */
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint32_t line_count;
+    uint32_t reserved;
+} JechImageHeader;
+
+/**
+ * 64-bit FNV-1a hash of a program text, the key of its cached image. It
+ * only names the cache file; loading compares the text itself.
+ */
+uint64_t _JechImage_Hash(const char *source, size_t length);
+
+/**
+ * Writes `bc`, compiled from the NUL-terminated `source[0, length)`, and
+ * every function body it declares as an image. Returns 0 on a write error.
+ */
+int _JechImage_Write(FILE *out, const Bytecode *bc, const char *source, size_t length);
+
+/**
+ * Returns the header of the image in data[0, length), or NULL if it is
+ * not an image of this version
+ */
+const JechImageHeader *_JechImage_Header(const void *data, size_t length);
+
+/**
+ * Loads the image in data[0, length) into `out` without copying: code,
+ * constants and tables point into `data`, which must stay mapped while
+ * the program runs. Given `source[0, source_length)`, the image is
+ * rejected unless it was compiled from exactly that text, and lazy bodies
+ * are compiled from it. When `source` is NULL, diagnostics use the
+ * image's line table instead, and an image with lazy bodies is rejected.
+ * Every operand is checked before anything runs; returns 0 if the image
+ * is truncated or malformed.
+ */
+int _JechImage_Load(const void *data, size_t length, const char *source, size_t source_length, Bytecode *out);
+
+#endif
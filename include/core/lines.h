@@ -0,0 +1,54 @@
+#ifndef JECH_LINES_H
+#define JECH_LINES_H
+
+/**
+ * Maps byte offsets in a source text to line and column numbers.
+ *
+ * Tokens and instructions only record the byte offset where they start;
+ * the line index is built on demand, when a diagnostic or debug dump first
+ * needs a line number, and answers each lookup with a binary search.
+ */
+typedef struct
+{
+	const char *text;
+	int length;
+	int *starts; // offset of the first byte of every line, ascending
+	int count;
+} JechLineIndex;
+
+/**
+ * Indexes the line starts of the NUL-terminated `text`.
+ * Returns 0 if out of memory.
+ */
+int _JechLineIndex_Build(JechLineIndex *index, const char *text);
+
+/**
+ * Converts `offset` to a 1-based line and column. Offsets outside the
+ * text resolve to line 0, column 0.
+ */
+void _JechLineIndex_Locate(const JechLineIndex *index, int offset, int *line, int *column);
+
+/**
+ * Releases the memory held by the index
+ */
+void _JechLineIndex_Free(JechLineIndex *index);
+
+/**
+ * Sets the text that diagnostic offsets refer to. Its index is rebuilt
+ * lazily on the next _JechLines_Locate; NULL forgets the current text.
+ */
+void _JechLines_SetSource(const char *text);
+
+/**
+ * Locates diagnostic offsets with a copy of a prebuilt index (`count` line
+ * starts of a `length`-byte text), for code whose source is not loaded.
+ * Returns 0 if out of memory.
+ */
+int _JechLines_SetIndex(const int *starts, int count, int length);
+
+/**
+ * Converts an offset in the diagnostic source to a line and column
+ */
+void _JechLines_Locate(int offset, int *line, int *column);
+
+#endif
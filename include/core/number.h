@@ -0,0 +1,26 @@
+#ifndef JECH_NUMBER_H
+#define JECH_NUMBER_H
+
+#include <stdint.h>
+
+/**
+ * A numeric literal decoded by the lexer. Integer literals that fit in 64
+ * bits stay exact; literals with a fraction, or too large for int64, are
+ * stored as doubles.
+ */
+typedef struct
+{
+	int is_float;
+	union
+	{
+		int64_t i;
+		double f;
+	} as;
+} JechNumber;
+
+/**
+ * Value of a decoded number literal as a double
+ */
+double _JechNumber_AsDouble(const JechNumber *number);
+
+#endif
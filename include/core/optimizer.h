@@ -0,0 +1,19 @@
+#ifndef JECH_OPTIMIZER_H
+#define JECH_OPTIMIZER_H
+
+#include "core/flat_ast.h"
+
+/**
+ * Optimises a parsed program in place before compilation, including the
+ * bodies of functions parsed eagerly:
+ *
+ * - expressions whose operands are all literals are folded into a single
+ *   literal, computed exactly as OP_BIN_OP would at run time
+ * - `when` statements with a constant condition are replaced by the branch
+ *   that runs, or removed when no branch runs
+ *
+ * Removed statements are compacted out of the roots and body lists.
+ */
+void _JechOptimizer_Run(JechFlatAST *ast);
+
+#endif
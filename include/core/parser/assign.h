@@ -2,8 +2,8 @@
 #define JECH_PARSER_ASSIGN_H
 
 #include "core/tokenizer.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
 
-JechASTNode *parse_assign(const JechToken *t, int remaining_tokens, int *out_consumed);
+JechNodeId parse_assign(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed);
 
 #endif
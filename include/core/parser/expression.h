@@ -0,0 +1,32 @@
+#ifndef PARSER_EXPRESSION_H
+#define PARSER_EXPRESSION_H
+
+#include "core/flat_ast.h"
+#include "core/tokenizer.h"
+
+/**
+ * Parses an expression by precedence climbing. Comparisons (==, <, >) bind
+ * loosest, then + and -, then * and /; operators are left-associative and
+ * parentheses group. Leaves are identifier, number, string and bool nodes;
+ * operators become nested JECH_AST_BIN_OP nodes.
+ */
+JechNodeId parse_expression(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed);
+
+/**
+ * Returns 1 if a token of this type can begin an expression
+ */
+int is_expression_start(JechTokenType type);
+
+/**
+ * Returns 1 for the value nodes parse_expression produces as leaves
+ */
+int is_expression_leaf(const JechFlatAST *ast, JechNodeId node);
+
+/**
+ * Builds a statement node of `type` holding `value`. A leaf is retyped in
+ * place, keeping its value and token type; an operator tree becomes the
+ * new node's `left`. `name` (may be NULL) becomes the node's name.
+ */
+JechNodeId wrap_expression(JechFlatAST *ast, JechASTType type, JechNodeId value, const JechToken *name);
+
+#endif
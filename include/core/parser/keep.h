@@ -2,8 +2,8 @@
 #define PARSER_KEEP_H
 
 #include "core/tokenizer.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
 
-JechASTNode *parse_keep(const JechToken *t, int remaining_tokens, int *out_consumed);
+JechNodeId parse_keep(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed);
 
 #endif
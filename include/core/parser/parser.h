@@ -1,11 +1,67 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include "core/ast.h"
+#include "core/flat_ast.h"
 
 /**
- * Convert token list into an Abstract Syntax Tree (AST).
+ * Convert token list into an Abstract Syntax Tree (AST), appending its
+ * statements to `ast`'s roots. Parsing stops at the first error.
  */
-JechASTNode **_JechParser_ParseAll(const JechTokenList *tokens, int *out_count);
+void _JechParser_ParseAll(JechFlatAST *ast, const JechTokenList *tokens);
+
+/**
+ * Parse the statements in tokens[begin, end) without copying them. The
+ * token at `end` must be readable and is treated as the terminator.
+ * Returns the statements as an array for the caller to free.
+ */
+JechNodeId *_JechParser_ParseSpan(JechFlatAST *ast, const JechToken *tokens, int begin, int end, int *out_count);
+
+/**
+ * Parse a program pulled statement by statement from a streaming lexer,
+ * holding only the current statement's tokens in memory. The statements
+ * are appended to `ast`'s roots.
+ */
+void _JechParser_ParseStream(JechFlatAST *ast, JechLexer *lexer);
+
+/**
+ * Parse a single statement at `t`; returns JECH_NO_NODE at EOF or on error.
+ */
+JechNodeId _JechParser_ParseStatement(JechFlatAST *ast, const JechToken *t, int remaining, int *out_consumed);
+
+/**
+ * When enabled, function declarations keep their body as a span of the
+ * source (JECH_AST_LAZY) instead of parsing it. The source must outlive
+ * the program. Returns the previous setting.
+ */
+int _JechParser_SetLazyBodies(int enabled);
+
+/**
+ * Tracks brackets while looking for the end of a top-level statement
+ */
+typedef struct
+{
+	int depth;
+	int is_block;
+	int count;
+} JechStatementScan;
+
+typedef enum
+{
+	JECH_STMT_CONTINUE,
+	JECH_STMT_END,
+	JECH_STMT_END_UNLESS_ELSE
+} JechStatementStep;
+
+/**
+ * Feed the next token of a statement; reports whether the statement ends
+ * here. Start each statement with a zeroed JechStatementScan.
+ */
+JechStatementStep _JechParser_ScanStatement(JechStatementScan *scan, const JechToken *token);
+
+/**
+ * Append the EOF token and lookahead padding that statement parsers
+ * expect after a statement window.
+ */
+int _JechParser_TerminateWindow(JechTokenList *window);
 
 #endif
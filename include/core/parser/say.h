@@ -1,5 +1,5 @@
 #pragma once
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/tokenizer.h"
 
-JechASTNode *parse_say(const JechToken *t, int remaining_tokens, int *out_consumed);
+JechNodeId parse_say(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed);
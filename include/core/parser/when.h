@@ -1,9 +1,9 @@
 #ifndef PARSER_WHEN_H
 #define PARSER_WHEN_H
 
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/tokenizer.h"
 
-JechASTNode *parse_when(const JechToken *t, int remaining_tokens);
+JechNodeId parse_when(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed);
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef JECH_PEEPHOLE_H
+#define JECH_PEEPHOLE_H
+
+#include "core/bytecode.h"
+
+/**
+ * Rewrites a complete chunk in place, looking at each instruction together
+ * with the next one:
+ *
+ * - an OP_BIN_OP whose result the next OP_SAY, OP_RETURN or OP_WHEN_BOOL
+ *   reads becomes one OP_BIN_OP that says, returns or branches on it, and
+ *   still stores it unless it went to a temporary
+ * - an OP_FUNCTION_CALL followed by `keep x = __last_return__` becomes a
+ *   call that keeps its return value
+ * - a temporary only read by the next OP_BIN_OP goes through the result
+ *   register instead of a variable
+ * - an OP_ASSIGN of a literal that the next OP_ASSIGN overwrites is dropped
+ *
+ * Temporaries are the `__t<n>` variables the compiler introduces; each is
+ * read once, by the instruction that consumes the expression. Returns the
+ * number of instructions removed, also kept in the chunk's `removed`.
+ * Function bodies are rewritten when they are compiled, not here.
+ */
+int _JechPeephole_Run(Bytecode *bc);
+
+/**
+ * Instructions the pass removed from the chunk and the function bodies
+ * compiled so far
+ */
+int _JechPeephole_Removed(const Bytecode *bc);
+
+#endif
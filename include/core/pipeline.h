@@ -4,6 +4,7 @@
 #include "core/tokenizer.h"
 #include "core/parser/parser.h"
 #include "core/bytecode.h"
+#include "utils/read_file.h"
 
 /**
  * Check if the file name has a .jc extension
@@ -11,13 +12,26 @@
 int is_valid_extension(const char *filename);
 
 /**
- * Handles file read error and displays appropriate message
+ * Loads a source file (memory-mapped when possible); exits with a message
+ * if it cannot be read. Release it with unmap_file_content.
  */
-char *load_source_file(const char *filename);
+JechSourceFile load_source_file(const char *filename);
 
 /**
  * Executes the complete JECH language pipeline
  */
 void run_pipeline(const char *source);
 
+/**
+ * Executes a program file, reusing its compiled image from the bytecode
+ * cache (see core/cache.h) when the text is unchanged
+ */
+void run_cached_pipeline(const char *source, size_t length);
+
+/**
+ * Compiles a program into a bytecode image at `output` that build/jech-run
+ * executes without the compiler. Returns 0 on failure.
+ */
+int compile_pipeline(const char *source, size_t length, const char *output);
+
 #endif
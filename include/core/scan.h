@@ -0,0 +1,54 @@
+#ifndef JECH_SCAN_H
+#define JECH_SCAN_H
+
+/**
+ * Byte scanners used by the lexer's hot loops. Each one returns a pointer
+ * to the first byte that stops the scan; the NUL terminator always stops.
+ *
+ * On x86 the scanners compare 16 (SSE2) or 32 (AVX2) bytes at a time,
+ * chosen at runtime, with a portable scalar fallback elsewhere.
+ */
+
+typedef enum
+{
+	JECH_SCAN_AUTO,
+	JECH_SCAN_SCALAR,
+	JECH_SCAN_SSE2,
+	JECH_SCAN_AVX2
+} JechScanMode;
+
+/**
+ * First byte that is not whitespace (space, \t, \n, \v, \f, \r)
+ */
+const char *_JechScan_SkipSpaces(const char *p);
+
+/**
+ * First '\n' or NUL (end of a line comment)
+ */
+const char *_JechScan_FindLineEnd(const char *p);
+
+/**
+ * First '"', '\n' or NUL (inside a string literal)
+ */
+const char *_JechScan_FindStringStop(const char *p);
+
+/**
+ * Selects the scanner implementation. JECH_SCAN_AUTO picks the widest one
+ * the CPU supports; requesting an unsupported mode falls back to AUTO.
+ * Returns the mode actually in use.
+ */
+JechScanMode _JechScan_SetMode(JechScanMode mode);
+
+/**
+ * Returns the mode in use, installing AUTO's scanners if none were chosen
+ * yet. The first scan does that lazily, so code that hands scanning to
+ * pool workers calls this beforehand on its own thread.
+ */
+JechScanMode _JechScan_Mode();
+
+/**
+ * Human-readable name of a scan mode
+ */
+const char *_JechScan_ModeName(JechScanMode mode);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef JECH_SYMBOL_H
+#define JECH_SYMBOL_H
+
+#include <stdint.h>
+
+/**
+ * Interned name identifier. Equal names always map to the same id, so
+ * later stages can compare and index names by id instead of by string.
+ */
+typedef uint32_t JechSymbol;
+
+#define JECH_NO_SYMBOL ((JechSymbol)0xFFFFFFFFu)
+
+/**
+ * Returns the id for `name[0..length)`, interning it on first sight.
+ * Ids are dense (0, 1, 2, ...) and stable for the lifetime of the process.
+ */
+JechSymbol _JechSymbol_Intern(const char *name, int length);
+
+/**
+ * Hash used by the symbol table. It is pure, so it may be computed on any
+ * thread and passed to _JechSymbol_InternHashed later.
+ */
+uint32_t _JechSymbol_Hash(const char *name, int length);
+
+/**
+ * Same as _JechSymbol_Intern with a precomputed _JechSymbol_Hash. Interning
+ * itself is not thread-safe.
+ */
+JechSymbol _JechSymbol_InternHashed(const char *name, int length, uint32_t hash);
+
+/**
+ * Returns the NUL-terminated name of an interned symbol, or "" if unknown
+ */
+const char *_JechSymbol_Name(JechSymbol symbol);
+
+/**
+ * Returns the number of interned symbols
+ */
+int _JechSymbol_Count();
+
+#endif
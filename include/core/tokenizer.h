@@ -1,6 +1,9 @@
 #ifndef JECH_TOKENIZER_H
 #define JECH_TOKENIZER_H
 
+#include "symbol.h"
+#include "number.h"
+
 /**
  * Token types used in the lexical analysis phase
  */
@@ -49,29 +52,109 @@ typedef enum
 
 /**
  * Token structure with type and value
+ *
+ * The value is a slice of the source buffer (`start`, `length`) and is not
+ * NUL-terminated: the source must outlive every token lexed from it.
+ * String literals exclude the surrounding quotes. `offset` is the byte
+ * offset where the token begins in the source (the opening quote for
+ * strings); a JechLineIndex turns it into a line and column when needed.
+ * Identifiers carry their interned symbol id; every other token has
+ * JECH_NO_SYMBOL. Number tokens carry their decoded value in `number`.
  */
 typedef struct
 {
 	JechTokenType type;
-	char value[256];
-	int line;
-	int column;
+	int length;
+	const char *start;
+	int offset;
+	JechSymbol symbol;
+	JechNumber number;
 } JechToken;
 
-#define JECH_MAX_TOKENS 2048
-
 /**
- * List of tokens generated by the lexer
+ * List of tokens generated by the lexer (heap-allocated, grows on demand)
  */
 typedef struct
 {
-	JechToken tokens[JECH_MAX_TOKENS];
+	JechToken *tokens;
 	int count;
+	int capacity;
 } JechTokenList;
 
 /**
- * Lexical analysis function – converts source code to a token list
+ * Streaming lexer state: yields one token per call to _JechTokenizer_Next
+ * so callers can consume arbitrarily large sources in constant memory.
+ *
+ * A speculative lexer may start anywhere in the source and has no side
+ * effects: identifiers carry their _JechSymbol_Hash in `symbol` instead of
+ * an interned id, unknown characters are not reported, and an unterminated
+ * string yields a TOKEN_UNKNOWN for its opening quote instead of exiting.
+ *
+ * A lexer set up by _JechTokenizer_InitParallel replays `tokens`, lexed up
+ * front, instead of scanning from `p`.
+ */
+typedef struct
+{
+	const char *source;
+	const char *p;
+	int speculative;
+	const JechToken *tokens;
+	int next;
+} JechLexer;
+
+/**
+ * Prepares a lexer positioned at the start of `source` and makes `source`
+ * the text that diagnostic offsets refer to
+ */
+void _JechTokenizer_Init(JechLexer *lexer, const char *source);
+
+/**
+ * Like _JechTokenizer_Init, but a source large enough for
+ * _JechTokenizer_Lex to split is lexed in parallel into `tokens` first and
+ * the lexer replays them. Identifiers are interned and lexing errors
+ * reported as each token is handed out, in the order the sequential lexer
+ * would have. Release `tokens` with _JechTokenizer_Free once the lexer is
+ * done.
+ */
+void _JechTokenizer_InitParallel(JechLexer *lexer, const char *source, JechTokenList *tokens);
+
+/**
+ * Returns the next token; keeps returning TOKEN_EOF at the end of input
+ */
+JechToken _JechTokenizer_Next(JechLexer *lexer);
+
+/**
+ * Lexical analysis function – converts source code to a token list.
+ * The list must be released with _JechTokenizer_Free.
  */
 JechTokenList _JechTokenizer_Lex(const char *source);
 
+/**
+ * Lexes the source in up to `chunk_count` pieces split at newlines, on the
+ * shared thread pool, and merges them into the token list _JechTokenizer_Lex
+ * would have produced. _JechTokenizer_Lex uses this on large sources.
+ */
+JechTokenList _JechTokenizer_LexParallel(const char *source, int chunk_count);
+
+/**
+ * Appends a token to the list, growing it as needed. Returns 0 on failure.
+ */
+int _JechTokenizer_Push(JechTokenList *list, JechToken token);
+
+/**
+ * Releases the memory held by a token list
+ */
+void _JechTokenizer_Free(JechTokenList *list);
+
+/**
+ * Returns 1 if the token text is exactly `text`, 0 otherwise
+ */
+int _JechToken_Equals(const JechToken *token, const char *text);
+
+/**
+ * Copies the token text into `buffer` as a NUL-terminated string,
+ * truncating to `size - 1` characters. Returns the number of bytes copied.
+ */
+int _JechToken_CopyValue(const JechToken *token, char *buffer, int size);
+
 #endif
@@ -25,9 +25,38 @@ void _JechVM_Execute(const Bytecode *bc);
  */
 void _JechVM_ClearState();
 
+/**
+ * Compiles a lazy function body; see _JechBytecode_CompileBody
+ */
+typedef Bytecode *(*JechBodyCompiler)(const char *source, int offset, int length);
+
+/**
+ * Sets how the VM compiles a lazy body on its first call. The VM does not
+ * link the compiler itself, so code with lazy bodies needs one installed
+ * (the pipeline does); without it, calling such a function is an error.
+ */
+void _JechVM_SetBodyCompiler(JechBodyCompiler compiler);
+
 /**
  * Returns the last return value from a function call
  */
 const char *_JechVM_GetLastReturn();
 
+/**
+ * Dynamic opcode counts, collected by builds with JECH_PROFILE=1: every
+ * dispatch, and every pair of opcodes run one after the other in a chunk
+ * (`pairs[first][second]`)
+ */
+typedef struct
+{
+    unsigned long long dispatches;
+    unsigned long long pairs[JECH_OPCODE_COUNT][JECH_OPCODE_COUNT];
+} JechVMProfile;
+
+/**
+ * Counts since the process started, or since the caller last cleared
+ * them; all zero unless built with JECH_PROFILE
+ */
+JechVMProfile *_JechVM_Profile();
+
 #endif
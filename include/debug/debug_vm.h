@@ -10,4 +10,10 @@
  */
 void debug_print_variables();
 
+/**
+ * Prints the VM's dispatch count and its opcode pairs, most frequent
+ * first, to stderr. Only a JECH_PROFILE build collects them.
+ */
+void debug_print_profile();
+
 #endif
@@ -15,4 +15,47 @@ void print_error_header(JechErrorType type);
 void report_syntax_error(const char *message, int line, int column);
 void report_runtime_error(const char *message, int line, int column);
 
+/**
+ * Same as above, with the position given as a byte offset into the source
+ * registered with _JechLines_SetSource
+ */
+void report_error_at(JechErrorType type, const char *message, int offset);
+void report_syntax_error_at(const char *message, int offset);
+void report_runtime_error_at(const char *message, int offset);
+
+/**
+ * Number of errors reported so far
+ */
+int reported_error_count();
+
+/**
+ * A report held back instead of printed, at a byte offset into the source
+ */
+typedef struct
+{
+    JechErrorType type;
+    char message[128];
+    int offset;
+} JechDiagnostic;
+
+typedef struct
+{
+    JechDiagnostic *items;
+    int count;
+    int capacity;
+} JechDiagnostics;
+
+/**
+ * While `list` is set, reports given by byte offset are appended to it
+ * instead of printed; NULL prints them again. Returns the previous list.
+ */
+JechDiagnostics *capture_diagnostics(JechDiagnostics *list);
+
+/**
+ * Prints the held reports, each offset moved by `shift`
+ */
+void report_diagnostics(const JechDiagnostics *list, int shift);
+
+void free_diagnostics(JechDiagnostics *list);
+
 #endif
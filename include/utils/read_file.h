@@ -1,10 +1,37 @@
 #ifndef READ_FILE_H
 #define READ_FILE_H
 
+#include <stddef.h>
+
+/**
+ * A loaded source file. `data` is always NUL-terminated and read-only;
+ * when `mapped` is set it points into a private file mapping, otherwise
+ * into a heap buffer.
+ */
+typedef struct
+{
+    const char *data;
+    size_t length;
+    int mapped;
+    size_t map_length;
+} JechSourceFile;
+
 /**
  * Reads the full contents of a file and returns it as a string.
  * Returns NULL if the file cannot be opened.
  */
 char *read_file_content(const char *filename);
 
+/**
+ * Maps a regular file into memory so it can be lexed in place, falling
+ * back to read_file_content for pipes, special files and platforms
+ * without mmap. Returns 0 if the file cannot be read.
+ */
+int map_file_content(const char *filename, JechSourceFile *file);
+
+/**
+ * Releases a file loaded with map_file_content
+ */
+void unmap_file_content(JechSourceFile *file);
+
 #endif
@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/**
+ * A fixed-size pool of worker threads running submitted tasks.
+ * Builds without pthreads (e.g. WASM) run every task inline on submit.
+ */
+typedef void (*ThreadPoolTask)(void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Number of worker threads worth using on this machine (online CPUs)
+ */
+int thread_pool_default_size();
+
+/**
+ * Returns the process-wide pool, creating it with `thread_pool_default_size`
+ * workers on first use. Returns NULL if threads are unavailable.
+ */
+ThreadPool *thread_pool_shared();
+
+/**
+ * Number of workers in the pool
+ */
+int thread_pool_size(const ThreadPool *pool);
+
+/**
+ * Queues `task(arg)` to run on a worker
+ */
+void thread_pool_submit(ThreadPool *pool, ThreadPoolTask task, void *arg);
+
+/**
+ * Blocks until every submitted task has finished
+ */
+void thread_pool_wait(ThreadPool *pool);
+
+#endif
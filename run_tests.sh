@@ -27,12 +27,23 @@ gcc -Wall -Iinclude \
     tests/test_parser.c \
     tests/test_vm.c \
     tests/test_integration.c \
-    src/core/ast.c \
     src/core/bytecode.c \
+    src/core/cache.c \
+    src/core/chunk.c \
+    src/core/document.c \
+    src/core/flat_ast.c \
+    src/core/image.c \
+    src/core/lines.c \
+    src/core/number.c \
+    src/core/optimizer.c \
+    src/core/peephole.c \
     src/core/pipeline.c \
+    src/core/scan.c \
+    src/core/symbol.c \
     src/core/tokenizer.c \
     src/core/vm.c \
     src/core/parser/assign.c \
+    src/core/parser/expression.c \
     src/core/parser/function.c \
     src/core/parser/keep.c \
     src/core/parser/map.c \
@@ -40,10 +51,26 @@ gcc -Wall -Iinclude \
     src/core/parser/say.c \
     src/core/parser/when.c \
     src/utils/read_file.c \
+    src/utils/thread_pool.c \
     src/utils/token_utils.c \
     src/errors/error.c \
     -o build/test_runner \
-    -lreadline
+    -lreadline -lpthread
+
+# The execute-only runtime, which the integration tests run as a process;
+# the same sources as SRC_RUNTIME in the Makefile
+gcc -Wall -Iinclude \
+    src/runtime/jech_run.c \
+    src/core/vm.c \
+    src/core/chunk.c \
+    src/core/image.c \
+    src/core/number.c \
+    src/core/symbol.c \
+    src/core/lines.c \
+    src/core/scan.c \
+    src/errors/error.c \
+    src/utils/read_file.c \
+    -o build/jech-run
 
 if [ $? -eq 0 ]; then
     echo -e "${GREEN}✓ Compilation successful${NC}"
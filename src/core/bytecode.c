@@ -3,48 +3,124 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "core/bytecode.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/vm.h"
+#include "core/tokenizer.h"
+#include "core/parser/parser.h"
+#include "core/optimizer.h"
+#include "core/peephole.h"
+#include "utils/thread_pool.h"
+
+/**
+ * ASTs with at least this many function bodies compile them in parallel
+ * when more than one core is available
+ */
+#define JECH_PARALLEL_COMPILE_MIN 16
 
 // Forward declarations
-static void compile_function_call(Bytecode * bc, const JechASTNode * node);
+static void compile_function_call(Bytecode * bc,
+    const JechFlatAST * ast, JechNodeId node);
+static void compile_statements(Bytecode * bc,
+    const JechFlatAST * ast, const JechNodeId * statements, int count);
+static void end_chunk(Bytecode * bc);
+
+/**
+ * Function bodies compiled ahead by _JechBytecode_CompileAllParallel,
+ * indexed by node id. Only set while it runs; workers just read it.
+ */
+static Bytecode ** compiled_bodies = NULL;
+
+/**
+ * A compiled expression operand: a literal, a variable name or the
+ * temporary holding an intermediate result
+ */
+typedef struct {
+    const char * value; // the node's text, the destination or `temp`
+    char temp[16];
+    JechTokenType type;
+    JechNumber number;
+} Operand;
+
+static void out_of_memory() {
+    fprintf(stderr, "Bytecode error: out of memory.\n");
+    exit(1);
+}
+
+/**
+ * Returns 1 if `node` exists and is of `type`
+ */
+static int is_node(const JechFlatAST * ast, JechNodeId node, JechASTType type) {
+    return node != JECH_NO_NODE && ast -> type[node] == type;
+}
+
+/**
+ * Compiles an expression tree in post-order. A leaf emits nothing and
+ * becomes the operand itself; each operator becomes an OP_BIN_OP writing
+ * to `dest`, or to the temporary `__t<depth>` when `dest` is NULL. The
+ * right subtree works one level deeper so it never clobbers the left
+ * result, and temporaries are reused by every statement.
+ */
+static void compile_expression(Bytecode * bc,
+    const JechFlatAST * ast, JechNodeId node,
+        const char * dest, int depth, Operand * out) {
+    if (ast -> type[node] != JECH_AST_BIN_OP) {
+        out -> value = _JechFlatAST_Value(ast, node);
+        out -> type = ast -> token_type[node];
+        out -> number = _JechFlatAST_Number(ast, node);
+        return;
+    }
+
+    Operand left, right;
+    compile_expression(bc, ast, ast -> left[node], NULL, depth, & left);
+    compile_expression(bc, ast, ast -> right[node], NULL, depth + 1, & right);
+
+    Instruction inst;
+    memset( & inst, 0, sizeof(Instruction));
+    inst.op = OP_BIN_OP;
+    if (dest) {
+        out -> value = dest;
+    } else {
+        snprintf(out -> temp, sizeof(out -> temp), "__t%d", depth);
+        out -> value = out -> temp;
+    }
+    inst.name = out -> value;
+    inst.operand = left.value;
+    inst.operand_number = left.number;
+    inst.token_type = left.type;
+    inst.operand_right = right.value;
+    inst.operand_right_number = right.number;
+    inst.cmp_operand_type = right.type;
+    inst.bin_op = ast -> op[node];
+    _JechBytecode_Emit(bc, & inst);
+
+    out -> type = TOKEN_IDENTIFIER;
+    memset( & out -> number, 0, sizeof(out -> number));
+}
 
 /**
  * Helper function to compile the `say` command
  */
 static void compile_say(Bytecode * bc,
-    const JechASTNode * node) {
-    // Check if this is a binary operation: say(a + b);
-    if (node -> left && node -> left -> type == JECH_AST_BIN_OP) {
-        // Create a temporary variable to store the result
-        static int temp_counter = 0;
-        char temp_name[MAX_STRING];
-        snprintf(temp_name, sizeof(temp_name), "__temp_%d", temp_counter++);
-
-        // Compile the binary operation into the temp variable
-        Instruction * binop_inst = & bc -> instructions[bc -> count++];
-        memset(binop_inst, 0, sizeof(Instruction));
-        binop_inst -> op = OP_BIN_OP;
-        strncpy(binop_inst -> name, temp_name, sizeof(binop_inst -> name));
-        strncpy(binop_inst -> operand, node -> left -> left -> value, sizeof(binop_inst -> operand));
-        strncpy(binop_inst -> operand_right, node -> left -> right -> value, sizeof(binop_inst -> operand_right));
-        binop_inst -> bin_op = node -> left -> op;
-        binop_inst -> token_type = node -> left -> left -> token_type;
-        binop_inst -> cmp_operand_type = node -> left -> right -> token_type;
-
-        // Now say the temp variable
-        Instruction * say_inst = & bc -> instructions[bc -> count++];
-        memset(say_inst, 0, sizeof(Instruction));
-        say_inst -> op = OP_SAY;
-        strncpy(say_inst -> operand, temp_name, sizeof(say_inst -> operand));
-        say_inst -> token_type = TOKEN_IDENTIFIER;
+    const JechFlatAST * ast, JechNodeId node) {
+    // Expression: say(a * b + c); evaluate it, then say the result
+    if (is_node(ast, ast -> left[node], JECH_AST_BIN_OP)) {
+        Operand result;
+        compile_expression(bc, ast, ast -> left[node], NULL, 0, & result);
+
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_SAY;
+        inst.operand = result.value;
+        inst.token_type = TOKEN_IDENTIFIER;
+        _JechBytecode_Emit(bc, & inst);
     } else {
         // Simple say: say("hello") or say(variable)
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_SAY;
-        strncpy(inst -> operand, node -> value, sizeof(inst -> operand));
-        inst -> token_type = node -> token_type;
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_SAY;
+        inst.operand = _JechFlatAST_Value(ast, node);
+        inst.token_type = ast -> token_type[node];
+        _JechBytecode_Emit(bc, & inst);
     }
 }
 
@@ -52,110 +128,100 @@ static void compile_say(Bytecode * bc,
  * Helper function to compile say with array indexing: say(arr[0]);
  */
 static void compile_say_index(Bytecode * bc,
-    const JechASTNode * node) {
-    Instruction * inst = & bc -> instructions[bc -> count++];
-    memset(inst, 0, sizeof(Instruction));
-    inst -> op = OP_SAY_INDEX;
-    strncpy(inst -> name, node -> value, sizeof(inst -> name));
-    if (node -> left) {
-        strncpy(inst -> operand, node -> left -> value, sizeof(inst -> operand));
+    const JechFlatAST * ast, JechNodeId node) {
+    Instruction inst;
+    memset( & inst, 0, sizeof(Instruction));
+    inst.op = OP_SAY_INDEX;
+    inst.name = _JechFlatAST_Value(ast, node);
+    if (ast -> left[node] != JECH_NO_NODE) {
+        inst.operand = _JechFlatAST_Value(ast, ast -> left[node]);
     }
+    _JechBytecode_Emit(bc, & inst);
 }
 
 /**
  * Helper function to compile map operation
  */
 static void compile_map(Bytecode * bc,
-    const JechASTNode * node,
+    const JechFlatAST * ast, JechNodeId node,
         const char * result_name) {
-    Instruction * inst = & bc -> instructions[bc -> count++];
-    memset(inst, 0, sizeof(Instruction));
-    inst -> op = OP_MAP;
+    Instruction inst;
+    memset( & inst, 0, sizeof(Instruction));
+    inst.op = OP_MAP;
 
     // name = result array name
-    strncpy(inst -> name, result_name, sizeof(inst -> name));
+    inst.name = result_name;
 
     // operand = source array name
-    strncpy(inst -> operand, node -> value, sizeof(inst -> operand));
+    inst.operand = _JechFlatAST_Value(ast, node);
 
     // operand_right = operation value
-    if (node -> left) {
-        strncpy(inst -> operand_right, node -> left -> value, sizeof(inst -> operand_right));
-        inst -> bin_op = node -> left -> op; // operator type (*, +, -, /)
+    JechNodeId operation = ast -> left[node];
+    if (operation != JECH_NO_NODE) {
+        inst.operand_right = _JechFlatAST_Value(ast, operation);
+        inst.operand_right_number = _JechFlatAST_Number(ast, operation);
+        inst.bin_op = ast -> op[operation]; // operator type (*, +, -, /)
     }
+    _JechBytecode_Emit(bc, & inst);
 }
 
 /**
  * Helper function to compile the `keep` command
  */
 static void compile_keep(Bytecode * bc,
-    const JechASTNode * node) {
-    if (node -> left && node -> left -> type == JECH_AST_FUNCTION_CALL) {
+    const JechFlatAST * ast, JechNodeId node) {
+    JechNodeId value = ast -> left[node];
+    const char * name = _JechFlatAST_Name(ast, node);
+
+    if (is_node(ast, value, JECH_AST_FUNCTION_CALL)) {
         // keep result = func(args); — compile the call, then keep from return value
-        compile_function_call(bc, node -> left);
-
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_KEEP;
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
-        strncpy(inst -> operand, "__last_return__", sizeof(inst -> operand));
-        inst -> token_type = TOKEN_IDENTIFIER;
+        compile_function_call(bc, ast, value);
+
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_KEEP;
+        inst.name = name;
+        inst.operand = "__last_return__";
+        inst.token_type = TOKEN_IDENTIFIER;
+        _JechBytecode_Emit(bc, & inst);
         return;
     }
-    if (node -> left && node -> left -> type == JECH_AST_MAP) {
+    if (is_node(ast, value, JECH_AST_MAP)) {
         // Map operation: keep doubled = numbers.map(* 2);
-        compile_map(bc, node -> left, node -> name);
-    } else if (node -> token_type == TOKEN_LBRACKET && node -> left && node -> left -> type == JECH_AST_ARRAY_LITERAL) {
+        compile_map(bc, ast, value, name);
+    } else if (ast -> token_type[node] == TOKEN_LBRACKET && is_node(ast, value, JECH_AST_ARRAY_LITERAL)) {
         // Array literal: keep arr = [1, 2, 3];
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_ARRAY_NEW;
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_ARRAY_NEW;
+        inst.name = name;
+        _JechBytecode_Emit(bc, & inst);
 
         // Iterate through array elements and push them
-        JechASTNode * elem = node -> left -> left;
-        while (elem) {
-            Instruction * push_inst = & bc -> instructions[bc -> count++];
-            memset(push_inst, 0, sizeof(Instruction));
-            push_inst -> op = OP_ARRAY_PUSH;
-            strncpy(push_inst -> name, node -> name, sizeof(push_inst -> name));
-            strncpy(push_inst -> operand, elem -> value, sizeof(push_inst -> operand));
-            push_inst -> token_type = elem -> token_type;
-            elem = elem -> right;
-        }
-    } else if (node -> left && node -> left -> type == JECH_AST_BIN_OP) {
-        // Binary operation: keep x = a + b;
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_BIN_OP;
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
-        // Handle left operand
-        if (node -> left -> left -> type == JECH_AST_ASSIGN) {
-            strncpy(inst -> operand, node -> left -> left -> name, sizeof(inst -> operand));
-            inst -> token_type = TOKEN_IDENTIFIER;
-        } else {
-            strncpy(inst -> operand, node -> left -> left -> value, sizeof(inst -> operand));
-            inst -> token_type = node -> left -> left -> token_type;
+        JechNodeId elem = ast -> left[value];
+        while (elem != JECH_NO_NODE) {
+            Instruction push_inst;
+            memset( & push_inst, 0, sizeof(Instruction));
+            push_inst.op = OP_ARRAY_PUSH;
+            push_inst.name = name;
+            push_inst.operand = _JechFlatAST_Value(ast, elem);
+            push_inst.token_type = ast -> token_type[elem];
+            _JechBytecode_Emit(bc, & push_inst);
+            elem = ast -> right[elem];
         }
-        
-        // Handle right operand
-        if (node -> left -> right -> type == JECH_AST_ASSIGN) {
-            strncpy(inst -> operand_right, node -> left -> right -> name, sizeof(inst -> operand_right));
-            inst -> cmp_operand_type = TOKEN_IDENTIFIER;
-        } else {
-            strncpy(inst -> operand_right, node -> left -> right -> value, sizeof(inst -> operand_right));
-            inst -> cmp_operand_type = node -> left -> right -> token_type;
-        }
-        
-        inst -> bin_op = node -> left -> op;
+    } else if (is_node(ast, value, JECH_AST_BIN_OP)) {
+        // Expression: keep x = a * b + c;
+        Operand result;
+        compile_expression(bc, ast, value, name, 0, & result);
     } else {
         // Scalar keep
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_KEEP;
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
-        strncpy(inst -> operand, node -> value, sizeof(inst -> operand));
-        inst -> token_type = node -> token_type;
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_KEEP;
+        inst.name = name;
+        inst.operand = _JechFlatAST_Value(ast, node);
+        inst.token_type = ast -> token_type[node];
+        _JechBytecode_Emit(bc, & inst);
     }
 }
 
@@ -165,51 +231,67 @@ static void compile_keep(Bytecode * bc,
  * Now with else branch support
  */
 static void compile_when(Bytecode * bc,
-    const JechASTNode * node) {
-    const JechASTNode * condition = node -> left;
-
-    if (condition -> type == JECH_AST_BIN_OP) {
-        // Binary condition: when (x > 10) { ... } or when (x == "hello") { ... }
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_WHEN;
-
-        strncpy(inst -> name, condition -> left -> value, sizeof(inst -> name));
-        inst -> bin_op = condition -> token_type; // ==, <, >
-        strncpy(inst -> operand, condition -> right -> value, sizeof(inst -> operand));
-        inst -> cmp_operand_type = condition -> right -> token_type; // STRING, NUMBER, IDENTIFIER
-
-        strncpy(inst -> operand_right, node -> right -> value, sizeof(inst -> operand_right));
-        inst -> token_type = node -> right -> token_type;
+    const JechFlatAST * ast, JechNodeId node) {
+    JechNodeId condition = ast -> left[node];
+    JechNodeId then_say = ast -> right[node];
+    JechNodeId else_say = ast -> extra[node];
+
+    int is_comparison = ast -> type[condition] == JECH_AST_BIN_OP &&
+        (ast -> op[condition] == TOKEN_EQEQ || ast -> op[condition] == TOKEN_LT || ast -> op[condition] == TOKEN_GT);
+
+    if (is_comparison && ast -> type[ast -> left[condition]] == JECH_AST_IDENTIFIER &&
+        (ast -> type[ast -> right[condition]] == JECH_AST_IDENTIFIER ||
+            ast -> type[ast -> right[condition]] == JECH_AST_NUMBER_LITERAL ||
+            ast -> type[ast -> right[condition]] == JECH_AST_STRING_LITERAL)) {
+        // Simple comparison: when (x > 10) { ... } or when (x == "hello") { ... }
+        JechNodeId compared = ast -> right[condition];
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_WHEN;
+
+        inst.name = _JechFlatAST_Value(ast, ast -> left[condition]);
+        inst.bin_op = ast -> op[condition]; // ==, <, >
+        inst.operand = _JechFlatAST_Value(ast, compared);
+        inst.operand_number = _JechFlatAST_Number(ast, compared);
+        inst.cmp_operand_type = ast -> token_type[compared]; // STRING, NUMBER, IDENTIFIER
+
+        inst.operand_right = _JechFlatAST_Value(ast, then_say);
+        inst.token_type = ast -> token_type[then_say];
 
         // Handle else branch for binary conditions
-        if (node -> else_branch) {
-            inst -> has_else = 1;
-            strncpy(inst -> else_operand, node -> else_branch -> value, sizeof(inst -> else_operand));
-            inst -> else_token_type = node -> else_branch -> token_type;
+        if (else_say != JECH_NO_NODE) {
+            inst.has_else = 1;
+            inst.else_operand = _JechFlatAST_Value(ast, else_say);
+            inst.else_token_type = ast -> token_type[else_say];
         }
+        _JechBytecode_Emit(bc, & inst);
     } else {
-        // Boolean/identifier condition: when (name) { ... } else { ... }
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_WHEN_BOOL;
+        // Boolean condition: when (name) { ... }, or any other expression
+        // evaluated into a temporary first: when (a * 2 > b) { ... }
+        Operand result;
+        compile_expression(bc, ast, condition, NULL, 0, & result);
+
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_WHEN_BOOL;
 
         // Store condition (variable name or literal "true"/"false")
-        strncpy(inst -> name, condition -> value, sizeof(inst -> name));
-        inst -> bin_op = condition -> type == JECH_AST_BOOL_LITERAL ? TOKEN_BOOL : TOKEN_IDENTIFIER;
+        inst.name = result.value;
+        inst.bin_op = result.type == TOKEN_IDENTIFIER ? TOKEN_IDENTIFIER : TOKEN_BOOL;
 
         // Store then branch (say value)
-        if (node -> right) {
-            strncpy(inst -> operand, node -> right -> value, sizeof(inst -> operand));
-            inst -> token_type = node -> right -> token_type;
+        if (then_say != JECH_NO_NODE) {
+            inst.operand = _JechFlatAST_Value(ast, then_say);
+            inst.token_type = ast -> token_type[then_say];
         }
 
         // Store else branch if present
-        if (node -> else_branch) {
-            inst -> has_else = 1;
-            strncpy(inst -> else_operand, node -> else_branch -> value, sizeof(inst -> else_operand));
-            inst -> else_token_type = node -> else_branch -> token_type;
+        if (else_say != JECH_NO_NODE) {
+            inst.has_else = 1;
+            inst.else_operand = _JechFlatAST_Value(ast, else_say);
+            inst.else_token_type = ast -> token_type[else_say];
         }
+        _JechBytecode_Emit(bc, & inst);
     }
 }
 
@@ -217,88 +299,92 @@ static void compile_when(Bytecode * bc,
  * Helper function to compile function declarations
  */
 static void compile_function_decl(Bytecode * bc,
-    const JechASTNode * node) {
-    Instruction * inst = & bc -> instructions[bc -> count++];
-    memset(inst, 0, sizeof(Instruction));
-    inst -> op = OP_FUNCTION_DECL;
-    strncpy(inst -> name, node -> name, sizeof(inst -> name));
+    const JechFlatAST * ast, JechNodeId node) {
+    Instruction inst;
+    memset( & inst, 0, sizeof(Instruction));
+    inst.op = OP_FUNCTION_DECL;
+    inst.name = _JechFlatAST_Name(ast, node);
 
     // Extract parameters from param_list (node->left)
-    inst -> param_count = 0;
-    if (node -> left && node -> left -> type == JECH_AST_PARAM_LIST) {
-        JechASTNode * param = node -> left -> left;
-        while (param && inst -> param_count < 8) {
-            strncpy(inst -> params[inst -> param_count], param -> value, MAX_STRING);
-            inst -> param_count++;
-            param = param -> right;
+    inst.param_count = 0;
+    if (is_node(ast, ast -> left[node], JECH_AST_PARAM_LIST)) {
+        JechNodeId param = ast -> left[ast -> left[node]];
+        while (param != JECH_NO_NODE && inst.param_count < JECH_MAX_OPERANDS) {
+            inst.params[inst.param_count] = _JechFlatAST_Value(ast, param);
+            inst.param_count++;
+            param = ast -> right[param];
         }
     }
 
-    // Compile function body into a separate Bytecode
-    if (node -> body_count > 0 && node -> body) {
-        Bytecode * body = malloc(sizeof(Bytecode));
-        * body = _JechBytecode_CompileAll(node -> body, node -> body_count);
-        inst -> body_bc = body;
+    if (_JechFlatAST_LazyBody(ast, node, & inst.body_offset, & inst.body_length)) {
+        // A lazy body stays source text until the function is first called
+        inst.body_source = ast -> source;
+    } else if (compiled_bodies && compiled_bodies[node]) {
+        inst.body_bc = compiled_bodies[node];
     } else {
-        inst -> body_bc = NULL;
+        // Compile function body into a separate Bytecode
+        int body_count = 0;
+        const JechNodeId * body_statements = _JechFlatAST_Body(ast, node, & body_count);
+        if (body_count > 0) {
+            Bytecode * body = calloc(1, sizeof(Bytecode));
+            if (!body) {
+                out_of_memory();
+            }
+            compile_statements(body, ast, body_statements, body_count);
+            end_chunk(body);
+            inst.body_bc = body;
+        }
     }
+    _JechBytecode_Emit(bc, & inst);
 }
 
 /**
  * Helper function to compile function calls
  */
 static void compile_function_call(Bytecode * bc,
-    const JechASTNode * node) {
-    Instruction * inst = & bc -> instructions[bc -> count++];
-    memset(inst, 0, sizeof(Instruction));
-    inst -> op = OP_FUNCTION_CALL;
-    strncpy(inst -> name, node -> name, sizeof(inst -> name));
+    const JechFlatAST * ast, JechNodeId node) {
+    Instruction inst;
+    memset( & inst, 0, sizeof(Instruction));
+    inst.op = OP_FUNCTION_CALL;
+    inst.name = _JechFlatAST_Name(ast, node);
 
     // Extract arguments from arg_list (node->left)
-    inst -> arg_count = 0;
-    if (node -> left && node -> left -> type == JECH_AST_PARAM_LIST) {
-        JechASTNode * arg = node -> left -> left;
-        while (arg && inst -> arg_count < 8) {
-            strncpy(inst -> args[inst -> arg_count], arg -> value, MAX_STRING);
-            inst -> arg_types[inst -> arg_count] = arg -> token_type;
-            inst -> arg_count++;
-            arg = arg -> right;
+    inst.arg_count = 0;
+    if (is_node(ast, ast -> left[node], JECH_AST_PARAM_LIST)) {
+        JechNodeId arg = ast -> left[ast -> left[node]];
+        while (arg != JECH_NO_NODE && inst.arg_count < JECH_MAX_OPERANDS) {
+            inst.args[inst.arg_count] = _JechFlatAST_Value(ast, arg);
+            inst.arg_types[inst.arg_count] = ast -> token_type[arg];
+            inst.arg_count++;
+            arg = ast -> right[arg];
         }
     }
+    _JechBytecode_Emit(bc, & inst);
 }
 
 /**
  * Helper function to compile return statements
  */
 static void compile_return(Bytecode * bc,
-    const JechASTNode * node) {
-    if (node -> left && node -> left -> type == JECH_AST_BIN_OP) {
-        // return a + b; — compile binop into temp, then return temp
-        static int ret_temp_counter = 0;
-        char temp_name[MAX_STRING];
-        snprintf(temp_name, sizeof(temp_name), "__ret_temp_%d", ret_temp_counter++);
-
-        Instruction * binop_inst = & bc -> instructions[bc -> count++];
-        memset(binop_inst, 0, sizeof(Instruction));
-        binop_inst -> op = OP_BIN_OP;
-        strncpy(binop_inst -> name, temp_name, sizeof(binop_inst -> name));
-        strncpy(binop_inst -> operand, node -> left -> left -> value, sizeof(binop_inst -> operand));
-        strncpy(binop_inst -> operand_right, node -> left -> right -> value, sizeof(binop_inst -> operand_right));
-        binop_inst -> bin_op = node -> left -> op;
-        binop_inst -> token_type = node -> left -> left -> token_type;
-        binop_inst -> cmp_operand_type = node -> left -> right -> token_type;
-
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_RETURN;
-        strncpy(inst -> operand, temp_name, sizeof(inst -> operand));
-        inst -> token_type = TOKEN_IDENTIFIER;
+    const JechFlatAST * ast, JechNodeId node) {
+    if (is_node(ast, ast -> left[node], JECH_AST_BIN_OP)) {
+        // return a * b + c; evaluate into a temporary, then return it
+        Operand result;
+        compile_expression(bc, ast, ast -> left[node], NULL, 0, & result);
+
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_RETURN;
+        inst.operand = result.value;
+        inst.token_type = TOKEN_IDENTIFIER;
+        _JechBytecode_Emit(bc, & inst);
     } else {
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_RETURN;
-        strncpy(inst -> operand, node -> value, sizeof(inst -> operand));
-        inst -> token_type = node -> token_type;
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_RETURN;
+        inst.operand = _JechFlatAST_Value(ast, node);
+        inst.token_type = ast -> token_type[node];
+        _JechBytecode_Emit(bc, & inst);
     }
 }
 
@@ -306,82 +392,59 @@ static void compile_return(Bytecode * bc,
  * Helper function to compile the `assign` command
  */
 static void compile_assign(Bytecode * bc,
-    const JechASTNode * node) {
-    if (node -> left && node -> left -> type == JECH_AST_BIN_OP) {
-        const JechASTNode * bin = node -> left;
-
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_BIN_OP;
-
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
-
-        if (bin -> left -> type == JECH_AST_IDENTIFIER) {
-            strncpy(inst -> operand, bin -> left -> name, sizeof(inst -> operand));
-        } else {
-            strncpy(inst -> operand, bin -> left -> value, sizeof(inst -> operand));
-        }
-
-        if (bin -> right -> type == JECH_AST_IDENTIFIER) {
-            strncpy(inst -> operand_right, bin -> right -> name, sizeof(inst -> operand_right));
-        } else {
-            strncpy(inst -> operand_right, bin -> right -> value, sizeof(inst -> operand_right));
-        }
-
-        inst -> bin_op = bin -> token_type;
-        inst -> token_type = bin -> right -> token_type;
+    const JechFlatAST * ast, JechNodeId node) {
+    if (is_node(ast, ast -> left[node], JECH_AST_BIN_OP)) {
+        // Expression: x = x * 2 + y;
+        Operand result;
+        compile_expression(bc, ast, ast -> left[node], _JechFlatAST_Name(ast, node), 0, & result);
     } else {
-        Instruction * inst = & bc -> instructions[bc -> count++];
-        memset(inst, 0, sizeof(Instruction));
-        inst -> op = OP_ASSIGN;
-        strncpy(inst -> name, node -> name, sizeof(inst -> name));
-        strncpy(inst -> operand, node -> value, sizeof(inst -> operand));
-        inst -> token_type = node -> token_type;
+        Instruction inst;
+        memset( & inst, 0, sizeof(Instruction));
+        inst.op = OP_ASSIGN;
+        inst.name = _JechFlatAST_Name(ast, node);
+        inst.operand = _JechFlatAST_Value(ast, node);
+        inst.token_type = ast -> token_type[node];
+        _JechBytecode_Emit(bc, & inst);
     }
 }
 
 /**
- * Main compilation function: convert AST to bytecode
+ * Appends the code for a list of statements to `bc`
  */
-Bytecode _JechBytecode_CompileAll(JechASTNode ** roots, int count) {
-    Bytecode bc;
-    bc.count = 0;
-
+static void compile_statements(Bytecode * bc,
+    const JechFlatAST * ast, const JechNodeId * statements, int count) {
     for (int i = 0; i < count; i++) {
-        if (bc.count >= 128) {
-            fprintf(stderr, "Bytecode overflow: too many instructions.\n");
-            break;
-        }
-
-        JechASTNode * node = roots[i];
-        switch (node -> type) {
+        // Runtime errors point back at the statement
+        JechNodeId node = statements[i];
+        _JechBytecode_SetOffset(bc, ast -> offset[node]);
+        switch (ast -> type[node]) {
         case JECH_AST_SAY:
-            compile_say( & bc, node);
+            compile_say(bc, ast, node);
             break;
         case JECH_AST_SAY_INDEX:
-            compile_say_index( & bc, node);
+            compile_say_index(bc, ast, node);
             break;
         case JECH_AST_KEEP:
-            compile_keep( & bc, node);
+            compile_keep(bc, ast, node);
             break;
         case JECH_AST_WHEN:
-            compile_when( & bc, node);
+            compile_when(bc, ast, node);
             break;
         case JECH_AST_ASSIGN:
-            compile_assign( & bc, node);
+            compile_assign(bc, ast, node);
             break;
         case JECH_AST_MAP:
             // Standalone map: modify array in-place
-            compile_map( & bc, node, node -> value);
+            compile_map(bc, ast, node, _JechFlatAST_Value(ast, node));
             break;
         case JECH_AST_FUNCTION_DECL:
-            compile_function_decl( & bc, node);
+            compile_function_decl(bc, ast, node);
             break;
         case JECH_AST_FUNCTION_CALL:
-            compile_function_call( & bc, node);
+            compile_function_call(bc, ast, node);
             break;
         case JECH_AST_RETURN:
-            compile_return( & bc, node);
+            compile_return(bc, ast, node);
             break;
         default:
             fprintf(stderr, "Unknown AST node.\n");
@@ -389,6 +452,175 @@ Bytecode _JechBytecode_CompileAll(JechASTNode ** roots, int count) {
         }
     }
 
-    bc.instructions[bc.count++].op = OP_END;
+}
+
+/**
+ * Ends a chunk with OP_END and optimises it
+ */
+static void end_chunk(Bytecode * bc) {
+    Instruction end;
+    memset( & end, 0, sizeof(Instruction));
+    end.op = OP_END;
+    _JechBytecode_SetOffset(bc, -1);
+    _JechBytecode_Emit(bc, & end);
+    _JechPeephole_Run(bc);
+    _JechBytecode_Finish(bc);
+}
+
+/**
+ * Returns 1 if `node` declares a function with a parsed, non-empty body
+ */
+static int has_body(const JechFlatAST * ast, JechNodeId node) {
+    int count = 0;
+    return ast -> type[node] == JECH_AST_FUNCTION_DECL &&
+        _JechFlatAST_Body(ast, node, & count) != NULL;
+}
+
+/**
+ * Main compilation function: convert AST to bytecode
+ */
+Bytecode _JechBytecode_CompileAll(const JechFlatAST * ast) {
+    int bodies = 0;
+    for (int id = 0; id < ast -> count && bodies < JECH_PARALLEL_COMPILE_MIN; id++) {
+        bodies += has_body(ast, (JechNodeId) id);
+    }
+    if (bodies >= JECH_PARALLEL_COMPILE_MIN && thread_pool_size(thread_pool_shared()) > 1) {
+        return _JechBytecode_CompileAllParallel(ast);
+    }
+
+    Bytecode bc;
+    memset( & bc, 0, sizeof(bc));
+    compile_statements( & bc, ast, ast -> roots, ast -> root_count);
+    end_chunk( & bc);
+    _JechBytecode_Link( & bc);
+    return bc;
+}
+
+/**
+ * A function body compiled on a worker
+ */
+typedef struct {
+    const JechFlatAST * ast;
+    JechNodeId node;
+} BodyJob;
+
+static void compile_body_job(void * arg) {
+    BodyJob * job = arg;
+    int count = 0;
+    const JechNodeId * statements = _JechFlatAST_Body(job -> ast, job -> node, & count);
+    Bytecode * body = compiled_bodies[job -> node];
+    compile_statements(body, job -> ast, statements, count);
+    end_chunk(body);
+}
+
+/**
+ * Every body's Bytecode is allocated before any job runs, so a
+ * declaration, nested or not, points at its body whichever worker fills
+ * it in, and the result matches a sequential compile.
+ */
+Bytecode _JechBytecode_CompileAllParallel(const JechFlatAST * ast) {
+    Bytecode ** bodies = calloc(ast -> count > 0 ? ast -> count : 1, sizeof(Bytecode * ));
+    BodyJob * jobs = malloc(sizeof(BodyJob) * (ast -> count > 0 ? ast -> count : 1));
+    if (!bodies || !jobs) {
+        out_of_memory();
+    }
+
+    int job_count = 0;
+    for (int id = 0; id < ast -> count; id++) {
+        if (!has_body(ast, (JechNodeId) id)) {
+            continue;
+        }
+        bodies[id] = calloc(1, sizeof(Bytecode));
+        if (!bodies[id]) {
+            out_of_memory();
+        }
+        jobs[job_count].ast = ast;
+        jobs[job_count].node = (JechNodeId) id;
+        job_count++;
+    }
+
+    compiled_bodies = bodies;
+    ThreadPool * pool = thread_pool_shared();
+    for (int i = 0; i < job_count; i++) {
+        thread_pool_submit(pool, compile_body_job, & jobs[i]);
+    }
+    thread_pool_wait(pool);
+
+    Bytecode bc;
+    memset( & bc, 0, sizeof(bc));
+    compile_statements( & bc, ast, ast -> roots, ast -> root_count);
+    end_chunk( & bc);
+    compiled_bodies = NULL;
+    free(bodies);
+    free(jobs);
+
+    // Symbols are interned on this thread only
+    _JechBytecode_Link( & bc);
     return bc;
-}
\ No newline at end of file
+}
+
+/**
+ * Compiles the roots of several ASTs, in order, as one program
+ */
+Bytecode _JechBytecode_CompileParts(JechFlatAST ** parts, int count) {
+    Bytecode bc;
+    memset( & bc, 0, sizeof(bc));
+    for (int i = 0; i < count; i++) {
+        compile_statements( & bc, parts[i], parts[i] -> roots, parts[i] -> root_count);
+    }
+    end_chunk( & bc);
+    _JechBytecode_Link( & bc);
+    return bc;
+}
+
+
+/**
+ * Compiles a lazy function body: lexes its span in place, parses it into a
+ * private AST and compiles its statements. Returns NULL for an empty body.
+ */
+Bytecode * _JechBytecode_CompileBody(const char * source, int offset, int length) {
+    // The lexer keeps `source` as its base so token offsets stay absolute
+    JechLexer lexer = {
+        source,
+        source + offset,
+        0,
+        NULL,
+        0
+    };
+    JechTokenList tokens = {
+        NULL,
+        0,
+        0
+    };
+    for (;;) {
+        JechToken token = _JechTokenizer_Next( & lexer);
+        // The closing '}' ends the body
+        if (token.type == TOKEN_EOF || token.offset >= offset + length) {
+            break;
+        }
+        if (!_JechTokenizer_Push( & tokens, token)) {
+            out_of_memory();
+        }
+    }
+    if (tokens.count == 0) {
+        return NULL;
+    }
+    if (!_JechParser_TerminateWindow( & tokens)) {
+        out_of_memory();
+    }
+
+    JechFlatAST ast;
+    _JechFlatAST_Init( & ast);
+    _JechParser_ParseAll( & ast, & tokens);
+    _JechOptimizer_Run( & ast);
+
+    Bytecode * body = malloc(sizeof(Bytecode));
+    if (!body) {
+        out_of_memory();
+    }
+    * body = _JechBytecode_CompileAll( & ast);
+
+    _JechFlatAST_Free( & ast);
+    _JechTokenizer_Free( & tokens);
+    return body;
+}
@@ -0,0 +1,110 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "core/cache.h"
+#include "core/image.h"
+
+#define JECH_CACHE_PATH_MAX 4096
+
+int _JechCache_Directory(char *path, size_t size)
+{
+    const char *dir = getenv("JECH_CACHE_DIR");
+    int written;
+    if (dir)
+    {
+        written = snprintf(path, size, "%s", dir);
+    }
+    else if ((dir = getenv("XDG_CACHE_HOME")) && dir[0] != '\0')
+    {
+        written = snprintf(path, size, "%s/jech", dir);
+    }
+    else if ((dir = getenv("HOME")) && dir[0] != '\0')
+    {
+        written = snprintf(path, size, "%s/.cache/jech", dir);
+    }
+    else
+    {
+        return 0;
+    }
+    return written > 0 && (size_t)written < size;
+}
+
+/**
+ * Builds `<cache directory>/<hash>.jcb`; returns 0 when caching is off
+ */
+static int image_path(uint64_t hash, char *path, size_t size)
+{
+    char dir[JECH_CACHE_PATH_MAX];
+    if (!_JechCache_Directory(dir, sizeof(dir)))
+        return 0;
+    int written = snprintf(path, size, "%s/%016" PRIx64 ".jcb", dir, hash);
+    return written > 0 && (size_t)written < size;
+}
+
+/**
+ * Creates `dir` and any missing parents
+ */
+static int make_directories(const char *dir)
+{
+    char path[JECH_CACHE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char *p = path + 1; *p; p++)
+    {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST)
+            return 0;
+        *p = '/';
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+int _JechCache_Load(const char *source, size_t length, JechCacheEntry *entry)
+{
+    uint64_t hash = _JechImage_Hash(source, length);
+    char path[JECH_CACHE_PATH_MAX];
+    if (!image_path(hash, path, sizeof(path)) || access(path, R_OK) != 0)
+        return 0;
+    if (!map_file_content(path, &entry->image))
+        return 0;
+
+    // An image from another version, or of another text whose hash
+    // collides, is a miss: loading compares the image's text with ours
+    if (!_JechImage_Load(entry->image.data, entry->image.length, source, length, &entry->bytecode))
+    {
+        unmap_file_content(&entry->image);
+        return 0;
+    }
+    return 1;
+}
+
+void _JechCache_Store(const char *source, size_t length, const Bytecode *bc)
+{
+    uint64_t hash = _JechImage_Hash(source, length);
+    char dir[JECH_CACHE_PATH_MAX];
+    char path[JECH_CACHE_PATH_MAX];
+    char temp[JECH_CACHE_PATH_MAX + 32];
+    if (!_JechCache_Directory(dir, sizeof(dir)) || !image_path(hash, path, sizeof(path)) ||
+        !make_directories(dir))
+        return;
+
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid());
+    FILE *out = fopen(temp, "wb");
+    if (!out)
+        return;
+    int written = _JechImage_Write(out, bc, source, length);
+    if (fclose(out) != 0 || !written || rename(temp, path) != 0)
+        remove(temp);
+}
+
+void _JechCache_Release(JechCacheEntry *entry)
+{
+    _JechBytecode_Free(&entry->bytecode);
+    unmap_file_content(&entry->image);
+}
@@ -0,0 +1,725 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/bytecode.h"
+
+#define CHUNK_INITIAL_CAPACITY 16
+
+/**
+ * Makes room for `needed` elements in `field`, doubling its capacity
+ */
+#define RESERVE(bc, field, capacity_field, needed)                               \
+    do                                                                           \
+    {                                                                            \
+        if ((needed) > (bc)->capacity_field)                                     \
+        {                                                                        \
+            int capacity = (bc)->capacity_field ? (bc)->capacity_field           \
+                                                : CHUNK_INITIAL_CAPACITY;        \
+            while (capacity < (needed))                                          \
+            {                                                                    \
+                if (capacity > INT_MAX / 2)                                      \
+                    out_of_memory();                                             \
+                capacity *= 2;                                                   \
+            }                                                                    \
+            void *grown = realloc((bc)->field, sizeof(*(bc)->field) * capacity); \
+            if (!grown)                                                          \
+                out_of_memory();                                                 \
+            (bc)->field = grown;                                                 \
+            (bc)->capacity_field = capacity;                                     \
+        }                                                                        \
+    } while (0)
+
+static void out_of_memory()
+{
+    fprintf(stderr, "Bytecode error: out of memory.\n");
+    exit(1);
+}
+
+/**
+ * Parameter and argument lists live in fixed arrays of the decoded
+ * Instruction; a longer list could not be read back
+ */
+static void check_operand_count(int count)
+{
+    if (count < 0 || count > JECH_MAX_OPERANDS)
+    {
+        fprintf(stderr, "Bytecode error: %d operands, at most %d allowed.\n", count, JECH_MAX_OPERANDS);
+        exit(1);
+    }
+}
+
+static void put_varint(Bytecode *bc, uint32_t value)
+{
+    RESERVE(bc, code, capacity, bc->length + 5);
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        bc->code[bc->length++] = byte | (value ? 0x80 : 0);
+    } while (value);
+}
+
+static int same_number(const JechNumber *a, const JechNumber *b)
+{
+    return a->is_float == b->is_float && a->as.i == b->as.i;
+}
+
+static uint32_t hash_constant(const char *text, int length, const JechNumber *number)
+{
+    uint32_t hash = _JechSymbol_Hash(text, length);
+    return hash ^ (uint32_t)number->as.i ^ (uint32_t)(number->as.i >> 32) ^ (uint32_t)number->is_float;
+}
+
+/**
+ * Rebuilds the lookup table with room for twice the constants
+ */
+static void grow_lookup(Bytecode *bc)
+{
+    int capacity = bc->lookup_capacity ? bc->lookup_capacity * 2 : CHUNK_INITIAL_CAPACITY * 4;
+    int *lookup = malloc(sizeof(int) * capacity);
+    if (!lookup)
+        out_of_memory();
+    memset(lookup, 0xFF, sizeof(int) * capacity);
+
+    for (int i = 0; i < bc->constant_count; i++)
+    {
+        const JechConstant *c = &bc->constants[i];
+        const char *text = bc->strings + c->text;
+        uint32_t slot = hash_constant(text, (int)strlen(text), &c->number) & (capacity - 1);
+        while (lookup[slot] >= 0)
+            slot = (slot + 1) & (capacity - 1);
+        lookup[slot] = i;
+    }
+
+    free(bc->lookup);
+    bc->lookup = lookup;
+    bc->lookup_capacity = capacity;
+}
+
+/**
+ * Returns the index of the constant (`text`, `number`), adding it to the
+ * pool if it is new
+ */
+static uint32_t intern_constant(Bytecode *bc, const char *text, const JechNumber *number)
+{
+    static const JechNumber no_number = {0, {0}};
+    if (!text)
+        text = "";
+    if (!number)
+        number = &no_number;
+
+    // Keep the load factor under 1/2
+    if ((bc->constant_count + 1) * 2 > bc->lookup_capacity)
+        grow_lookup(bc);
+
+    int length = (int)strlen(text);
+    uint32_t slot = hash_constant(text, length, number) & (bc->lookup_capacity - 1);
+    while (bc->lookup[slot] >= 0)
+    {
+        const JechConstant *c = &bc->constants[bc->lookup[slot]];
+        if (same_number(&c->number, number) && strcmp(bc->strings + c->text, text) == 0)
+            return (uint32_t)bc->lookup[slot];
+        slot = (slot + 1) & (bc->lookup_capacity - 1);
+    }
+
+    RESERVE(bc, strings, strings_capacity, bc->strings_length + length + 1);
+    RESERVE(bc, constants, constant_capacity, bc->constant_count + 1);
+
+    // Constants are written to images as they are, padding included
+    JechConstant *c = &bc->constants[bc->constant_count];
+    memset(c, 0, sizeof(*c));
+    c->text = (uint32_t)bc->strings_length;
+    c->number.is_float = number->is_float;
+    c->number.as = number->as;
+    memcpy(bc->strings + bc->strings_length, text, length + 1);
+    bc->strings_length += length + 1;
+
+    bc->lookup[slot] = bc->constant_count;
+    return (uint32_t)bc->constant_count++;
+}
+
+static void put_string(Bytecode *bc, const char *text)
+{
+    put_varint(bc, intern_constant(bc, text, NULL));
+}
+
+/**
+ * A variable: the chunk slot of its name, allocated on first use, written
+ * one higher so that 0 stands for the result register
+ */
+static void put_slot(Bytecode *bc, const char *name)
+{
+    if (name && strcmp(name, JECH_RESULT_REGISTER) == 0)
+    {
+        put_varint(bc, 0);
+        return;
+    }
+
+    uint32_t constant = intern_constant(bc, name, NULL);
+    if ((int)constant >= bc->slot_lookup_capacity)
+    {
+        int previous = bc->slot_lookup_capacity;
+        RESERVE(bc, slot_lookup, slot_lookup_capacity, (int)constant + 1);
+        memset(bc->slot_lookup + previous, 0xFF, sizeof(int) * (bc->slot_lookup_capacity - previous));
+    }
+
+    if (bc->slot_lookup[constant] < 0)
+    {
+        RESERVE(bc, slots, slot_capacity, bc->slot_count + 1);
+        bc->slots[bc->slot_count] = constant;
+        bc->slot_lookup[constant] = bc->slot_count++;
+    }
+    put_varint(bc, (uint32_t)bc->slot_lookup[constant] + 1);
+}
+
+/**
+ * A typed value: its token type, then its slot for an identifier or its
+ * constant for a literal
+ */
+static void put_value(Bytecode *bc, JechTokenType type, const char *text, const JechNumber *number)
+{
+    put_varint(bc, (uint32_t)type);
+    if (type == TOKEN_IDENTIFIER)
+        put_slot(bc, text);
+    else
+        put_varint(bc, intern_constant(bc, text, number));
+}
+
+static const char *get_slot(const Bytecode *bc, int *pc, uint32_t *slot)
+{
+    *slot = _JechBytecode_ReadSlot(bc, pc);
+    return _JechBytecode_SlotName(bc, *slot);
+}
+
+static const char *get_value(const Bytecode *bc, int *pc, JechTokenType *type, JechNumber *number, uint32_t *slot)
+{
+    const JechConstant *c;
+    *type = _JechBytecode_ReadValue(bc, pc, slot, &c);
+    if (*type == TOKEN_IDENTIFIER)
+    {
+        if (number)
+            memset(number, 0, sizeof(*number));
+        return _JechBytecode_SlotName(bc, *slot);
+    }
+
+    if (number)
+        *number = c->number;
+    return _JechBytecode_Text(bc, c);
+}
+
+void _JechBytecode_Emit(Bytecode *bc, const Instruction *inst)
+{
+    RESERVE(bc, code, capacity, bc->length + 1);
+    bc->code[bc->length++] = (uint8_t)inst->op;
+    bc->count++;
+
+    switch (inst->op)
+    {
+    case OP_SAY:
+    case OP_RETURN:
+        put_value(bc, inst->token_type, inst->operand, NULL);
+        break;
+    case OP_SAY_INDEX:
+    case OP_ARRAY_PUSH:
+        put_string(bc, inst->name);
+        put_string(bc, inst->operand);
+        break;
+    case OP_ARRAY_NEW:
+        put_string(bc, inst->name);
+        break;
+    case OP_KEEP:
+    case OP_ASSIGN:
+        put_slot(bc, inst->name);
+        put_value(bc, inst->token_type, inst->operand, NULL);
+        break;
+    case OP_BIN_OP:
+        // Direct forms store the result only when `name` is set
+        put_varint(bc, (uint32_t)inst->dest);
+        if (inst->dest != JECH_TO_DEFAULT)
+            put_varint(bc, inst->name ? 1 : 0);
+        if (inst->dest == JECH_TO_DEFAULT || inst->name)
+            put_slot(bc, inst->name);
+        put_varint(bc, (uint32_t)inst->bin_op);
+        put_value(bc, inst->token_type, inst->operand, &inst->operand_number);
+        put_value(bc, inst->cmp_operand_type, inst->operand_right, &inst->operand_right_number);
+        if (inst->dest == JECH_TO_WHEN)
+        {
+            put_value(bc, inst->then_token_type, inst->then_operand, NULL);
+            put_varint(bc, inst->has_else ? 1 : 0);
+            if (inst->has_else)
+                put_value(bc, inst->else_token_type, inst->else_operand, NULL);
+        }
+        break;
+    case OP_WHEN:
+    case OP_WHEN_BOOL:
+        // OP_WHEN: `name` op `operand`; OP_WHEN_BOOL: condition `name`
+        // typed by bin_op, then value in `operand`
+        put_varint(bc, (uint32_t)inst->bin_op);
+        if (inst->op == OP_WHEN || inst->bin_op != TOKEN_BOOL)
+            put_slot(bc, inst->name);
+        else
+            put_string(bc, inst->name);
+        if (inst->op == OP_WHEN)
+        {
+            put_value(bc, inst->cmp_operand_type, inst->operand, &inst->operand_number);
+            put_value(bc, inst->token_type, inst->operand_right, NULL);
+        }
+        else
+        {
+            put_value(bc, inst->token_type, inst->operand, NULL);
+        }
+        put_varint(bc, inst->has_else ? 1 : 0);
+        if (inst->has_else)
+            put_value(bc, inst->else_token_type, inst->else_operand, NULL);
+        break;
+    case OP_MAP:
+        put_string(bc, inst->name);
+        put_string(bc, inst->operand);
+        put_varint(bc, (uint32_t)inst->bin_op);
+        put_varint(bc, intern_constant(bc, inst->operand_right, &inst->operand_right_number));
+        break;
+    case OP_FUNCTION_DECL:
+        check_operand_count(inst->param_count);
+        put_string(bc, inst->name);
+        put_varint(bc, (uint32_t)inst->param_count);
+        for (int i = 0; i < inst->param_count; i++)
+            put_slot(bc, inst->params[i]);
+
+        // Body: 0 none, 1 compiled (function index), 2 lazy (source span)
+        if (inst->body_bc)
+        {
+            RESERVE(bc, functions, function_capacity, bc->function_count + 1);
+            bc->functions[bc->function_count] = inst->body_bc;
+            put_varint(bc, 1);
+            put_varint(bc, (uint32_t)bc->function_count++);
+        }
+        else if (inst->body_source)
+        {
+            bc->source = inst->body_source;
+            put_varint(bc, 2);
+            put_varint(bc, (uint32_t)inst->body_offset);
+            put_varint(bc, (uint32_t)inst->body_length);
+        }
+        else
+        {
+            put_varint(bc, 0);
+        }
+        break;
+    case OP_FUNCTION_CALL:
+        check_operand_count(inst->arg_count);
+        put_string(bc, inst->name);
+        put_varint(bc, (uint32_t)inst->arg_count);
+        for (int i = 0; i < inst->arg_count; i++)
+            put_value(bc, inst->arg_types[i], inst->args[i], NULL);
+        put_varint(bc, (uint32_t)inst->dest);
+        if (inst->dest == JECH_TO_KEEP)
+            put_slot(bc, inst->operand);
+        break;
+    default:
+        break;
+    }
+}
+
+const char *_JechBytecode_SlotName(const Bytecode *bc, uint32_t slot)
+{
+    if (slot == JECH_RESULT_SLOT)
+        return JECH_RESULT_REGISTER;
+    return bc->strings + bc->constants[bc->slots[slot]].text;
+}
+
+int _JechBytecode_Decode(const Bytecode *bc, int pc, Instruction *out)
+{
+    out->op = (OpCode)bc->code[pc++];
+
+    switch (out->op)
+    {
+    case OP_SAY:
+    case OP_RETURN:
+        out->operand = get_value(bc, &pc, &out->token_type, NULL, &out->operand_slot);
+        break;
+    case OP_SAY_INDEX:
+    case OP_ARRAY_PUSH:
+        out->name = _JechBytecode_ReadString(bc, &pc);
+        out->operand = _JechBytecode_ReadString(bc, &pc);
+        break;
+    case OP_ARRAY_NEW:
+        out->name = _JechBytecode_ReadString(bc, &pc);
+        break;
+    case OP_KEEP:
+    case OP_ASSIGN:
+        out->name = get_slot(bc, &pc, &out->slot);
+        out->operand = get_value(bc, &pc, &out->token_type, NULL, &out->operand_slot);
+        break;
+    case OP_BIN_OP:
+        out->dest = (JechDestination)_JechBytecode_ReadVarint(bc, &pc);
+        if (out->dest == JECH_TO_DEFAULT || _JechBytecode_ReadVarint(bc, &pc))
+            out->name = get_slot(bc, &pc, &out->slot);
+        else
+            out->name = NULL;
+        out->bin_op = (JechTokenType)_JechBytecode_ReadVarint(bc, &pc);
+        out->operand = get_value(bc, &pc, &out->token_type, &out->operand_number, &out->operand_slot);
+        out->operand_right = get_value(bc, &pc, &out->cmp_operand_type, &out->operand_right_number,
+                                       &out->operand_right_slot);
+        if (out->dest == JECH_TO_WHEN)
+        {
+            out->then_operand = get_value(bc, &pc, &out->then_token_type, NULL, &out->then_slot);
+            out->has_else = (int)_JechBytecode_ReadVarint(bc, &pc);
+            if (out->has_else)
+                out->else_operand = get_value(bc, &pc, &out->else_token_type, NULL, &out->else_slot);
+        }
+        break;
+    case OP_WHEN:
+    case OP_WHEN_BOOL:
+        out->bin_op = (JechTokenType)_JechBytecode_ReadVarint(bc, &pc);
+        if (out->op == OP_WHEN || out->bin_op != TOKEN_BOOL)
+            out->name = get_slot(bc, &pc, &out->slot);
+        else
+            out->name = _JechBytecode_ReadString(bc, &pc);
+        if (out->op == OP_WHEN)
+        {
+            out->operand = get_value(bc, &pc, &out->cmp_operand_type, &out->operand_number, &out->operand_slot);
+            out->operand_right = get_value(bc, &pc, &out->token_type, NULL, &out->operand_right_slot);
+        }
+        else
+        {
+            out->operand = get_value(bc, &pc, &out->token_type, NULL, &out->operand_slot);
+        }
+        out->has_else = (int)_JechBytecode_ReadVarint(bc, &pc);
+        if (out->has_else)
+            out->else_operand = get_value(bc, &pc, &out->else_token_type, NULL, &out->else_slot);
+        break;
+    case OP_MAP:
+    {
+        out->name = _JechBytecode_ReadString(bc, &pc);
+        out->operand = _JechBytecode_ReadString(bc, &pc);
+        out->bin_op = (JechTokenType)_JechBytecode_ReadVarint(bc, &pc);
+        const JechConstant *c = _JechBytecode_ReadConstant(bc, &pc);
+        out->operand_right = _JechBytecode_Text(bc, c);
+        out->operand_right_number = c->number;
+        break;
+    }
+    case OP_FUNCTION_DECL:
+    {
+        out->name = _JechBytecode_ReadString(bc, &pc);
+        out->param_count = (int)_JechBytecode_ReadVarint(bc, &pc);
+        for (int i = 0; i < out->param_count; i++)
+            out->params[i] = get_slot(bc, &pc, &out->param_slots[i]);
+
+        out->body_bc = NULL;
+        out->body_source = NULL;
+        out->body_offset = 0;
+        out->body_length = 0;
+        uint32_t body = _JechBytecode_ReadVarint(bc, &pc);
+        if (body == 1)
+        {
+            out->body_bc = bc->functions[_JechBytecode_ReadVarint(bc, &pc)];
+        }
+        else if (body == 2)
+        {
+            out->body_source = bc->source;
+            out->body_offset = (int)_JechBytecode_ReadVarint(bc, &pc);
+            out->body_length = (int)_JechBytecode_ReadVarint(bc, &pc);
+        }
+        break;
+    }
+    case OP_FUNCTION_CALL:
+        out->name = _JechBytecode_ReadString(bc, &pc);
+        out->arg_count = (int)_JechBytecode_ReadVarint(bc, &pc);
+        for (int i = 0; i < out->arg_count; i++)
+            out->args[i] = get_value(bc, &pc, &out->arg_types[i], NULL, &out->arg_slots[i]);
+        out->dest = (JechDestination)_JechBytecode_ReadVarint(bc, &pc);
+        if (out->dest == JECH_TO_KEEP)
+            out->operand = get_slot(bc, &pc, &out->operand_slot);
+        break;
+    case OP_END:
+        break;
+    default:
+        // Nothing else was ever emitted; stop rather than misread operands
+        return bc->length;
+    }
+    return pc;
+}
+
+/**
+ * Bounds-checked reads for _JechBytecode_Verify. Each returns 0 if the
+ * operand runs past the end of the code or indexes outside its table.
+ */
+static int check_varint(const Bytecode *bc, int *pc, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (*pc >= bc->length)
+            return 0;
+        uint8_t byte = bc->code[(*pc)++];
+        // The fifth byte only has room for the top four bits
+        if (shift == 28 && (byte & 0xF0))
+            return 0;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_below(const Bytecode *bc, int *pc, uint32_t limit)
+{
+    uint32_t value;
+    return check_varint(bc, pc, &value) && value < limit;
+}
+
+static int check_constant(const Bytecode *bc, int *pc)
+{
+    return check_below(bc, pc, (uint32_t)bc->constant_count);
+}
+
+/**
+ * A slot; the result register is only accepted where `allow_result` says
+ * the VM reads it like a variable
+ */
+static int check_slot(const Bytecode *bc, int *pc, int allow_result)
+{
+    uint32_t encoded;
+    if (!check_varint(bc, pc, &encoded))
+        return 0;
+    return encoded == 0 ? allow_result : encoded - 1 < (uint32_t)bc->slot_count;
+}
+
+static int check_value(const Bytecode *bc, int *pc)
+{
+    uint32_t type;
+    if (!check_varint(bc, pc, &type) || type > TOKEN_UNKNOWN)
+        return 0;
+    return type == TOKEN_IDENTIFIER ? check_slot(bc, pc, 1) : check_constant(bc, pc);
+}
+
+/**
+ * The then and else values ending an OP_WHEN, OP_WHEN_BOOL or branching
+ * OP_BIN_OP, from the else flag on
+ */
+static int check_else(const Bytecode *bc, int *pc)
+{
+    uint32_t has_else;
+    if (!check_varint(bc, pc, &has_else) || has_else > 1)
+        return 0;
+    return !has_else || check_value(bc, pc);
+}
+
+/**
+ * Checks the operands of the instruction at `pc` the way _JechBytecode_Decode
+ * reads them; returns the pc of the next instruction, or -1
+ */
+static int check_instruction(const Bytecode *bc, int pc, size_t source_length)
+{
+    uint32_t value;
+    switch ((OpCode)bc->code[pc++])
+    {
+    case OP_SAY:
+    case OP_RETURN:
+        return check_value(bc, &pc) ? pc : -1;
+    case OP_SAY_INDEX:
+    case OP_ARRAY_PUSH:
+        return check_constant(bc, &pc) && check_constant(bc, &pc) ? pc : -1;
+    case OP_ARRAY_NEW:
+        return check_constant(bc, &pc) ? pc : -1;
+    case OP_KEEP:
+    case OP_ASSIGN:
+        return check_slot(bc, &pc, 0) && check_value(bc, &pc) ? pc : -1;
+    case OP_BIN_OP:
+    {
+        uint32_t dest, stored = 1;
+        if (!check_varint(bc, &pc, &dest) || dest == JECH_TO_KEEP || dest > JECH_TO_WHEN)
+            return -1;
+        if (dest != JECH_TO_DEFAULT && (!check_varint(bc, &pc, &stored) || stored > 1))
+            return -1;
+        if ((stored && !check_slot(bc, &pc, 1)) || !check_varint(bc, &pc, &value) ||
+            !check_value(bc, &pc) || !check_value(bc, &pc))
+            return -1;
+        if (dest == JECH_TO_WHEN && (!check_value(bc, &pc) || !check_else(bc, &pc)))
+            return -1;
+        return pc;
+    }
+    case OP_WHEN:
+    case OP_WHEN_BOOL:
+    {
+        int is_when = bc->code[pc - 1] == OP_WHEN;
+        uint32_t type;
+        if (!check_varint(bc, &pc, &type))
+            return -1;
+        if (!(is_when || type != TOKEN_BOOL ? check_slot(bc, &pc, 1) : check_constant(bc, &pc)) ||
+            !check_value(bc, &pc) || (is_when && !check_value(bc, &pc)) || !check_else(bc, &pc))
+            return -1;
+        return pc;
+    }
+    case OP_MAP:
+        if (!check_constant(bc, &pc) || !check_constant(bc, &pc) || !check_varint(bc, &pc, &value))
+            return -1;
+        return check_constant(bc, &pc) ? pc : -1;
+    case OP_FUNCTION_DECL:
+    {
+        uint32_t count, body;
+        if (!check_constant(bc, &pc) || !check_varint(bc, &pc, &count) || count > JECH_MAX_OPERANDS)
+            return -1;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!check_slot(bc, &pc, 0))
+                return -1;
+        }
+        if (!check_varint(bc, &pc, &body))
+            return -1;
+        if (body == 1)
+            return check_below(bc, &pc, (uint32_t)bc->function_count) ? pc : -1;
+        if (body == 2)
+        {
+            // A lazy body is lexed from the program text on its first call
+            uint32_t offset, length;
+            if (!bc->source || !check_varint(bc, &pc, &offset) || !check_varint(bc, &pc, &length) ||
+                (size_t)offset + length > source_length)
+                return -1;
+            return pc;
+        }
+        return body == 0 ? pc : -1;
+    }
+    case OP_FUNCTION_CALL:
+    {
+        uint32_t count, dest;
+        if (!check_constant(bc, &pc) || !check_varint(bc, &pc, &count) || count > JECH_MAX_OPERANDS)
+            return -1;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!check_value(bc, &pc))
+                return -1;
+        }
+        if (!check_varint(bc, &pc, &dest) || (dest != JECH_TO_DEFAULT && dest != JECH_TO_KEEP))
+            return -1;
+        return dest != JECH_TO_KEEP || check_slot(bc, &pc, 0) ? pc : -1;
+    }
+    case OP_END:
+        return pc;
+    default:
+        return -1;
+    }
+}
+
+int _JechBytecode_Verify(const Bytecode *bc, size_t source_length)
+{
+    if (bc->length <= 0 || bc->code[bc->length - 1] != OP_END)
+        return 0;
+    if (bc->strings_length > 0 && bc->strings[bc->strings_length - 1] != '\0')
+        return 0;
+    for (int i = 0; i < bc->constant_count; i++)
+    {
+        if (bc->constants[i].text >= (uint32_t)bc->strings_length)
+            return 0;
+    }
+    for (int i = 0; i < bc->slot_count; i++)
+    {
+        if (bc->slots[i] >= (uint32_t)bc->constant_count)
+            return 0;
+    }
+
+    for (int pc = 0; pc < bc->length;)
+    {
+        pc = check_instruction(bc, pc, source_length);
+        if (pc < 0)
+            return 0;
+    }
+    for (int i = 0; i < bc->function_count; i++)
+    {
+        if (!bc->functions[i] || !_JechBytecode_Verify(bc->functions[i], source_length))
+            return 0;
+    }
+    return 1;
+}
+
+void _JechBytecode_SetOffset(Bytecode *bc, int offset)
+{
+    if (bc->line_count > 0)
+    {
+        JechLineEntry *last = &bc->lines[bc->line_count - 1];
+        if (last->offset == offset)
+            return;
+        if (last->pc == (uint32_t)bc->length)
+        {
+            // The previous statement emitted nothing
+            last->offset = offset;
+            return;
+        }
+    }
+    RESERVE(bc, lines, line_capacity, bc->line_count + 1);
+    bc->lines[bc->line_count].pc = (uint32_t)bc->length;
+    bc->lines[bc->line_count].offset = offset;
+    bc->line_count++;
+}
+
+int _JechBytecode_OffsetAt(const Bytecode *bc, int pc)
+{
+    // Last entry starting at or before pc
+    int low = 0, high = bc->line_count;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (bc->lines[mid].pc <= (uint32_t)pc)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low > 0 ? bc->lines[low - 1].offset : -1;
+}
+
+void _JechBytecode_Finish(Bytecode *bc)
+{
+    free(bc->lookup);
+    bc->lookup = NULL;
+    bc->lookup_capacity = 0;
+    free(bc->slot_lookup);
+    bc->slot_lookup = NULL;
+    bc->slot_lookup_capacity = 0;
+}
+
+void _JechBytecode_Link(Bytecode *bc)
+{
+    if (!bc->links)
+    {
+        bc->links = malloc(sizeof(JechSymbol) * (bc->slot_count > 0 ? bc->slot_count : 1));
+        if (!bc->links)
+            out_of_memory();
+        for (int i = 0; i < bc->slot_count; i++)
+        {
+            const char *name = bc->strings + bc->constants[bc->slots[i]].text;
+            bc->links[i] = _JechSymbol_Intern(name, (int)strlen(name));
+        }
+    }
+
+    for (int i = 0; i < bc->function_count; i++)
+        _JechBytecode_Link(bc->functions[i]);
+}
+
+size_t _JechBytecode_Size(const Bytecode *bc)
+{
+    return sizeof(Bytecode) + (size_t)bc->length +
+           sizeof(JechConstant) * bc->constant_count + (size_t)bc->strings_length +
+           sizeof(uint32_t) * bc->slot_count + sizeof(Bytecode *) * bc->function_count +
+           sizeof(JechLineEntry) * bc->line_count;
+}
+
+void _JechBytecode_Free(Bytecode *bc)
+{
+    if (!bc->borrowed)
+    {
+        free(bc->code);
+        free(bc->constants);
+        free(bc->strings);
+        free(bc->slots);
+        free(bc->lines);
+    }
+    free(bc->lookup);
+    free(bc->slot_lookup);
+    free(bc->links);
+    free(bc->functions);
+    memset(bc, 0, sizeof(*bc));
+}
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#include "core/document.h"
+#include "core/parser/parser.h"
+#include "core/lines.h"
+#include "errors/error.h"
+
+/**
+ * Byte offset of a token in the document text
+ */
+static int token_offset(const JechDocument *doc, const JechToken *token)
+{
+	return (int)(token->start - doc->text);
+}
+
+static void free_statement(JechDocStatement *statement)
+{
+	_JechFlatAST_Free(&statement->ast);
+	free_diagnostics(&statement->diagnostics);
+}
+
+/**
+ * Lexes from the lexer's position, appending tokens to `out` until EOF
+ */
+static int lex_to_end(JechLexer *lexer, JechTokenList *out)
+{
+	JechToken token;
+	do
+	{
+		token = _JechTokenizer_Next(lexer);
+		if (!_JechTokenizer_Push(out, token))
+			return 0;
+	} while (token.type != TOKEN_EOF);
+	return 1;
+}
+
+/**
+ * Finds where the statement starting at token `first` ends (exclusive),
+ * using the same boundary rules as the streaming parser
+ */
+static int statement_end(const JechDocument *doc, int first)
+{
+	const JechToken *t = doc->tokens.tokens;
+	JechStatementScan scan = {0, 0, 0};
+	int i = first;
+
+	while (t[i].type != TOKEN_EOF)
+	{
+		JechStatementStep step = _JechParser_ScanStatement(&scan, &t[i]);
+		i++;
+		if (step == JECH_STMT_END)
+			break;
+		if (step == JECH_STMT_END_UNLESS_ELSE && t[i].type != TOKEN_ELSE)
+			break;
+	}
+	return i;
+}
+
+/**
+ * Parses tokens [first, end) as one statement window
+ */
+static int parse_statement(JechDocument *doc, int first, int end, JechDocStatement *out)
+{
+	out->first_token = first;
+	out->token_count = end - first;
+	out->ok = 1;
+	_JechFlatAST_Init(&out->ast);
+	memset(&out->diagnostics, 0, sizeof(out->diagnostics));
+
+	doc->window.count = 0;
+	for (int i = first; i < end; i++)
+	{
+		if (!_JechTokenizer_Push(&doc->window, doc->tokens.tokens[i]))
+			return 0;
+	}
+	if (!_JechParser_TerminateWindow(&doc->window))
+		return 0;
+
+	// Each statement owns its AST, so replacing it frees its nodes in one go.
+	// Its errors are kept with it too: the statement is not parsed again
+	// until an edit reaches it, but they are reported on every run.
+	JechDiagnostics *previous = capture_diagnostics(&out->diagnostics);
+	const JechToken *t = doc->window.tokens;
+	int i = 0;
+	while (i < doc->window.count && t[i].type != TOKEN_EOF)
+	{
+		int consumed = 0;
+		JechNodeId node = _JechParser_ParseStatement(&out->ast, &t[i], doc->window.count - i, &consumed);
+		if (node == JECH_NO_NODE)
+		{
+			out->ok = 0;
+			break;
+		}
+		_JechFlatAST_AddRoot(&out->ast, node);
+		i += consumed;
+	}
+	capture_diagnostics(previous);
+
+	// Later edits move the statement, so hold offsets from its first token
+	for (int d = 0; d < out->diagnostics.count; d++)
+		out->diagnostics.items[d].offset -= t[0].offset;
+
+	doc->reparsed_statements++;
+	return 1;
+}
+
+/**
+ * Index of the statement holding token `index`, or statement_count if the
+ * token lies past the last statement
+ */
+static int find_statement(const JechDocument *doc, int index)
+{
+	int lo = 0;
+	int hi = doc->statement_count;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		const JechDocStatement *s = &doc->statements[mid];
+		if (s->first_token + s->token_count <= index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * Re-parses the statements around a token splice. Tokens [from, damaged_end)
+ * are new; every token after them is unchanged and moved by `token_delta`.
+ * Parsing stops once a new statement boundary lines up with an old one
+ * past the damage.
+ */
+static int reparse(JechDocument *doc, int from, int damaged_end, int token_delta)
+{
+	int first = find_statement(doc, from > 0 ? from - 1 : 0);
+	int pos = 0;
+	if (first < doc->statement_count)
+		pos = doc->statements[first].first_token;
+	else if (doc->statement_count > 0)
+		pos = doc->statements[first - 1].first_token + doc->statements[first - 1].token_count;
+	int old_next = first;
+
+	JechDocStatement *fresh = NULL;
+	int fresh_count = 0;
+	int fresh_capacity = 0;
+	int ok = 1;
+
+	while (doc->tokens.tokens[pos].type != TOKEN_EOF)
+	{
+		if (pos >= damaged_end)
+		{
+			// Old statements start in pre-splice token indices
+			while (old_next < doc->statement_count &&
+				   doc->statements[old_next].first_token + token_delta < pos)
+				old_next++;
+			if (old_next < doc->statement_count &&
+				doc->statements[old_next].first_token + token_delta == pos)
+				break;
+		}
+
+		if (fresh_count >= fresh_capacity)
+		{
+			fresh_capacity = fresh_capacity ? fresh_capacity * 2 : 4;
+			JechDocStatement *grown = realloc(fresh, sizeof(JechDocStatement) * fresh_capacity);
+			if (!grown)
+			{
+				ok = 0;
+				break;
+			}
+			fresh = grown;
+		}
+
+		int end = statement_end(doc, pos);
+		if (!parse_statement(doc, pos, end, &fresh[fresh_count]))
+		{
+			ok = 0;
+			break;
+		}
+		fresh_count++;
+		pos = end;
+	}
+
+	if (doc->tokens.tokens[pos].type == TOKEN_EOF)
+		old_next = doc->statement_count;
+
+	if (!ok)
+	{
+		for (int i = 0; i < fresh_count; i++)
+			free_statement(&fresh[i]);
+		free(fresh);
+		return 0;
+	}
+
+	// Swap statements [first, old_next) for the fresh ones
+	int new_count = doc->statement_count - (old_next - first) + fresh_count;
+	if (new_count > doc->statement_capacity)
+	{
+		int capacity = doc->statement_capacity ? doc->statement_capacity : 16;
+		while (capacity < new_count)
+			capacity *= 2;
+		JechDocStatement *grown = realloc(doc->statements, sizeof(JechDocStatement) * capacity);
+		if (!grown)
+		{
+			for (int i = 0; i < fresh_count; i++)
+				free_statement(&fresh[i]);
+			free(fresh);
+			return 0;
+		}
+		doc->statements = grown;
+		doc->statement_capacity = capacity;
+	}
+
+	for (int i = first; i < old_next; i++)
+		free_statement(&doc->statements[i]);
+
+	memmove(&doc->statements[first + fresh_count], &doc->statements[old_next],
+			sizeof(JechDocStatement) * (doc->statement_count - old_next));
+	memcpy(&doc->statements[first], fresh, sizeof(JechDocStatement) * fresh_count);
+	doc->statement_count = new_count;
+
+	for (int i = first + fresh_count; i < doc->statement_count; i++)
+		doc->statements[i].first_token += token_delta;
+
+	free(fresh);
+	return 1;
+}
+
+int _JechDocument_Init(JechDocument *doc, const char *source)
+{
+	memset(doc, 0, sizeof(*doc));
+
+	int length = (int)strlen(source);
+	doc->capacity = length + 1;
+	doc->text = malloc(doc->capacity);
+	if (!doc->text)
+		return 0;
+	memcpy(doc->text, source, length + 1);
+	doc->length = length;
+
+	JechLexer lexer;
+	_JechTokenizer_Init(&lexer, doc->text);
+	if (!lex_to_end(&lexer, &doc->tokens))
+		return 0;
+	doc->relexed_tokens = doc->tokens.count;
+
+	return reparse(doc, 0, doc->tokens.count, 0);
+}
+
+/**
+ * Index of the first token ending at or after `offset`
+ */
+static int find_damaged_token(const JechDocument *doc, int offset)
+{
+	int lo = 0;
+	int hi = doc->tokens.count - 1; // EOF always qualifies
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		const JechToken *t = &doc->tokens.tokens[mid];
+		if (token_offset(doc, t) + t->length < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int _JechDocument_Edit(JechDocument *doc, int offset, int removed, const char *inserted, int inserted_length)
+{
+	if (offset < 0 || removed < 0 || inserted_length < 0 || offset + removed > doc->length)
+		return 0;
+
+	doc->relexed_tokens = 0;
+	doc->reparsed_statements = 0;
+
+	// Restart lexing at a token boundary no later than the edit (or at the
+	// top of the text)
+	int restart = find_damaged_token(doc, offset);
+	JechToken *t = doc->tokens.tokens;
+	if (restart > 0 && t[restart].offset > offset)
+		restart--;
+	int restart_offset = restart > 0 ? t[restart].offset : 0;
+
+	// Splice the text, moving token slices into the new buffer
+	int delta = inserted_length - removed;
+	int new_length = doc->length + delta;
+	char *old_text = doc->text;
+	if (new_length + 1 > doc->capacity)
+	{
+		int capacity = doc->capacity * 2;
+		if (capacity < new_length + 1)
+			capacity = new_length + 1;
+		char *text = realloc(doc->text, capacity);
+		if (!text)
+			return 0;
+		doc->text = text;
+		doc->capacity = capacity;
+	}
+	memmove(doc->text + offset + inserted_length, doc->text + offset + removed, doc->length - offset - removed + 1);
+	memcpy(doc->text + offset, inserted, inserted_length);
+	doc->length = new_length;
+
+	int old_end = offset + removed;
+	int first_kept = doc->tokens.count;
+	int first_moved = doc->text != old_text ? 0 : restart;
+	for (int i = first_moved; i < doc->tokens.count; i++)
+	{
+		int shift = 0;
+		if (t[i].offset >= old_end)
+		{
+			shift = delta;
+			t[i].offset += delta;
+			if (i < first_kept)
+				first_kept = i;
+		}
+		t[i].start = doc->text + (t[i].start - old_text) + shift;
+	}
+
+	// Re-lex until a fresh token lines up with an old one past the edit
+	JechLexer lexer;
+	_JechTokenizer_Init(&lexer, doc->text);
+	lexer.p = doc->text + restart_offset;
+
+	JechTokenList fresh = {NULL, 0, 0};
+	int resync = first_kept;
+	JechToken token;
+	for (;;)
+	{
+		token = _JechTokenizer_Next(&lexer);
+		doc->relexed_tokens++;
+
+		while (resync < doc->tokens.count && t[resync].offset < token.offset)
+			resync++;
+		if (resync < doc->tokens.count && t[resync].offset == token.offset &&
+			t[resync].type == token.type && t[resync].length == token.length)
+			break;
+
+		if (!_JechTokenizer_Push(&fresh, token))
+		{
+			_JechTokenizer_Free(&fresh);
+			return 0;
+		}
+	}
+
+	// Swap tokens [restart, resync) for the fresh ones
+	int token_delta = fresh.count - (resync - restart);
+	int tail = doc->tokens.count - resync;
+	if (doc->tokens.count + token_delta > doc->tokens.capacity)
+	{
+		int capacity = (doc->tokens.count + token_delta) * 2;
+		JechToken *tokens = realloc(doc->tokens.tokens, sizeof(JechToken) * capacity);
+		if (!tokens)
+		{
+			_JechTokenizer_Free(&fresh);
+			return 0;
+		}
+		doc->tokens.tokens = tokens;
+		doc->tokens.capacity = capacity;
+		t = tokens;
+	}
+	memmove(&t[restart + fresh.count], &t[resync], sizeof(JechToken) * tail);
+	memcpy(&t[restart], fresh.tokens, sizeof(JechToken) * fresh.count);
+	doc->tokens.count += token_delta;
+	int damaged_end = restart + fresh.count;
+	_JechTokenizer_Free(&fresh);
+
+	return reparse(doc, restart, damaged_end, token_delta);
+}
+
+JechFlatAST **_JechDocument_Parts(const JechDocument *doc, int *out_count, int *out_failed)
+{
+	*out_count = 0;
+	*out_failed = 0;
+	JechFlatAST **parts = malloc(sizeof(JechFlatAST *) * (doc->statement_count ? doc->statement_count : 1));
+	if (!parts)
+	{
+		report_error(ERROR_PARSER, "Out of memory", 0, 0);
+		return NULL;
+	}
+
+	int count = 0;
+	for (int i = 0; i < doc->statement_count; i++)
+	{
+		if (!doc->statements[i].ok)
+		{
+			*out_failed = 1;
+			break;
+		}
+		parts[count++] = &doc->statements[i].ast;
+	}
+
+	*out_count = count;
+	return parts;
+}
+
+void _JechDocument_Report(const JechDocument *doc)
+{
+	_JechLines_SetSource(doc->text);
+	for (int i = 0; i < doc->statement_count; i++)
+	{
+		const JechDocStatement *s = &doc->statements[i];
+		report_diagnostics(&s->diagnostics, doc->tokens.tokens[s->first_token].offset);
+		if (!s->ok)
+			break;
+	}
+}
+
+void _JechDocument_Free(JechDocument *doc)
+{
+	for (int i = 0; i < doc->statement_count; i++)
+		free_statement(&doc->statements[i]);
+	free(doc->statements);
+	_JechTokenizer_Free(&doc->tokens);
+	_JechTokenizer_Free(&doc->window);
+	free(doc->text);
+	memset(doc, 0, sizeof(*doc));
+}
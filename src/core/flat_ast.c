@@ -0,0 +1,264 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/flat_ast.h"
+
+// Small enough that a document can hold one AST per statement
+#define FLAT_AST_INITIAL_CAPACITY 16
+
+static void out_of_memory()
+{
+    fprintf(stderr, "AST error: out of memory\n");
+    exit(1);
+}
+
+/**
+ * Makes room for one more node in every column. The columns are carved
+ * out of a single block, widest first so each stays aligned.
+ */
+static void reserve_node(JechFlatAST *ast)
+{
+    if (ast->count < ast->capacity)
+        return;
+
+    int capacity = ast->capacity ? ast->capacity * 2 : FLAT_AST_INITIAL_CAPACITY;
+    size_t row = sizeof(*ast->payload) + sizeof(*ast->value) + sizeof(*ast->name) +
+                 sizeof(*ast->left) + sizeof(*ast->right) + sizeof(*ast->extra) +
+                 sizeof(*ast->offset) + sizeof(*ast->type) + sizeof(*ast->token_type) +
+                 sizeof(*ast->op) + sizeof(*ast->flags);
+    char *block = malloc(row * capacity);
+    if (!block)
+        out_of_memory();
+
+    JechFlatAST grown = *ast;
+    char *p = block;
+#define CARVE(column)                                                      \
+    do                                                                     \
+    {                                                                      \
+        grown.column = (void *)p;                                          \
+        if (ast->count > 0)                                                \
+            memcpy(p, ast->column, sizeof(*ast->column) * ast->count);     \
+        p += sizeof(*ast->column) * capacity;                              \
+    } while (0)
+
+    CARVE(payload);
+    CARVE(value);
+    CARVE(name);
+    CARVE(left);
+    CARVE(right);
+    CARVE(extra);
+    CARVE(offset);
+    CARVE(type);
+    CARVE(token_type);
+    CARVE(op);
+    CARVE(flags);
+#undef CARVE
+
+    free(ast->payload);
+    grown.capacity = capacity;
+    *ast = grown;
+}
+
+/**
+ * Grows an id array to hold `needed` entries
+ */
+static void reserve_ids(JechNodeId **ids, int *capacity, int needed)
+{
+    if (needed <= *capacity)
+        return;
+
+    int grown_capacity = *capacity ? *capacity : FLAT_AST_INITIAL_CAPACITY;
+    while (grown_capacity < needed)
+        grown_capacity *= 2;
+    JechNodeId *grown = realloc(*ids, sizeof(JechNodeId) * grown_capacity);
+    if (!grown)
+        out_of_memory();
+    *ids = grown;
+    *capacity = grown_capacity;
+}
+
+/**
+ * Copies `length` bytes of `start` into the text pool and returns their
+ * offset
+ */
+static uint32_t add_text(JechFlatAST *ast, const char *start, int length)
+{
+    if (length <= 0)
+        return JECH_NO_TEXT;
+
+    if (ast->text_length + length + 1 > ast->text_capacity)
+    {
+        // `start` may point into the pool that is about to move
+        ptrdiff_t inside = start >= ast->text && start < ast->text + ast->text_length ? start - ast->text : -1;
+
+        int capacity = ast->text_capacity ? ast->text_capacity : FLAT_AST_INITIAL_CAPACITY * 8;
+        while (capacity < ast->text_length + length + 1)
+            capacity *= 2;
+        char *grown = realloc(ast->text, capacity);
+        if (!grown)
+            out_of_memory();
+        ast->text = grown;
+        ast->text_capacity = capacity;
+        if (inside >= 0)
+            start = ast->text + inside;
+    }
+
+    uint32_t offset = (uint32_t)ast->text_length;
+    memcpy(ast->text + offset, start, length);
+    ast->text[offset + length] = '\0';
+    ast->text_length += length + 1;
+    return offset;
+}
+
+void _JechFlatAST_Init(JechFlatAST *ast)
+{
+    memset(ast, 0, sizeof(*ast));
+}
+
+JechNodeId _JechFlatAST_AddNode(JechFlatAST *ast, JechASTType type, JechTokenType token_type)
+{
+    reserve_node(ast);
+
+    JechNodeId id = (JechNodeId)ast->count++;
+    ast->payload[id] = 0;
+    ast->value[id] = JECH_NO_TEXT;
+    ast->name[id] = JECH_NO_SYMBOL;
+    ast->left[id] = JECH_NO_NODE;
+    ast->right[id] = JECH_NO_NODE;
+    ast->extra[id] = JECH_NO_NODE;
+    ast->offset[id] = -1;
+    ast->type[id] = type;
+    ast->token_type[id] = token_type;
+    ast->op[id] = 0;
+    ast->flags[id] = 0;
+    return id;
+}
+
+JechNodeId _JechFlatAST_AddTokenNode(JechFlatAST *ast, JechASTType type, const JechToken *value, const JechToken *name, JechTokenType token_type)
+{
+    JechNodeId id = _JechFlatAST_AddNode(ast, type, token_type);
+    if (value)
+    {
+        ast->value[id] = add_text(ast, value->start, value->length);
+        if (value->type == TOKEN_NUMBER)
+            _JechFlatAST_SetNumber(ast, id, value->number);
+    }
+    _JechFlatAST_SetName(ast, id, name);
+    return id;
+}
+
+void _JechFlatAST_AddRoot(JechFlatAST *ast, JechNodeId id)
+{
+    reserve_ids(&ast->roots, &ast->root_capacity, ast->root_count + 1);
+    ast->roots[ast->root_count++] = id;
+}
+
+void _JechFlatAST_SetBody(JechFlatAST *ast, JechNodeId id, const JechNodeId *statements, int count)
+{
+    reserve_ids(&ast->lists, &ast->list_capacity, ast->list_count + count);
+    if (count > 0)
+        memcpy(&ast->lists[ast->list_count], statements, sizeof(JechNodeId) * count);
+    ast->extra[id] = (JechNodeId)ast->list_count;
+    ast->payload[id] = count;
+    ast->list_count += count;
+}
+
+void _JechFlatAST_SetLazyBody(JechFlatAST *ast, JechNodeId id, const char *source, int offset, int length)
+{
+    ast->source = source;
+    ast->flags[id] |= JECH_AST_LAZY;
+    ast->payload[id] = (int64_t)(uint32_t)offset | (int64_t)length << 32;
+}
+
+void _JechFlatAST_SetName(JechFlatAST *ast, JechNodeId id, const JechToken *name)
+{
+    // Names are identifiers, interned in full by the lexer
+    if (!name || name->length <= 0)
+        ast->name[id] = JECH_NO_SYMBOL;
+    else if (name->symbol != JECH_NO_SYMBOL)
+        ast->name[id] = name->symbol;
+    else
+        ast->name[id] = _JechSymbol_Intern(name->start, name->length);
+}
+
+void _JechFlatAST_SetValue(JechFlatAST *ast, JechNodeId id, const char *text)
+{
+    ast->value[id] = add_text(ast, text, (int)strlen(text));
+}
+
+void _JechFlatAST_SetNumber(JechFlatAST *ast, JechNodeId id, JechNumber number)
+{
+    ast->flags[id] = number.is_float ? ast->flags[id] | JECH_AST_FLOAT : ast->flags[id] & ~JECH_AST_FLOAT;
+    if (number.is_float)
+        memcpy(&ast->payload[id], &number.as.f, sizeof(double));
+    else
+        ast->payload[id] = number.as.i;
+}
+
+const char *_JechFlatAST_Value(const JechFlatAST *ast, JechNodeId id)
+{
+    return ast->value[id] != JECH_NO_TEXT ? ast->text + ast->value[id] : "";
+}
+
+const char *_JechFlatAST_Name(const JechFlatAST *ast, JechNodeId id)
+{
+    return _JechSymbol_Name(ast->name[id]);
+}
+
+JechNumber _JechFlatAST_Number(const JechFlatAST *ast, JechNodeId id)
+{
+    JechNumber number;
+    number.is_float = (ast->flags[id] & JECH_AST_FLOAT) != 0;
+    if (number.is_float)
+        memcpy(&number.as.f, &ast->payload[id], sizeof(double));
+    else
+        number.as.i = ast->payload[id];
+    return number;
+}
+
+const JechNodeId *_JechFlatAST_Body(const JechFlatAST *ast, JechNodeId id, int *out_count)
+{
+    *out_count = ast->flags[id] & JECH_AST_LAZY ? 0 : (int)ast->payload[id];
+    return *out_count > 0 ? &ast->lists[ast->extra[id]] : NULL;
+}
+
+int _JechFlatAST_LazyBody(const JechFlatAST *ast, JechNodeId id, int *out_offset, int *out_length)
+{
+    if (!(ast->flags[id] & JECH_AST_LAZY))
+        return 0;
+    *out_offset = (int)(uint32_t)ast->payload[id];
+    *out_length = (int)(ast->payload[id] >> 32);
+    return 1;
+}
+
+/**
+ * Prints the AST in tree form, indented according to depth.
+ * Useful for visual debugging.
+ */
+void _JechFlatAST_Print(const JechFlatAST *ast, JechNodeId id, int depth)
+{
+    if (id == JECH_NO_NODE)
+        return;
+
+    const char *name = _JechFlatAST_Name(ast, id);
+    const char *value = _JechFlatAST_Value(ast, id);
+    for (int i = 0; i < depth; i++)
+        printf("  ");
+    printf("• %d (%s%s%s)\n", ast->type[id],
+           name,
+           (name[0] && value[0]) ? " = " : "",
+           value);
+
+    _JechFlatAST_Print(ast, ast->left[id], depth + 1);
+    _JechFlatAST_Print(ast, ast->right[id], depth + 1);
+}
+
+void _JechFlatAST_Free(JechFlatAST *ast)
+{
+    free(ast->payload);
+    free(ast->lists);
+    free(ast->roots);
+    free(ast->text);
+    memset(ast, 0, sizeof(*ast));
+}
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "core/image.h"
+#include "core/lines.h"
+
+#define IMAGE_ALIGN 8
+
+/**
+ * Counts of one serialised chunk. Its tables follow, each padded to
+ * IMAGE_ALIGN: constants, slots, lines, strings and code, then the chunks
+ * of the bodies it declares.
+ */
+typedef struct
+{
+    uint32_t length;
+    uint32_t count;
+    uint32_t constant_count;
+    uint32_t strings_length;
+    uint32_t slot_count;
+    uint32_t function_count;
+    uint32_t line_count;
+    uint32_t lazy; // declares lazy bodies, compiled from the program text
+} ImageChunk;
+
+uint64_t _JechImage_Hash(const char *source, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)source[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Writes `size` bytes, then zeros up to the next IMAGE_ALIGN boundary
+ */
+static int write_section(FILE *out, const void *data, size_t size)
+{
+    static const char zeros[IMAGE_ALIGN] = {0};
+    if (size > 0 && fwrite(data, 1, size, out) != size)
+        return 0;
+    size_t padding = (IMAGE_ALIGN - size % IMAGE_ALIGN) % IMAGE_ALIGN;
+    return padding == 0 || fwrite(zeros, 1, padding, out) == padding;
+}
+
+static int write_chunk(FILE *out, const Bytecode *bc)
+{
+    ImageChunk chunk = {
+        (uint32_t)bc->length,
+        (uint32_t)bc->count,
+        (uint32_t)bc->constant_count,
+        (uint32_t)bc->strings_length,
+        (uint32_t)bc->slot_count,
+        (uint32_t)bc->function_count,
+        (uint32_t)bc->line_count,
+        bc->source != NULL,
+    };
+
+    if (!write_section(out, &chunk, sizeof(chunk)) ||
+        !write_section(out, bc->constants, sizeof(JechConstant) * bc->constant_count) ||
+        !write_section(out, bc->slots, sizeof(uint32_t) * bc->slot_count) ||
+        !write_section(out, bc->lines, sizeof(JechLineEntry) * bc->line_count) ||
+        !write_section(out, bc->strings, (size_t)bc->strings_length) ||
+        !write_section(out, bc->code, (size_t)bc->length))
+        return 0;
+
+    for (int i = 0; i < bc->function_count; i++)
+    {
+        if (!write_chunk(out, bc->functions[i]))
+            return 0;
+    }
+    return 1;
+}
+
+int _JechImage_Write(FILE *out, const Bytecode *bc, const char *source, size_t length)
+{
+    JechLineIndex lines;
+    if (!_JechLineIndex_Build(&lines, source))
+        return 0;
+
+    JechImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JECH_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = JECH_IMAGE_VERSION;
+    header.source_hash = _JechImage_Hash(source, length);
+    header.source_length = length;
+    header.line_count = (uint32_t)lines.count;
+
+    int written = write_section(out, &header, sizeof(header)) &&
+                  write_section(out, lines.starts, sizeof(int) * lines.count) &&
+                  write_section(out, source, length) &&
+                  write_chunk(out, bc);
+    _JechLineIndex_Free(&lines);
+    return written;
+}
+
+const JechImageHeader *_JechImage_Header(const void *data, size_t length)
+{
+    const JechImageHeader *header = data;
+    if (length < sizeof(JechImageHeader) ||
+        memcmp(header->magic, JECH_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != JECH_IMAGE_VERSION)
+        return NULL;
+    return header;
+}
+
+/**
+ * Read position in an image
+ */
+typedef struct
+{
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+} ImageCursor;
+
+/**
+ * Returns the next `size` bytes and skips their padding, or NULL if they
+ * or their padding run past the end of the image
+ */
+static const void *take(ImageCursor *cursor, size_t size)
+{
+    size_t padded = size + (IMAGE_ALIGN - size % IMAGE_ALIGN) % IMAGE_ALIGN;
+    if (padded < size || padded > cursor->length - cursor->offset)
+        return NULL;
+    const void *section = cursor->data + cursor->offset;
+    cursor->offset += padded;
+    return section;
+}
+
+/**
+ * Frees what loading a chunk allocated, including its bodies
+ */
+static void discard_chunk(Bytecode *bc)
+{
+    for (int i = 0; i < bc->function_count; i++)
+    {
+        if (bc->functions[i])
+        {
+            discard_chunk(bc->functions[i]);
+            free(bc->functions[i]);
+        }
+    }
+    _JechBytecode_Free(bc);
+}
+
+static int load_chunk(ImageCursor *cursor, const char *source, Bytecode *bc)
+{
+    memset(bc, 0, sizeof(*bc));
+    bc->borrowed = 1;
+
+    const ImageChunk *chunk = take(cursor, sizeof(ImageChunk));
+    if (!chunk || chunk->length > INT32_MAX || chunk->strings_length > INT32_MAX || (chunk->lazy && !source))
+        return 0;
+
+    bc->constants = (JechConstant *)take(cursor, sizeof(JechConstant) * (size_t)chunk->constant_count);
+    bc->slots = (uint32_t *)take(cursor, sizeof(uint32_t) * (size_t)chunk->slot_count);
+    bc->lines = (JechLineEntry *)take(cursor, sizeof(JechLineEntry) * (size_t)chunk->line_count);
+    bc->strings = (char *)take(cursor, chunk->strings_length);
+    bc->code = (uint8_t *)take(cursor, chunk->length);
+    if (!bc->constants || !bc->slots || !bc->lines || !bc->strings || !bc->code)
+        return 0;
+
+    bc->length = bc->capacity = (int)chunk->length;
+    bc->count = (int)chunk->count;
+    bc->constant_count = bc->constant_capacity = (int)chunk->constant_count;
+    bc->strings_length = bc->strings_capacity = (int)chunk->strings_length;
+    bc->slot_count = bc->slot_capacity = (int)chunk->slot_count;
+    bc->line_count = bc->line_capacity = (int)chunk->line_count;
+    bc->source = chunk->lazy ? source : NULL;
+
+    // Bodies are the only part that is not borrowed from the image
+    if (chunk->function_count > (cursor->length - cursor->offset) / sizeof(ImageChunk))
+        return 0;
+    if (chunk->function_count > 0)
+    {
+        bc->functions = calloc(chunk->function_count, sizeof(Bytecode *));
+        if (!bc->functions)
+            return 0;
+        bc->function_count = bc->function_capacity = (int)chunk->function_count;
+    }
+    for (int i = 0; i < bc->function_count; i++)
+    {
+        bc->functions[i] = malloc(sizeof(Bytecode));
+        if (!bc->functions[i])
+            return 0;
+        if (!load_chunk(cursor, source, bc->functions[i]))
+        {
+            discard_chunk(bc->functions[i]);
+            free(bc->functions[i]);
+            bc->functions[i] = NULL;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int _JechImage_Load(const void *data, size_t length, const char *source, size_t source_length, Bytecode *out)
+{
+    if (!_JechImage_Header(data, length))
+        return 0;
+
+    ImageCursor cursor = {data, length, 0};
+    const JechImageHeader *header = take(&cursor, sizeof(JechImageHeader));
+    const int *line_starts = take(&cursor, sizeof(int) * (size_t)header->line_count);
+    if (!line_starts || header->source_length > INT32_MAX)
+        return 0;
+    const char *text = take(&cursor, (size_t)header->source_length);
+    if (!text)
+        return 0;
+    if (source && (header->source_length != (uint64_t)source_length ||
+                   memcmp(text, source, source_length) != 0))
+        return 0;
+    // Nothing from the image is decoded before every operand is checked
+    if (!load_chunk(&cursor, source, out) || cursor.offset != length ||
+        !_JechBytecode_Verify(out, (size_t)header->source_length))
+    {
+        discard_chunk(out);
+        return 0;
+    }
+    if (!source && header->line_count > 0)
+        _JechLines_SetIndex(line_starts, (int)header->line_count, (int)header->source_length);
+
+    _JechBytecode_Link(out);
+    return 1;
+}
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include "core/lines.h"
+#include "core/scan.h"
+
+#define JECH_INITIAL_LINES 64
+
+/**
+ * Records the start of every line, using the vectorised line scanner
+ */
+int _JechLineIndex_Build(JechLineIndex *index, const char *text)
+{
+	int capacity = JECH_INITIAL_LINES;
+	index->text = text;
+	index->length = 0;
+	index->count = 0;
+	index->starts = malloc(sizeof(int) * capacity);
+	if (!index->starts)
+		return 0;
+
+	const char *p = text;
+	for (;;)
+	{
+		if (index->count == capacity)
+		{
+			capacity *= 2;
+			int *starts = realloc(index->starts, sizeof(int) * capacity);
+			if (!starts)
+			{
+				_JechLineIndex_Free(index);
+				return 0;
+			}
+			index->starts = starts;
+		}
+		index->starts[index->count++] = (int)(p - text);
+
+		p = _JechScan_FindLineEnd(p);
+		if (*p == '\0')
+			break;
+		p++;
+	}
+
+	index->length = (int)(p - text);
+	return 1;
+}
+
+/**
+ * Finds the last line starting at or before `offset`
+ */
+void _JechLineIndex_Locate(const JechLineIndex *index, int offset, int *line, int *column)
+{
+	if (!index->starts || offset < 0 || offset > index->length)
+	{
+		*line = 0;
+		*column = 0;
+		return;
+	}
+
+	int low = 0;
+	int high = index->count - 1;
+	while (low < high)
+	{
+		int mid = low + (high - low + 1) / 2;
+		if (index->starts[mid] <= offset)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	*line = low + 1;
+	*column = offset - index->starts[low] + 1;
+}
+
+/**
+ * Releases the memory held by the index
+ */
+void _JechLineIndex_Free(JechLineIndex *index)
+{
+	free(index->starts);
+	index->starts = NULL;
+	index->count = 0;
+	index->length = 0;
+}
+
+/**
+ * Diagnostic source and its index, built on first lookup
+ */
+static const char *diagnostic_text = NULL;
+static JechLineIndex diagnostic_index = {NULL, 0, NULL, 0};
+static int diagnostic_indexed = 0;
+
+void _JechLines_SetSource(const char *text)
+{
+	diagnostic_text = text;
+	diagnostic_indexed = 0;
+}
+
+int _JechLines_SetIndex(const int *starts, int count, int length)
+{
+	_JechLineIndex_Free(&diagnostic_index);
+	diagnostic_text = NULL;
+	diagnostic_indexed = 0;
+
+	diagnostic_index.starts = malloc(sizeof(int) * (count > 0 ? count : 1));
+	if (!diagnostic_index.starts)
+		return 0;
+	for (int i = 0; i < count; i++)
+		diagnostic_index.starts[i] = starts[i];
+	diagnostic_index.count = count;
+	diagnostic_index.length = length;
+	diagnostic_indexed = 1;
+	return 1;
+}
+
+void _JechLines_Locate(int offset, int *line, int *column)
+{
+	if (!diagnostic_text && !diagnostic_indexed)
+	{
+		*line = 0;
+		*column = 0;
+		return;
+	}
+
+	if (!diagnostic_indexed)
+	{
+		_JechLineIndex_Free(&diagnostic_index);
+		_JechLineIndex_Build(&diagnostic_index, diagnostic_text);
+		diagnostic_indexed = 1;
+	}
+	_JechLineIndex_Locate(&diagnostic_index, offset, line, column);
+}
@@ -0,0 +1,10 @@
+#include "core/number.h"
+
+/**
+ * Value of a decoded number literal as a double. Kept apart from the
+ * lexer, since the VM reads literals back from compiled images too.
+ */
+double _JechNumber_AsDouble(const JechNumber *number)
+{
+    return number->is_float ? number->as.f : (double)number->as.i;
+}
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/optimizer.h"
+#include "core/number.h"
+
+/**
+ * A value known at compile time. Literals keep their token type; a folded
+ * result is typed TOKEN_IDENTIFIER, because OP_BIN_OP would have left it in
+ * a temporary and operators treat variables differently from literals.
+ */
+typedef struct
+{
+    char text[MAX_STRING];
+    JechTokenType type;
+    JechNumber number;
+} Constant;
+
+static int is_comparison(JechTokenType op)
+{
+    return op == TOKEN_EQEQ || op == TOKEN_LT || op == TOKEN_GT;
+}
+
+/**
+ * How OP_BIN_OP decides that a variable holds a string rather than a number
+ */
+static int looks_like_string(const char *value)
+{
+    return value[0] != '\0' &&
+           (value[0] == '"' || value[0] == '\'' ||
+            (atof(value) == 0.0 && strcmp(value, "0") != 0 && strcmp(value, "0.00") != 0));
+}
+
+static int is_string(const Constant *c)
+{
+    return c->type == TOKEN_STRING || (c->type == TOKEN_IDENTIFIER && looks_like_string(c->text));
+}
+
+static double as_double(const Constant *c)
+{
+    return c->type == TOKEN_NUMBER ? _JechNumber_AsDouble(&c->number) : atof(c->text);
+}
+
+/**
+ * Applies `op` to two constants exactly as OP_BIN_OP does. Returns 0 when
+ * the operation would fail at run time, so the error is still reported there.
+ */
+static int fold_binary(JechTokenType op, const Constant *left, const Constant *right, Constant *out)
+{
+    out->type = TOKEN_IDENTIFIER;
+    memset(&out->number, 0, sizeof(out->number));
+
+    if (is_comparison(op))
+    {
+        int as_strings = left->type == TOKEN_STRING || right->type == TOKEN_STRING ||
+                         left->type == TOKEN_BOOL || right->type == TOKEN_BOOL ||
+                         (op == TOKEN_EQEQ && left->type == TOKEN_IDENTIFIER && right->type == TOKEN_IDENTIFIER);
+        int is_true;
+        if (as_strings)
+        {
+            int cmp = strcmp(left->text, right->text);
+            is_true = op == TOKEN_EQEQ ? cmp == 0 : op == TOKEN_GT ? cmp > 0 : cmp < 0;
+        }
+        else
+        {
+            double l = as_double(left), r = as_double(right);
+            is_true = op == TOKEN_EQEQ ? l == r : op == TOKEN_GT ? l > r : l < r;
+        }
+        strcpy(out->text, is_true ? "true" : "false");
+        return 1;
+    }
+
+    if (op == TOKEN_PLUS && (is_string(left) || is_string(right)))
+    {
+        // Concatenation, cut to MAX_STRING - 1 bytes like the VM's result
+        size_t left_length = strlen(left->text);
+        size_t right_length = strnlen(right->text, MAX_STRING - 1 - left_length);
+        memcpy(out->text, left->text, left_length);
+        memcpy(out->text + left_length, right->text, right_length);
+        out->text[left_length + right_length] = '\0';
+        return 1;
+    }
+
+    double l = as_double(left), r = as_double(right);
+    double result;
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        result = l + r;
+        break;
+    case TOKEN_MINUS:
+        result = l - r;
+        break;
+    case TOKEN_STAR:
+        result = l * r;
+        break;
+    case TOKEN_SLASH:
+        if (r == 0)
+            return 0;
+        result = l / r;
+        break;
+    default:
+        return 0;
+    }
+    snprintf(out->text, sizeof(out->text), "%.2f", result);
+    return 1;
+}
+
+/**
+ * Stores a constant as the value of `node`, in the literal form that
+ * behaves like it: a folded result becomes a string or a number literal
+ * depending on how OP_BIN_OP would have read it back.
+ */
+static void store_constant(JechFlatAST *ast, JechNodeId node, const Constant *c)
+{
+    _JechFlatAST_SetValue(ast, node, c->text);
+    ast->flags[node] &= ~JECH_AST_FLOAT;
+    ast->payload[node] = 0;
+    if (c->type != TOKEN_IDENTIFIER)
+    {
+        ast->token_type[node] = c->type;
+        if (c->type == TOKEN_NUMBER)
+            _JechFlatAST_SetNumber(ast, node, c->number);
+    }
+    else if (looks_like_string(c->text))
+    {
+        ast->token_type[node] = TOKEN_STRING;
+    }
+    else
+    {
+        JechNumber number;
+        number.is_float = 1;
+        number.as.f = atof(c->text);
+        ast->token_type[node] = TOKEN_NUMBER;
+        _JechFlatAST_SetNumber(ast, node, number);
+    }
+}
+
+/**
+ * Turns an expression node into the literal leaf holding `c`
+ */
+static void make_literal(JechFlatAST *ast, JechNodeId node, const Constant *c)
+{
+    store_constant(ast, node, c);
+    ast->type[node] = ast->token_type[node] == TOKEN_STRING ? JECH_AST_STRING_LITERAL
+                      : ast->token_type[node] == TOKEN_BOOL ? JECH_AST_BOOL_LITERAL
+                                                            : JECH_AST_NUMBER_LITERAL;
+    ast->op[node] = 0;
+    ast->left[node] = JECH_NO_NODE;
+    ast->right[node] = JECH_NO_NODE;
+}
+
+/**
+ * Folds the constant parts of an expression. Returns 1 with `out` set when
+ * the whole expression is constant, leaving its replacement to the caller.
+ * Otherwise constant operands become literal leaves, except under a
+ * comparison: there a literal compares differently from a temporary.
+ */
+static int fold_expression(JechFlatAST *ast, JechNodeId node, Constant *out)
+{
+    switch (ast->type[node])
+    {
+    case JECH_AST_NUMBER_LITERAL:
+    case JECH_AST_STRING_LITERAL:
+    case JECH_AST_BOOL_LITERAL:
+        // Folding works on fixed-size values; a longer literal stays as it is
+        if (strlen(_JechFlatAST_Value(ast, node)) >= sizeof(out->text))
+            return 0;
+        strcpy(out->text, _JechFlatAST_Value(ast, node));
+        out->type = ast->token_type[node];
+        out->number = _JechFlatAST_Number(ast, node);
+        return 1;
+    case JECH_AST_BIN_OP:
+        break;
+    default:
+        return 0;
+    }
+
+    Constant left, right;
+    JechTokenType op = ast->op[node];
+    int left_constant = fold_expression(ast, ast->left[node], &left);
+    int right_constant = fold_expression(ast, ast->right[node], &right);
+    if (left_constant && right_constant && fold_binary(op, &left, &right, out))
+        return 1;
+
+    if (!is_comparison(op))
+    {
+        if (left_constant)
+            make_literal(ast, ast->left[node], &left);
+        if (right_constant)
+            make_literal(ast, ast->right[node], &right);
+    }
+    return 0;
+}
+
+static int optimize_statements(JechFlatAST *ast, JechNodeId *statements, int count);
+
+/**
+ * Optimises one statement; returns the statement to keep in its place, or
+ * JECH_NO_NODE to drop it
+ */
+static JechNodeId optimize_statement(JechFlatAST *ast, JechNodeId node)
+{
+    Constant c;
+    JechNodeId value = ast->left[node];
+    switch (ast->type[node])
+    {
+    case JECH_AST_SAY:
+    case JECH_AST_KEEP:
+    case JECH_AST_ASSIGN:
+    case JECH_AST_RETURN:
+        // say(2 + 3); compiles like say(5.00);
+        if (value != JECH_NO_NODE && ast->type[value] == JECH_AST_BIN_OP && fold_expression(ast, value, &c))
+        {
+            store_constant(ast, node, &c);
+            ast->left[node] = JECH_NO_NODE;
+        }
+        return node;
+    case JECH_AST_WHEN:
+    {
+        if (!fold_expression(ast, value, &c))
+            return node;
+
+        // OP_WHEN_BOOL runs the then branch only for the text "true"
+        JechNodeId branch = strcmp(c.text, "true") == 0 ? ast->right[node] : ast->extra[node];
+        if (branch != JECH_NO_NODE)
+            ast->offset[branch] = ast->offset[node];
+        return branch;
+    }
+    case JECH_AST_FUNCTION_DECL:
+        if (!(ast->flags[node] & JECH_AST_LAZY) && ast->payload[node] > 0)
+            ast->payload[node] = optimize_statements(ast, &ast->lists[ast->extra[node]], (int)ast->payload[node]);
+        return node;
+    default:
+        return node;
+    }
+}
+
+/**
+ * Optimises a statement list in place and returns how many statements remain
+ */
+static int optimize_statements(JechFlatAST *ast, JechNodeId *statements, int count)
+{
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        JechNodeId statement = optimize_statement(ast, statements[i]);
+        if (statement != JECH_NO_NODE)
+            statements[kept++] = statement;
+    }
+    return kept;
+}
+
+void _JechOptimizer_Run(JechFlatAST *ast)
+{
+    ast->root_count = optimize_statements(ast, ast->roots, ast->root_count);
+}
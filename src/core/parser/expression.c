@@ -0,0 +1,154 @@
+#include <stddef.h>
+#include "core/flat_ast.h"
+#include "core/parser/expression.h"
+#include "errors/error.h"
+
+/**
+ * Token cursor shared by the recursive descent
+ */
+typedef struct
+{
+    JechFlatAST *ast;
+    const JechToken *t;
+    int remaining;
+    int pos;
+} ExpressionCursor;
+
+/**
+ * How tightly an infix operator binds; 0 for tokens that are not operators
+ */
+static int binding_power(JechTokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_EQEQ:
+    case TOKEN_LT:
+    case TOKEN_GT:
+        return 10;
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+        return 20;
+    case TOKEN_STAR:
+    case TOKEN_SLASH:
+        return 30;
+    default:
+        return 0;
+    }
+}
+
+int is_expression_start(JechTokenType type)
+{
+    return type == TOKEN_IDENTIFIER || type == TOKEN_NUMBER || type == TOKEN_STRING ||
+           type == TOKEN_BOOL || type == TOKEN_LPAREN;
+}
+
+int is_expression_leaf(const JechFlatAST *ast, JechNodeId node)
+{
+    JechASTType type = ast->type[node];
+    return type == JECH_AST_IDENTIFIER || type == JECH_AST_NUMBER_LITERAL ||
+           type == JECH_AST_STRING_LITERAL || type == JECH_AST_BOOL_LITERAL;
+}
+
+static JechNodeId parse_binary(ExpressionCursor *c, int min_power);
+
+/**
+ * Parses a value or a parenthesised expression
+ */
+static JechNodeId parse_primary(ExpressionCursor *c)
+{
+    if (c->pos >= c->remaining)
+    {
+        report_syntax_error_at("Incomplete expression", c->t[c->remaining - 1].offset);
+        return JECH_NO_NODE;
+    }
+
+    const JechToken *token = &c->t[c->pos];
+    switch (token->type)
+    {
+    case TOKEN_IDENTIFIER:
+        c->pos++;
+        return _JechFlatAST_AddTokenNode(c->ast, JECH_AST_IDENTIFIER, token, token, TOKEN_IDENTIFIER);
+    case TOKEN_NUMBER:
+        c->pos++;
+        return _JechFlatAST_AddTokenNode(c->ast, JECH_AST_NUMBER_LITERAL, token, NULL, TOKEN_NUMBER);
+    case TOKEN_STRING:
+        c->pos++;
+        return _JechFlatAST_AddTokenNode(c->ast, JECH_AST_STRING_LITERAL, token, NULL, TOKEN_STRING);
+    case TOKEN_BOOL:
+        c->pos++;
+        return _JechFlatAST_AddTokenNode(c->ast, JECH_AST_BOOL_LITERAL, token, NULL, TOKEN_BOOL);
+    case TOKEN_LPAREN:
+    {
+        c->pos++;
+        JechNodeId inner = parse_binary(c, 1);
+        if (inner == JECH_NO_NODE)
+            return JECH_NO_NODE;
+
+        if (c->pos >= c->remaining || c->t[c->pos].type != TOKEN_RPAREN)
+        {
+            report_syntax_error_at("Expected ')' to close expression", c->t[c->pos < c->remaining ? c->pos : c->pos - 1].offset);
+            return JECH_NO_NODE;
+        }
+        c->pos++;
+        return inner;
+    }
+    default:
+        report_syntax_error_at("Expected a value in expression", token->offset);
+        return JECH_NO_NODE;
+    }
+}
+
+/**
+ * Parses operands joined by operators binding at least `min_power`
+ */
+static JechNodeId parse_binary(ExpressionCursor *c, int min_power)
+{
+    JechNodeId left = parse_primary(c);
+
+    while (left != JECH_NO_NODE && c->pos < c->remaining)
+    {
+        JechTokenType op = c->t[c->pos].type;
+        int power = binding_power(op);
+        if (power == 0 || power < min_power)
+            break;
+        c->pos++;
+
+        // Operands on the right must bind tighter: left-associative
+        JechNodeId right = parse_binary(c, power + 1);
+        if (right == JECH_NO_NODE)
+        {
+            return JECH_NO_NODE;
+        }
+
+        JechNodeId bin = _JechFlatAST_AddNode(c->ast, JECH_AST_BIN_OP, op);
+        c->ast->op[bin] = op;
+        c->ast->left[bin] = left;
+        c->ast->right[bin] = right;
+        left = bin;
+    }
+
+    return left;
+}
+
+JechNodeId parse_expression(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed)
+{
+    ExpressionCursor c = {ast, t, remaining_tokens, 0};
+    JechNodeId node = parse_binary(&c, 1);
+    *out_consumed = node != JECH_NO_NODE ? c.pos : 0;
+    return node;
+}
+
+JechNodeId wrap_expression(JechFlatAST *ast, JechASTType type, JechNodeId value, const JechToken *name)
+{
+    if (is_expression_leaf(ast, value))
+    {
+        // Reuse the leaf: it already holds the value, token type and number
+        ast->type[value] = type;
+        _JechFlatAST_SetName(ast, value, name);
+        return value;
+    }
+
+    JechNodeId node = _JechFlatAST_AddTokenNode(ast, type, NULL, name, TOKEN_IDENTIFIER);
+    ast->left[node] = value;
+    return node;
+}
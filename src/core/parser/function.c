@@ -1,9 +1,17 @@
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/parser/function.h"
 #include "core/parser/parser.h"
 #include "errors/error.h"
 #include <stdlib.h>
-#include <string.h>
+
+static int lazy_bodies = 0;
+
+int _JechParser_SetLazyBodies(int enabled)
+{
+    int previous = lazy_bodies;
+    lazy_bodies = enabled;
+    return previous;
+}
 
 /**
  * Parses a function declaration from the token list.
@@ -22,40 +30,39 @@
  * [n+2...] function body statements
  * [last] TOKEN_RBRACE
  */
-JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *out_consumed)
+JechNodeId parse_function_decl(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed)
 {
     if (remaining_tokens < 7)
     {
-        report_syntax_error("Incomplete function declaration", t[0].line, t[0].column);
+        report_syntax_error_at("Incomplete function declaration", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[0].type != TOKEN_DO)
     {
-        report_syntax_error("Expected 'do' keyword", t[0].line, t[0].column);
+        report_syntax_error_at("Expected 'do' keyword", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[1].type != TOKEN_IDENTIFIER)
     {
-        report_syntax_error("Expected function name after 'do'", t[1].line, t[1].column);
+        report_syntax_error_at("Expected function name after 'do'", t[1].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[2].type != TOKEN_LPAREN)
     {
-        report_syntax_error("Expected '(' after function name", t[2].line, t[2].column);
+        report_syntax_error_at("Expected '(' after function name", t[2].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     int i = 3;
-    JechASTNode *param_list = _JechAST_CreateNode(JECH_AST_PARAM_LIST, NULL, NULL, TOKEN_IDENTIFIER);
-    JechASTNode *param_head = NULL;
-    JechASTNode *param_tail = NULL;
+    JechNodeId param_head = JECH_NO_NODE;
+    JechNodeId param_tail = JECH_NO_NODE;
 
     if (t[i].type != TOKEN_RPAREN)
     {
@@ -63,22 +70,21 @@ JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *
         {
             if (t[i].type != TOKEN_IDENTIFIER)
             {
-                report_syntax_error("Expected parameter name", t[i].line, t[i].column);
-                _JechAST_Free(param_list);
+                report_syntax_error_at("Expected parameter name", t[i].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
 
-            JechASTNode *param = _JechAST_CreateNode(JECH_AST_IDENTIFIER, t[i].value, NULL, TOKEN_IDENTIFIER);
+            JechNodeId param = _JechFlatAST_AddTokenNode(ast, JECH_AST_IDENTIFIER, &t[i], NULL, TOKEN_IDENTIFIER);
             
-            if (!param_head)
+            if (param_head == JECH_NO_NODE)
             {
                 param_head = param;
                 param_tail = param;
             }
             else
             {
-                param_tail->right = param;
+                ast->right[param_tail] = param;
                 param_tail = param;
             }
 
@@ -86,10 +92,9 @@ JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *
 
             if (i >= remaining_tokens)
             {
-                report_syntax_error("Incomplete parameter list", t[0].line, t[0].column);
-                _JechAST_Free(param_list);
+                report_syntax_error_at("Incomplete parameter list", t[0].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
 
             if (t[i].type == TOKEN_COMMA)
@@ -103,29 +108,26 @@ JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *
             }
             else
             {
-                report_syntax_error("Expected ',' or ')' in parameter list", t[i].line, t[i].column);
-                _JechAST_Free(param_list);
+                report_syntax_error_at("Expected ',' or ')' in parameter list", t[i].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
         }
     }
 
     if (t[i].type != TOKEN_RPAREN)
     {
-        report_syntax_error("Expected ')' after parameters", t[i].line, t[i].column);
-        _JechAST_Free(param_list);
+        report_syntax_error_at("Expected ')' after parameters", t[i].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
     i++;
 
     if (i >= remaining_tokens || t[i].type != TOKEN_LBRACE)
     {
-        report_syntax_error("Expected '{' to start function body", t[i].line, t[i].column);
-        _JechAST_Free(param_list);
+        report_syntax_error_at("Expected '{' to start function body", t[i].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
     i++;
 
@@ -144,59 +146,36 @@ JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *
 
     if (brace_count != 0)
     {
-        report_syntax_error("Unmatched braces in function body", t[0].line, t[0].column);
-        _JechAST_Free(param_list);
+        report_syntax_error_at("Unmatched braces in function body", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     int body_end = i; // index of closing }
-
-    // Parse body tokens into AST nodes
-    int body_token_count = body_end - body_start;
-    JechASTNode **body_roots = NULL;
-    int body_count = 0;
-
-    if (body_token_count > 0)
-    {
-        // Create a temporary token list for the body
-        JechTokenList body_tokens;
-        body_tokens.count = 0;
-        for (int j = body_start; j < body_end; j++)
-        {
-            body_tokens.tokens[body_tokens.count++] = t[j];
-        }
-        // Add EOF token
-        body_tokens.tokens[body_tokens.count] = t[body_end];
-        body_tokens.tokens[body_tokens.count].type = TOKEN_EOF;
-        body_tokens.tokens[body_tokens.count].value[0] = '\0';
-        body_tokens.count++;
-
-        body_roots = _JechParser_ParseAll(&body_tokens, &body_count);
-    }
-
     i++; // skip closing }
 
-    param_list->left = param_head;
+    JechNodeId param_list = _JechFlatAST_AddNode(ast, JECH_AST_PARAM_LIST, TOKEN_IDENTIFIER);
+    ast->left[param_list] = param_head;
 
-    JechASTNode *func_decl = _JechAST_CreateNode(JECH_AST_FUNCTION_DECL, NULL, t[1].value, TOKEN_IDENTIFIER);
-    func_decl->left = param_list;
+    JechNodeId func_decl = _JechFlatAST_AddTokenNode(ast, JECH_AST_FUNCTION_DECL, NULL, &t[1], TOKEN_IDENTIFIER);
+    ast->left[func_decl] = param_list;
 
-    // Store body AST nodes
-    if (body_count > 0 && body_roots)
+    if (lazy_bodies)
     {
-        func_decl->body = malloc(sizeof(JechASTNode *) * body_count);
-        for (int j = 0; j < body_count; j++)
-        {
-            func_decl->body[j] = body_roots[j];
-        }
-        func_decl->body_count = body_count;
-		free(body_roots);
+        // Keep the body as source text between the braces; it is parsed
+        // and compiled the first time the function is called
+        const JechToken *open = &t[body_start - 1];
+        _JechFlatAST_SetLazyBody(ast, func_decl, open->start - open->offset,
+                                 open->offset + 1, t[body_end].offset - open->offset - 1);
+        *out_consumed = i;
+        return func_decl;
     }
-	else if (body_roots)
-	{
-		free(body_roots);
-	}
+
+    // Parse the body in place; its closing '}' terminates the span
+    int body_count = 0;
+    JechNodeId *body = _JechParser_ParseSpan(ast, t, body_start, body_end, &body_count);
+    _JechFlatAST_SetBody(ast, func_decl, body, body_count);
+    free(body);
 
     *out_consumed = i;
     return func_decl;
@@ -216,33 +195,32 @@ JechASTNode *parse_function_decl(const JechToken *t, int remaining_tokens, int *
  * [n] TOKEN_RPAREN
  * [n+1] TOKEN_SEMICOLON
  */
-JechASTNode *parse_function_call(const JechToken *t, int remaining_tokens, int *out_consumed)
+JechNodeId parse_function_call(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed)
 {
     if (remaining_tokens < 4)
     {
-        report_syntax_error("Incomplete function call", t[0].line, t[0].column);
+        report_syntax_error_at("Incomplete function call", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[0].type != TOKEN_IDENTIFIER)
     {
-        report_syntax_error("Expected function name", t[0].line, t[0].column);
+        report_syntax_error_at("Expected function name", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[1].type != TOKEN_LPAREN)
     {
-        report_syntax_error("Expected '(' after function name", t[1].line, t[1].column);
+        report_syntax_error_at("Expected '(' after function name", t[1].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     int i = 2;
-    JechASTNode *arg_list = _JechAST_CreateNode(JECH_AST_PARAM_LIST, NULL, NULL, TOKEN_IDENTIFIER);
-    JechASTNode *arg_head = NULL;
-    JechASTNode *arg_tail = NULL;
+    JechNodeId arg_head = JECH_NO_NODE;
+    JechNodeId arg_tail = JECH_NO_NODE;
 
     if (t[i].type != TOKEN_RPAREN)
     {
@@ -251,10 +229,9 @@ JechASTNode *parse_function_call(const JechToken *t, int remaining_tokens, int *
             if (t[i].type != TOKEN_STRING && t[i].type != TOKEN_NUMBER && 
                 t[i].type != TOKEN_IDENTIFIER && t[i].type != TOKEN_BOOL)
             {
-                report_syntax_error("Invalid argument in function call", t[i].line, t[i].column);
-                _JechAST_Free(arg_list);
+                report_syntax_error_at("Invalid argument in function call", t[i].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
 
             JechASTType arg_type = JECH_AST_IDENTIFIER;
@@ -265,16 +242,16 @@ JechASTNode *parse_function_call(const JechToken *t, int remaining_tokens, int *
             else if (t[i].type == TOKEN_BOOL)
                 arg_type = JECH_AST_BOOL_LITERAL;
 
-            JechASTNode *arg = _JechAST_CreateNode(arg_type, t[i].value, NULL, t[i].type);
+            JechNodeId arg = _JechFlatAST_AddTokenNode(ast, arg_type, &t[i], NULL, t[i].type);
             
-            if (!arg_head)
+            if (arg_head == JECH_NO_NODE)
             {
                 arg_head = arg;
                 arg_tail = arg;
             }
             else
             {
-                arg_tail->right = arg;
+                ast->right[arg_tail] = arg;
                 arg_tail = arg;
             }
 
@@ -282,10 +259,9 @@ JechASTNode *parse_function_call(const JechToken *t, int remaining_tokens, int *
 
             if (i >= remaining_tokens)
             {
-                report_syntax_error("Incomplete argument list", t[0].line, t[0].column);
-                _JechAST_Free(arg_list);
+                report_syntax_error_at("Incomplete argument list", t[0].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
 
             if (t[i].type == TOKEN_COMMA)
@@ -299,36 +275,34 @@ JechASTNode *parse_function_call(const JechToken *t, int remaining_tokens, int *
             }
             else
             {
-                report_syntax_error("Expected ',' or ')' in argument list", t[i].line, t[i].column);
-                _JechAST_Free(arg_list);
+                report_syntax_error_at("Expected ',' or ')' in argument list", t[i].offset);
                 *out_consumed = 0;
-                return NULL;
+                return JECH_NO_NODE;
             }
         }
     }
 
     if (t[i].type != TOKEN_RPAREN)
     {
-        report_syntax_error("Expected ')' after arguments", t[i].line, t[i].column);
-        _JechAST_Free(arg_list);
+        report_syntax_error_at("Expected ')' after arguments", t[i].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
     i++;
 
     if (i >= remaining_tokens || t[i].type != TOKEN_SEMICOLON)
     {
-        report_syntax_error("Expected ';' after function call", t[i].line, t[i].column);
-        _JechAST_Free(arg_list);
+        report_syntax_error_at("Expected ';' after function call", t[i].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
     i++;
 
-    arg_list->left = arg_head;
+    JechNodeId arg_list = _JechFlatAST_AddNode(ast, JECH_AST_PARAM_LIST, TOKEN_IDENTIFIER);
+    ast->left[arg_list] = arg_head;
 
-    JechASTNode *func_call = _JechAST_CreateNode(JECH_AST_FUNCTION_CALL, NULL, t[0].value, TOKEN_IDENTIFIER);
-    func_call->left = arg_list;
+    JechNodeId func_call = _JechFlatAST_AddTokenNode(ast, JECH_AST_FUNCTION_CALL, NULL, &t[0], TOKEN_IDENTIFIER);
+    ast->left[func_call] = arg_list;
 
     *out_consumed = i;
     return func_call;
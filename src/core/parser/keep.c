@@ -1,27 +1,28 @@
 #include <stddef.h>
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/parser/keep.h"
+#include "core/parser/expression.h"
 #include "core/parser/map.h"
 #include "core/parser/function.h"
 #include "errors/error.h"
 
-JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_consumed) {
+JechNodeId parse_keep(JechFlatAST * ast, const JechToken * t, int remaining_tokens, int * out_consumed) {
     if (remaining_tokens < 5) {
-        report_syntax_error("Incomplete 'keep' statement", t[0].line, t[0].column);
+        report_syntax_error_at("Incomplete 'keep' statement", t[0].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[1].type != TOKEN_IDENTIFIER) {
-        report_syntax_error("Expected variable name after 'keep'", t[1].line, t[1].column);
+        report_syntax_error_at("Expected variable name after 'keep'", t[1].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[2].type != TOKEN_EQUAL) {
-        report_syntax_error("Expected '=' after variable name", t[2].line, t[2].column);
+        report_syntax_error_at("Expected '=' after variable name", t[2].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     // Check for array.map() syntax: keep result = array.map(op value);
@@ -30,16 +31,16 @@ JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_co
         t[4].type == TOKEN_DOT &&
         t[5].type == TOKEN_MAP) {
         int map_consumed = 0;
-        JechASTNode * map_node = parse_map( & t[3], remaining_tokens - 3, & map_consumed);
+        JechNodeId map_node = parse_map(ast, & t[3], remaining_tokens - 3, & map_consumed);
 
-        if (!map_node) {
+        if (map_node == JECH_NO_NODE) {
             * out_consumed = 0;
-            return NULL;
+            return JECH_NO_NODE;
         }
 
         // Create KEEP node with map as child
-        JechASTNode * keep = _JechAST_CreateNode(JECH_AST_KEEP, NULL, t[1].value, TOKEN_IDENTIFIER);
-        keep -> left = map_node;
+        JechNodeId keep = _JechFlatAST_AddTokenNode(ast, JECH_AST_KEEP, NULL, &t[1], TOKEN_IDENTIFIER);
+        ast -> left[keep] = map_node;
 
         * out_consumed = 3 + map_consumed; // keep + varname + = + map_consumed
         return keep;
@@ -50,15 +51,15 @@ JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_co
         t[3].type == TOKEN_IDENTIFIER &&
         t[4].type == TOKEN_LPAREN) {
         int call_consumed = 0;
-        JechASTNode * call_node = parse_function_call( & t[3], remaining_tokens - 3, & call_consumed);
+        JechNodeId call_node = parse_function_call(ast, & t[3], remaining_tokens - 3, & call_consumed);
 
-        if (!call_node) {
+        if (call_node == JECH_NO_NODE) {
             * out_consumed = 0;
-            return NULL;
+            return JECH_NO_NODE;
         }
 
-        JechASTNode * keep = _JechAST_CreateNode(JECH_AST_KEEP, NULL, t[1].value, TOKEN_IDENTIFIER);
-        keep -> left = call_node;
+        JechNodeId keep = _JechFlatAST_AddTokenNode(ast, JECH_AST_KEEP, NULL, &t[1], TOKEN_IDENTIFIER);
+        ast -> left[keep] = call_node;
 
         * out_consumed = 3 + call_consumed;
         return keep;
@@ -68,23 +69,22 @@ JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_co
         int i = 4;
 
         if (i >= remaining_tokens) {
-            report_syntax_error("Incomplete array literal in 'keep' statement", t[3].line, t[3].column);
-            return NULL;
+            report_syntax_error_at("Incomplete array literal in 'keep' statement", t[3].offset);
+            return JECH_NO_NODE;
         }
 
-        JechASTNode * array = _JechAST_CreateNode(JECH_AST_ARRAY_LITERAL, NULL, NULL, TOKEN_LBRACKET);
+        JechNodeId array = _JechFlatAST_AddNode(ast, JECH_AST_ARRAY_LITERAL, TOKEN_LBRACKET);
 
-        JechASTNode * head = NULL;
-        JechASTNode * tail = NULL;
+        JechNodeId head = JECH_NO_NODE;
+        JechNodeId tail = JECH_NO_NODE;
 
         if (t[i].type != TOKEN_RBRACKET) {
             while (1) {
                 if (t[i].type != TOKEN_STRING &&
                     t[i].type != TOKEN_NUMBER &&
                     t[i].type != TOKEN_BOOL) {
-                    report_syntax_error("Invalid array element in 'keep' statement", t[i].line, t[i].column);
-                    _JechAST_Free(array);
-                    return NULL;
+                    report_syntax_error_at("Invalid array element in 'keep' statement", t[i].offset);
+                    return JECH_NO_NODE;
                 }
 
                 JechASTType elem_type = JECH_AST_UNKNOWN;
@@ -95,29 +95,27 @@ JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_co
                 else
                     elem_type = JECH_AST_BOOL_LITERAL;
 
-                JechASTNode * elem = _JechAST_CreateNode(elem_type, t[i].value, NULL, t[i].type);
+                JechNodeId elem = _JechFlatAST_AddTokenNode(ast, elem_type, &t[i], NULL, t[i].type);
 
-                if (!head) {
+                if (head == JECH_NO_NODE) {
                     head = elem;
                     tail = elem;
                 } else {
-                    tail -> right = elem;
+                    ast -> right[tail] = elem;
                     tail = elem;
                 }
 
                 i++;
                 if (i >= remaining_tokens) {
-                    report_syntax_error("Incomplete array literal in 'keep' statement", t[0].line, t[0].column);
-                    _JechAST_Free(array);
-                    return NULL;
+                    report_syntax_error_at("Incomplete array literal in 'keep' statement", t[0].offset);
+                    return JECH_NO_NODE;
                 }
 
                 if (t[i].type == TOKEN_COMMA) {
                     i++;
                     if (i >= remaining_tokens) {
-                        report_syntax_error("Incomplete array literal in 'keep' statement", t[0].line, t[0].column);
-                        _JechAST_Free(array);
-                        return NULL;
+                        report_syntax_error_at("Incomplete array literal in 'keep' statement", t[0].offset);
+                        return JECH_NO_NODE;
                     }
                     continue;
                 }
@@ -126,72 +124,52 @@ JechASTNode * parse_keep(const JechToken * t, int remaining_tokens, int * out_co
                     break;
                 }
 
-                report_syntax_error("Expected ',' or ']' in array literal", t[i].line, t[i].column);
-                _JechAST_Free(array);
-                return NULL;
+                report_syntax_error_at("Expected ',' or ']' in array literal", t[i].offset);
+                return JECH_NO_NODE;
             }
         }
 
         if (t[i].type != TOKEN_RBRACKET) {
-            report_syntax_error("Expected ']' to close array literal", t[i].line, t[i].column);
-            _JechAST_Free(array);
-            return NULL;
+            report_syntax_error_at("Expected ']' to close array literal", t[i].offset);
+            return JECH_NO_NODE;
         }
         i++;
 
         if (i >= remaining_tokens || t[i].type != TOKEN_SEMICOLON) {
-            report_syntax_error("Missing semicolon after 'keep' statement", t[i].line, t[i].column);
-            _JechAST_Free(array);
-            return NULL;
+            report_syntax_error_at("Missing semicolon after 'keep' statement", t[i].offset);
+            return JECH_NO_NODE;
         }
 
-        array -> left = head;
+        ast -> left[array] = head;
 
-        JechASTNode * keep = _JechAST_CreateNode(JECH_AST_KEEP, NULL, t[1].value, TOKEN_LBRACKET);
-        keep -> left = array;
+        JechNodeId keep = _JechFlatAST_AddTokenNode(ast, JECH_AST_KEEP, NULL, &t[1], TOKEN_LBRACKET);
+        ast -> left[keep] = array;
         * out_consumed = i + 1;
         return keep;
     }
 
-    // Check for binary operation: keep x = a + b;
-    if (remaining_tokens >= 7 &&
-        (t[3].type == TOKEN_IDENTIFIER || t[3].type == TOKEN_NUMBER || t[3].type == TOKEN_STRING) &&
-        (t[4].type == TOKEN_PLUS || t[4].type == TOKEN_MINUS || t[4].type == TOKEN_STAR || t[4].type == TOKEN_SLASH) &&
-        (t[5].type == TOKEN_IDENTIFIER || t[5].type == TOKEN_NUMBER || t[5].type == TOKEN_STRING) &&
-        t[6].type == TOKEN_SEMICOLON) {
-        JechASTNode * left = _JechAST_CreateNode(
-            t[3].type == TOKEN_IDENTIFIER ? JECH_AST_ASSIGN : JECH_AST_KEEP,
-            t[3].value, t[3].type == TOKEN_IDENTIFIER ? t[3].value : NULL, t[3].type);
-
-        JechASTNode * right = _JechAST_CreateNode(
-            t[5].type == TOKEN_IDENTIFIER ? JECH_AST_ASSIGN : JECH_AST_KEEP,
-            t[5].value, t[5].type == TOKEN_IDENTIFIER ? t[5].value : NULL, t[5].type);
-
-        JechASTNode * binop = _JechAST_CreateNode(JECH_AST_BIN_OP, NULL, NULL, t[4].type);
-        binop -> left = left;
-        binop -> right = right;
-        binop -> op = t[4].type;
-
-        JechASTNode * keep = _JechAST_CreateNode(JECH_AST_KEEP, NULL, t[1].value, TOKEN_IDENTIFIER);
-        keep -> left = binop;
-        * out_consumed = 7;
-        return keep;
+    // Any other value is an expression: keep x = 5; keep x = a * b + c;
+    if (!is_expression_start(t[3].type)) {
+        report_syntax_error_at("Invalid value type in 'keep' statement", t[3].offset);
+        * out_consumed = 0;
+        return JECH_NO_NODE;
     }
 
-    if (t[3].type != TOKEN_STRING &&
-        t[3].type != TOKEN_NUMBER &&
-        t[3].type != TOKEN_BOOL) {
-        report_syntax_error("Invalid value type in 'keep' statement", t[3].line, t[3].column);
+    int used = 0;
+    JechNodeId value = parse_expression(ast, & t[3], remaining_tokens - 3, & used);
+    if (value == JECH_NO_NODE) {
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
-    if (t[4].type != TOKEN_SEMICOLON) {
-        report_syntax_error("Missing semicolon after 'keep' statement", t[4].line, t[4].column);
+    // Expressions stop before the token ending the span, so t[i] exists
+    int i = 3 + used;
+    if (t[i].type != TOKEN_SEMICOLON) {
+        report_syntax_error_at("Missing semicolon after 'keep' statement", t[i].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
-    * out_consumed = 5;
-    return _JechAST_CreateNode(JECH_AST_KEEP, t[3].value, t[1].value, t[3].type);
-}
\ No newline at end of file
+    * out_consumed = i + 1;
+    return wrap_expression(ast, JECH_AST_KEEP, value, &t[1]);
+}
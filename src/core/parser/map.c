@@ -1,4 +1,4 @@
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/parser/map.h"
 #include "errors/error.h"
 
@@ -17,82 +17,81 @@
  * [6] TOKEN_RPAREN
  * [7] TOKEN_SEMICOLON
  */
-JechASTNode *parse_map(const JechToken *t, int remaining_tokens, int *out_consumed)
+JechNodeId parse_map(JechFlatAST *ast, const JechToken *t, int remaining_tokens, int *out_consumed)
 {
     if (remaining_tokens < 8)
     {
-        report_syntax_error("Incomplete map expression", t[0].line, t[0].column);
+        report_syntax_error_at("Incomplete map expression", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[0].type != TOKEN_IDENTIFIER)
     {
-        report_syntax_error("Expected array name before .map()", t[0].line, t[0].column);
+        report_syntax_error_at("Expected array name before .map()", t[0].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[1].type != TOKEN_DOT)
     {
-        report_syntax_error("Expected '.' after array name", t[1].line, t[1].column);
+        report_syntax_error_at("Expected '.' after array name", t[1].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[2].type != TOKEN_MAP)
     {
-        report_syntax_error("Expected 'map' after '.'", t[2].line, t[2].column);
+        report_syntax_error_at("Expected 'map' after '.'", t[2].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[3].type != TOKEN_LPAREN)
     {
-        report_syntax_error("Expected '(' after 'map'", t[3].line, t[3].column);
+        report_syntax_error_at("Expected '(' after 'map'", t[3].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[4].type != TOKEN_PLUS && t[4].type != TOKEN_MINUS && 
         t[4].type != TOKEN_STAR && t[4].type != TOKEN_SLASH)
     {
-        report_syntax_error("Expected operator (+, -, *, /) in map", t[4].line, t[4].column);
+        report_syntax_error_at("Expected operator (+, -, *, /) in map", t[4].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[5].type != TOKEN_NUMBER)
     {
-        report_syntax_error("Expected number after operator in map", t[5].line, t[5].column);
+        report_syntax_error_at("Expected number after operator in map", t[5].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[6].type != TOKEN_RPAREN)
     {
-        report_syntax_error("Expected ')' after map operation", t[6].line, t[6].column);
+        report_syntax_error_at("Expected ')' after map operation", t[6].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[7].type != TOKEN_SEMICOLON)
     {
-        report_syntax_error("Expected ';' after map expression", t[7].line, t[7].column);
+        report_syntax_error_at("Expected ';' after map expression", t[7].offset);
         *out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
-    // Create MAP node
-    // node->value = array name
-    // node->left = operator node (stores operator type and operand value)
-    JechASTNode *map_node = _JechAST_CreateNode(JECH_AST_MAP, t[0].value, NULL, TOKEN_IDENTIFIER);
-    
     // Create operator node to store the operation
-    JechASTNode *op_node = _JechAST_CreateNode(JECH_AST_NUMBER_LITERAL, t[5].value, NULL, t[4].type);
-    op_node->op = t[4].type;
-    
-    map_node->left = op_node;
+    JechNodeId op_node = _JechFlatAST_AddTokenNode(ast, JECH_AST_NUMBER_LITERAL, &t[5], NULL, t[4].type);
+    ast->op[op_node] = t[4].type;
+
+    // Create MAP node
+    // value = array name
+    // left = operator node (stores operator type and operand value)
+    JechNodeId map_node = _JechFlatAST_AddTokenNode(ast, JECH_AST_MAP, &t[0], NULL, TOKEN_IDENTIFIER);
+    ast->left[map_node] = op_node;
     
     *out_consumed = 8;
     return map_node;
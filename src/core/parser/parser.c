@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/parser/parser.h"
 #include "core/parser/keep.h"
 #include "core/parser/say.h"
@@ -9,248 +9,344 @@
 #include "core/parser/assign.h"
 #include "core/parser/map.h"
 #include "core/parser/function.h"
+#include "core/parser/expression.h"
 #include "errors/error.h"
 
-#define MAX_AST_ROOTS 128
+#define INITIAL_BODY_STATEMENTS 8
 
 /**
- * Main function: transforms list of tokens into an AST tree
+ * Extra EOF tokens kept after the statement window so that fixed-offset
+ * lookahead in the statement parsers never reads stale tokens
  */
-JechASTNode **_JechParser_ParseAll(const JechTokenList *tokens, int *out_count)
+#define WINDOW_PADDING 16
+
+/**
+ * Parses `return;` and `return expression;`
+ */
+static JechNodeId parse_return(JechFlatAST *ast, const JechToken *t, int remaining, int *out_consumed)
 {
-	JechASTNode **roots = malloc(sizeof(JechASTNode *) * MAX_AST_ROOTS);
-	if (!roots)
+	*out_consumed = 0;
+
+	if (1 < remaining && t[1].type == TOKEN_SEMICOLON)
 	{
-		report_error(ERROR_PARSER, "Out of memory", 0, 0);
-		*out_count = 0;
-		return NULL;
+		// return; (no value)
+		*out_consumed = 2;
+		return _JechFlatAST_AddNode(ast, JECH_AST_RETURN, TOKEN_UNKNOWN);
 	}
 
-	int count = 0;
-	int i = 0;
-	const JechToken *t = tokens->tokens;
-
-	while (i < tokens->count)
+	if (1 < remaining && is_expression_start(t[1].type))
 	{
-		if (count >= MAX_AST_ROOTS)
-		{
-			report_error(ERROR_PARSER, "Too many instructions", t[i].line, t[i].column);
-			break;
-		}
+		int used = 0;
+		JechNodeId value = parse_expression(ast, &t[1], remaining - 1, &used);
+		if (value == JECH_NO_NODE)
+			return JECH_NO_NODE;
 
-		// say("Hello, World!");
-		if (t[i].type == TOKEN_SAY)
+		// Expressions stop before the token ending the span, so t[1 + used] exists
+		if (t[1 + used].type == TOKEN_SEMICOLON)
 		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_say(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
-			{
-				break;
-			}
+			*out_consumed = used + 2;
+			return wrap_expression(ast, JECH_AST_RETURN, value, NULL);
 		}
+	}
 
-		// keep name = value;
-		if (t[i].type == TOKEN_KEEP)
-		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_keep(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
-			{
-				break;
-			}
-		}
+	report_error_at(ERROR_PARSER, "Invalid return statement", t[0].offset);
+	return JECH_NO_NODE;
+}
 
-		// when(condition) { say(...) } else { say(...) }
-		if (t[i].type == TOKEN_WHEN)
-		{
-			int remaining = tokens->count - i;
-			JechASTNode *node = parse_when(&t[i], remaining);
+/**
+ * Parses a single top-level statement starting at `t`.
+ * Returns JECH_NO_NODE (with *out_consumed = 0) at EOF or on error.
+ */
+static JechNodeId parse_statement(JechFlatAST *ast, const JechToken *t, int remaining, int *out_consumed)
+{
+	*out_consumed = 0;
 
-			if (node)
-			{
-				roots[count++] = node;
-
-				// Calculate offset based on condition type
-				int offset = 0;
-				if (node->left->type == JECH_AST_BIN_OP)
-				{
-					offset = 5; // when ( id op num )
-				}
-				else
-				{
-					offset = 3; // when ( bool/id )
-				}
-
-				// Base: offset + { say(...); } = offset + 8
-				i += offset + 8;
-
-				// If there's an else block, add 8 more tokens: else { say(...); }
-				if (node->else_branch != NULL)
-				{
-					i += 8;
-				}
-
-				continue;
-			}
-			else
-			{
-				break;
-			}
-		}
+	// say("Hello, World!");
+	if (t[0].type == TOKEN_SAY)
+	{
+		return parse_say(ast, t, remaining, out_consumed);
+	}
+
+	// keep name = value;
+	if (t[0].type == TOKEN_KEEP)
+	{
+		return parse_keep(ast, t, remaining, out_consumed);
+	}
+
+	// when(condition) { say(...) } else { say(...) }
+	if (t[0].type == TOKEN_WHEN)
+	{
+		return parse_when(ast, t, remaining, out_consumed);
+	}
+
+	// array.map() standalone expression
+	if (2 < remaining &&
+	    t[0].type == TOKEN_IDENTIFIER &&
+	    t[1].type == TOKEN_DOT &&
+	    t[2].type == TOKEN_MAP)
+	{
+		return parse_map(ast, t, remaining, out_consumed);
+	}
+
+	// do greet(name) { ... }
+	if (t[0].type == TOKEN_DO)
+	{
+		return parse_function_decl(ast, t, remaining, out_consumed);
+	}
+
+	// return value; or return;
+	if (t[0].type == TOKEN_RETURN)
+	{
+		return parse_return(ast, t, remaining, out_consumed);
+	}
+
+	// function call: greet("World");
+	if (1 < remaining && t[0].type == TOKEN_IDENTIFIER && t[1].type == TOKEN_LPAREN)
+	{
+		return parse_function_call(ast, t, remaining, out_consumed);
+	}
+
+	// 🔄 assignment: name = value;
+	if (1 < remaining && t[0].type == TOKEN_IDENTIFIER && t[1].type == TOKEN_EQUAL)
+	{
+		return parse_assign(ast, t, remaining, out_consumed);
+	}
 
-		// array.map() standalone expression
-		if ((i + 2) < tokens->count && 
-		    t[i].type == TOKEN_IDENTIFIER && 
-		    t[i + 1].type == TOKEN_DOT && 
-		    t[i + 2].type == TOKEN_MAP)
+	// Handle EOF token
+	if (t[0].type == TOKEN_EOF)
+	{
+		return JECH_NO_NODE;
+	}
+
+	// Handle other tokens
+	if (t[0].type == TOKEN_IDENTIFIER)
+	{
+		char msg[128];
+		snprintf(msg, sizeof(msg), "Unknown expression or statement: '%.*s'. Did you mean to call it as a function or assign a value?", t[0].length, t[0].start);
+		report_error_at(ERROR_PARSER, msg, t[0].offset);
+	}
+	else
+	{
+		report_error_at(ERROR_PARSER, "Unexpected token or invalid statement", t[0].offset);
+	}
+	return JECH_NO_NODE;
+}
+
+/**
+ * Parses one statement and records where it starts in the source
+ */
+JechNodeId _JechParser_ParseStatement(JechFlatAST *ast, const JechToken *t, int remaining, int *out_consumed)
+{
+	JechNodeId node = parse_statement(ast, t, remaining, out_consumed);
+	if (node != JECH_NO_NODE)
+		ast->offset[node] = t[0].offset;
+	return node;
+}
+
+/**
+ * Appends a statement, doubling the array when full. Returns 0 if out of memory.
+ */
+static int push_statement(JechNodeId **statements, int *count, int *capacity, JechNodeId node)
+{
+	if (*count >= *capacity)
+	{
+		int grown_capacity = *capacity ? *capacity * 2 : INITIAL_BODY_STATEMENTS;
+		JechNodeId *grown = realloc(*statements, sizeof(JechNodeId) * grown_capacity);
+		if (!grown)
 		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_map(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
-				break;
+			report_error(ERROR_PARSER, "Out of memory", 0, 0);
+			return 0;
 		}
+		*statements = grown;
+		*capacity = grown_capacity;
+	}
+	(*statements)[(*count)++] = node;
+	return 1;
+}
+
+/**
+ * Parses the statements in tokens[begin, end). The span is read in place;
+ * the token at `end` (EOF, or the '}' closing a body) is never consumed.
+ */
+JechNodeId *_JechParser_ParseSpan(JechFlatAST *ast, const JechToken *tokens, int begin, int end, int *out_count)
+{
+	JechNodeId *statements = NULL;
+	int capacity = 0;
+	int count = 0;
+	int i = begin;
 
-		// do greet(name) { ... }
-		if (t[i].type == TOKEN_DO)
+	while (i < end)
+	{
+		int consumed = 0;
+		JechNodeId node = _JechParser_ParseStatement(ast, &tokens[i], end - i, &consumed);
+		if (node == JECH_NO_NODE || !push_statement(&statements, &count, &capacity, node))
 		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_function_decl(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
-				break;
+			break;
 		}
+		i += consumed;
+	}
+
+	*out_count = count;
+	return statements;
+}
+
+/**
+ * Main function: transforms list of tokens into an AST tree
+ */
+void _JechParser_ParseAll(JechFlatAST *ast, const JechTokenList *tokens)
+{
+	int i = 0;
+	while (i < tokens->count)
+	{
+		int consumed = 0;
+		JechNodeId node = _JechParser_ParseStatement(ast, &tokens->tokens[i], tokens->count - i, &consumed);
+		if (node == JECH_NO_NODE)
+			break;
+		_JechFlatAST_AddRoot(ast, node);
+		i += consumed;
+	}
+}
+
+/**
+ * Feeds one token to the statement-boundary scanner.
+ *
+ * A statement ends at a ';' outside any brackets, or at the '}' closing a
+ * `do`/`when` block unless the next token is 'else'. That last case needs
+ * one token of lookahead, so it is reported as JECH_STMT_END_UNLESS_ELSE.
+ */
+JechStatementStep _JechParser_ScanStatement(JechStatementScan *scan, const JechToken *token)
+{
+	if (scan->count++ == 0)
+		scan->is_block = (token->type == TOKEN_DO || token->type == TOKEN_WHEN);
+
+	switch (token->type)
+	{
+	case TOKEN_LPAREN:
+	case TOKEN_LBRACKET:
+	case TOKEN_LBRACE:
+		scan->depth++;
+		break;
+	case TOKEN_RPAREN:
+	case TOKEN_RBRACKET:
+		scan->depth--;
+		break;
+	case TOKEN_RBRACE:
+		scan->depth--;
+		if (scan->depth <= 0 && scan->is_block)
+			return JECH_STMT_END_UNLESS_ELSE;
+		if (scan->depth < 0)
+			return JECH_STMT_END;
+		break;
+	case TOKEN_SEMICOLON:
+		if (scan->depth <= 0)
+			return JECH_STMT_END;
+		break;
+	default:
+		break;
+	}
+	return JECH_STMT_CONTINUE;
+}
+
+/**
+ * Terminates a statement window with an EOF token, as if it were the whole
+ * program, then pads it so fixed-offset lookahead stays inside the window
+ */
+int _JechParser_TerminateWindow(JechTokenList *window)
+{
+	JechToken eof = window->tokens[window->count - 1];
+	int count = window->count + (eof.type == TOKEN_EOF ? 0 : 1);
+	eof.type = TOKEN_EOF;
+	eof.start += eof.length;
+	eof.length = 0;
+	eof.symbol = JECH_NO_SYMBOL;
+	while (window->count < count + WINDOW_PADDING)
+	{
+		if (!_JechTokenizer_Push(window, eof))
+			return 0;
+	}
+	window->count = count;
+	return 1;
+}
+
+/**
+ * Pulls the tokens of the next top-level statement into `window`. One token
+ * of lookahead is kept in `pending` between calls.
+ */
+static int fill_statement_window(JechLexer *lexer, JechTokenList *window, JechToken *pending, int *has_pending)
+{
+	window->count = 0;
+	JechStatementScan scan = {0, 0, 0};
 
-		// return value; or return;
-		if (t[i].type == TOKEN_RETURN)
+	for (;;)
+	{
+		JechToken token;
+		if (*has_pending)
 		{
-			if ((i + 1) < tokens->count && t[i + 1].type == TOKEN_SEMICOLON)
-			{
-				// return; (no value)
-				JechASTNode *node = _JechAST_CreateNode(JECH_AST_RETURN, "", NULL, TOKEN_UNKNOWN);
-				roots[count++] = node;
-				i += 2;
-				continue;
-			}
-			else if ((i + 2) < tokens->count && t[i + 2].type == TOKEN_SEMICOLON)
-			{
-				// return value;
-				JechASTNode *node = _JechAST_CreateNode(JECH_AST_RETURN, t[i + 1].value, NULL, t[i + 1].type);
-				roots[count++] = node;
-				i += 3;
-				continue;
-			}
-			else if ((i + 4) < tokens->count &&
-				(t[i + 2].type == TOKEN_PLUS || t[i + 2].type == TOKEN_MINUS ||
-				 t[i + 2].type == TOKEN_STAR || t[i + 2].type == TOKEN_SLASH) &&
-				t[i + 4].type == TOKEN_SEMICOLON)
-			{
-				// return a + b;
-				JechASTNode *left = _JechAST_CreateNode(
-					t[i + 1].type == TOKEN_IDENTIFIER ? JECH_AST_IDENTIFIER : JECH_AST_NUMBER_LITERAL,
-					t[i + 1].value, NULL, t[i + 1].type);
-				JechASTNode *right = _JechAST_CreateNode(
-					t[i + 3].type == TOKEN_IDENTIFIER ? JECH_AST_IDENTIFIER : JECH_AST_NUMBER_LITERAL,
-					t[i + 3].value, NULL, t[i + 3].type);
-				JechASTNode *binop = _JechAST_CreateNode(JECH_AST_BIN_OP, NULL, NULL, t[i + 2].type);
-				binop->left = left;
-				binop->right = right;
-				binop->op = t[i + 2].type;
-
-				JechASTNode *node = _JechAST_CreateNode(JECH_AST_RETURN, NULL, NULL, TOKEN_UNKNOWN);
-				node->left = binop;
-				roots[count++] = node;
-				i += 5;
-				continue;
-			}
-			else
-			{
-				report_error(ERROR_PARSER, "Invalid return statement", t[i].line, t[i].column);
-				break;
-			}
+			token = *pending;
+			*has_pending = 0;
 		}
-
-		// function call: greet("World");
-		if ((i + 1) < tokens->count && t[i].type == TOKEN_IDENTIFIER && t[i + 1].type == TOKEN_LPAREN)
+		else
 		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_function_call(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
-				break;
+			token = _JechTokenizer_Next(lexer);
 		}
 
-		// 🔄 assignment: name = value;
-		if ((i + 1) < tokens->count && t[i].type == TOKEN_IDENTIFIER && t[i + 1].type == TOKEN_EQUAL)
+		if (!_JechTokenizer_Push(window, token))
+			return 0;
+
+		if (token.type == TOKEN_EOF)
+			break;
+
+		JechStatementStep step = _JechParser_ScanStatement(&scan, &token);
+		if (step == JECH_STMT_END)
+			break;
+		if (step == JECH_STMT_END_UNLESS_ELSE)
 		{
-			int remaining = tokens->count - i;
-			int consumed = 0;
-			JechASTNode *node = parse_assign(&t[i], remaining, &consumed);
-			if (node)
-			{
-				roots[count++] = node;
-				i += consumed;
-				continue;
-			}
-			else
+			*pending = _JechTokenizer_Next(lexer);
+			*has_pending = 1;
+			if (pending->type != TOKEN_ELSE)
 				break;
 		}
+	}
+
+	return _JechParser_TerminateWindow(window);
+}
+
+/**
+ * Parses a program pulled statement by statement from a streaming lexer.
+ * Only the tokens of the statement being parsed are held in memory.
+ */
+void _JechParser_ParseStream(JechFlatAST *ast, JechLexer *lexer)
+{
+	JechTokenList window = {NULL, 0, 0};
+	JechToken pending;
+	int has_pending = 0;
+
+	int ok = 1;
 
-		// Handle EOF token
-		if (t[i].type == TOKEN_EOF)
+	while (ok && fill_statement_window(lexer, &window, &pending, &has_pending))
+	{
+		const JechToken *t = window.tokens;
+		if (t[0].type == TOKEN_EOF)
 		{
 			break;
 		}
 
-		// Handle other tokens
-		else
+		// A window normally holds exactly one statement, but anything the
+		// statement parser leaves over is parsed in place
+		int i = 0;
+		while (i < window.count && t[i].type != TOKEN_EOF)
 		{
-			if (t[i].type == TOKEN_IDENTIFIER)
-			{
-				char msg[128];
-				snprintf(msg, sizeof(msg), "Unknown expression or statement: '%s'. Did you mean to call it as a function or assign a value?", t[i].value);
-				report_error(ERROR_PARSER, msg, t[i].line, t[i].column);
-			}
-			else
+			int consumed = 0;
+			JechNodeId node = _JechParser_ParseStatement(ast, &t[i], window.count - i, &consumed);
+			if (node == JECH_NO_NODE)
 			{
-				report_error(ERROR_PARSER, "Unexpected token or invalid statement", t[i].line, t[i].column);
+				ok = 0;
+				break;
 			}
-			break;
+			_JechFlatAST_AddRoot(ast, node);
+			i += consumed;
 		}
 	}
 
-	*out_count = count;
-	return roots;
-}
\ No newline at end of file
+	_JechTokenizer_Free(&window);
+}
@@ -1,26 +1,19 @@
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "core/parser/say.h"
+#include "core/parser/expression.h"
 #include "errors/error.h"
 
-JechASTNode * parse_say(const JechToken * t, int remaining_tokens, int * out_consumed) {
+JechNodeId parse_say(JechFlatAST * ast, const JechToken * t, int remaining_tokens, int * out_consumed) {
     if (remaining_tokens < 5) {
-        report_syntax_error("Incomplete 'say' statement", t[0].line, t[0].column);
+        report_syntax_error_at("Incomplete 'say' statement", t[0].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     if (t[1].type != TOKEN_LPAREN) {
-        report_syntax_error("Expected '(' after 'say'", t[1].line, t[1].column);
+        report_syntax_error_at("Expected '(' after 'say'", t[1].offset);
         * out_consumed = 0;
-        return NULL;
-    }
-
-    // Check for literal values: say("hello"), say(42), say(true)
-    if (!(t[2].type == TOKEN_STRING || t[2].type == TOKEN_NUMBER ||
-            t[2].type == TOKEN_BOOL || t[2].type == TOKEN_IDENTIFIER)) {
-        report_syntax_error("Invalid value in 'say' statement", t[2].line, t[2].column);
-        * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
     // Check for array access: say(array[0])
@@ -31,71 +24,41 @@ JechASTNode * parse_say(const JechToken * t, int remaining_tokens, int * out_con
         t[5].type == TOKEN_RBRACKET &&
         t[6].type == TOKEN_RPAREN &&
         t[7].type == TOKEN_SEMICOLON) {
-        JechASTNode * say = _JechAST_CreateNode(JECH_AST_SAY_INDEX, t[2].value, NULL, TOKEN_IDENTIFIER);
-        say -> left = _JechAST_CreateNode(JECH_AST_NUMBER_LITERAL, t[4].value, NULL, TOKEN_NUMBER);
+        JechNodeId index = _JechFlatAST_AddTokenNode(ast, JECH_AST_NUMBER_LITERAL, &t[4], NULL, TOKEN_NUMBER);
+        JechNodeId say = _JechFlatAST_AddTokenNode(ast, JECH_AST_SAY_INDEX, &t[2], NULL, TOKEN_IDENTIFIER);
+        ast -> left[say] = index;
         * out_consumed = 8;
         return say;
     }
 
-    // Check for binary operation: say(a + b)
-    if (remaining_tokens >= 7 &&
-        (t[2].type == TOKEN_STRING ||
-            t[2].type == TOKEN_NUMBER ||
-            t[2].type == TOKEN_IDENTIFIER) &&
-        (t[3].type == TOKEN_PLUS ||
-            t[3].type == TOKEN_MINUS ||
-            t[3].type == TOKEN_STAR ||
-            t[3].type == TOKEN_SLASH) &&
-        (t[4].type == TOKEN_STRING ||
-            t[4].type == TOKEN_NUMBER ||
-            t[4].type == TOKEN_IDENTIFIER))
-    {
-        // Check for multiple concatenations: say(a + b + c)
-        if (remaining_tokens >= 9 && 
-            (t[5].type == TOKEN_PLUS || t[5].type == TOKEN_MINUS || 
-             t[5].type == TOKEN_STAR || t[5].type == TOKEN_SLASH) &&
-            (t[6].type == TOKEN_STRING || t[6].type == TOKEN_NUMBER || 
-             t[6].type == TOKEN_IDENTIFIER))
-        {
-            report_syntax_error("Multiple concatenations not supported. Use temporary variables: keep temp = a + b; say(temp + c);", 
-                               t[5].line, t[5].column);
-            *out_consumed = 0;
-            return NULL;
-        }
-        
-        // Now check for the normal binary operation pattern
-        if (t[5].type == TOKEN_RPAREN &&
-            t[6].type == TOKEN_SEMICOLON) {
-
-        JechASTNode * left = _JechAST_CreateNode(t[2].type == TOKEN_IDENTIFIER ? JECH_AST_ASSIGN : JECH_AST_KEEP, t[2].value, t[2].type == TOKEN_IDENTIFIER ? t[2].value : NULL, t[2].type);
-        JechASTNode * right = _JechAST_CreateNode(t[4].type == TOKEN_IDENTIFIER ? JECH_AST_ASSIGN : JECH_AST_KEEP, t[4].value, t[4].type == TOKEN_IDENTIFIER ? t[4].value : NULL, t[4].type);
-
-        JechASTNode * binop = _JechAST_CreateNode(JECH_AST_BIN_OP, NULL, NULL, t[3].type);
-        binop -> left = left;
-        binop -> right = right;
-        binop -> op = t[3].type;
-
-        JechASTNode * say = _JechAST_CreateNode(JECH_AST_SAY, NULL, NULL, TOKEN_IDENTIFIER);
-        say -> left = binop;
-        say -> token_type = TOKEN_IDENTIFIER;
+    // Any other value is an expression: say(x), say("a" + b), say(a * b + c)
+    if (!is_expression_start(t[2].type)) {
+        report_syntax_error_at("Invalid value in 'say' statement", t[2].offset);
+        * out_consumed = 0;
+        return JECH_NO_NODE;
+    }
 
-        * out_consumed = 7;
-        return say;
-        }
+    int used = 0;
+    JechNodeId value = parse_expression(ast, & t[2], remaining_tokens - 2, & used);
+    if (value == JECH_NO_NODE) {
+        * out_consumed = 0;
+        return JECH_NO_NODE;
     }
 
-    if (t[3].type != TOKEN_RPAREN) {
-        report_syntax_error("Expected ')' after value", t[3].line, t[3].column);
+    // Expressions stop before the token ending the span, so t[i] and t[i + 1] exist
+    int i = 2 + used;
+    if (t[i].type != TOKEN_RPAREN) {
+        report_syntax_error_at("Expected ')' after value", t[i].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
-    if (t[4].type != TOKEN_SEMICOLON) {
-        report_syntax_error("Missing semicolon after 'say' statement", t[4].line, t[4].column);
+    if (t[i + 1].type != TOKEN_SEMICOLON) {
+        report_syntax_error_at("Missing semicolon after 'say' statement", t[i + 1].offset);
         * out_consumed = 0;
-        return NULL;
+        return JECH_NO_NODE;
     }
 
-    * out_consumed = 5;
-    return _JechAST_CreateNode(JECH_AST_SAY, t[2].value, NULL, t[2].type);
-}
\ No newline at end of file
+    * out_consumed = i + 2;
+    return wrap_expression(ast, JECH_AST_SAY, value, NULL);
+}
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "core/peephole.h"
+
+/**
+ * Returns 1 if `name` is a temporary of compile_expression, `__t<depth>`
+ */
+static int is_temporary(const char *name)
+{
+    if (!name || strncmp(name, "__t", 3) != 0 || name[3] == '\0')
+        return 0;
+    for (const char *c = name + 3; *c; c++)
+    {
+        if (*c < '0' || *c > '9')
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Returns 1 if a value of `type` in `slot` reads the variable `target`
+ */
+static int reads(JechTokenType type, uint32_t slot, uint32_t target)
+{
+    return type == TOKEN_IDENTIFIER && slot == target;
+}
+
+/**
+ * Fuses `next` into `inst`, an OP_BIN_OP whose result `next` consumes, or
+ * routes a temporary through the result register. Returns 1 if `next` is
+ * gone.
+ */
+static int fuse_bin_op(Instruction *inst, Instruction *next, int same_statement)
+{
+    uint32_t target = inst->slot;
+    int temporary = is_temporary(inst->name);
+
+    // A temporary is dead once consumed; a variable is still stored
+    if ((next->op == OP_SAY || next->op == OP_RETURN) && reads(next->token_type, next->operand_slot, target))
+    {
+        inst->dest = next->op == OP_SAY ? JECH_TO_SAY : JECH_TO_RETURN;
+        if (temporary)
+            inst->name = NULL;
+        return 1;
+    }
+
+    if (next->op == OP_WHEN_BOOL && next->bin_op == TOKEN_IDENTIFIER && next->slot == target &&
+        !(temporary && (reads(next->token_type, next->operand_slot, target) ||
+                        (next->has_else && reads(next->else_token_type, next->else_slot, target)))))
+    {
+        inst->dest = JECH_TO_WHEN;
+        if (temporary)
+            inst->name = NULL;
+        inst->then_operand = next->operand;
+        inst->then_token_type = next->token_type;
+        inst->has_else = next->has_else;
+        inst->else_operand = next->else_operand;
+        inst->else_token_type = next->else_token_type;
+        return 1;
+    }
+
+    if (temporary && same_statement && next->op == OP_BIN_OP &&
+        (reads(next->token_type, next->operand_slot, target) ||
+         reads(next->cmp_operand_type, next->operand_right_slot, target)))
+    {
+        inst->name = JECH_RESULT_REGISTER;
+        if (reads(next->token_type, next->operand_slot, target))
+        {
+            next->operand = JECH_RESULT_REGISTER;
+            next->operand_slot = JECH_RESULT_SLOT;
+        }
+        if (reads(next->cmp_operand_type, next->operand_right_slot, target))
+        {
+            next->operand_right = JECH_RESULT_REGISTER;
+            next->operand_right_slot = JECH_RESULT_SLOT;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Tries the rewrites on `inst` and the instruction after it. Returns 1 if
+ * `next` was folded into `inst`, 2 if `inst` is dead and `next` replaces
+ * it, 0 if both stay.
+ */
+static int rewrite(Instruction *inst, int offset, Instruction *next, int next_offset)
+{
+    // A store overwritten before anything reads it; a literal never fails
+    if (inst->op == OP_ASSIGN && next->op == OP_ASSIGN && inst->slot == next->slot &&
+        inst->token_type != TOKEN_IDENTIFIER && !reads(next->token_type, next->operand_slot, inst->slot))
+        return 2;
+
+    // say, return and when report no source offsets, so the instruction
+    // they join may belong to the previous statement
+    if (inst->op == OP_BIN_OP && inst->dest == JECH_TO_DEFAULT && inst->slot != JECH_RESULT_SLOT)
+        return fuse_bin_op(inst, next, offset == next_offset);
+
+    // keep reports errors at its statement
+    if (inst->op == OP_FUNCTION_CALL && inst->dest == JECH_TO_DEFAULT && offset == next_offset &&
+        next->op == OP_KEEP && next->token_type == TOKEN_IDENTIFIER &&
+        strcmp(next->operand, "__last_return__") == 0)
+    {
+        inst->dest = JECH_TO_KEEP;
+        inst->operand = next->name;
+        return 1;
+    }
+    return 0;
+}
+
+static void emit_at(Bytecode *out, const Instruction *inst, int offset)
+{
+    _JechBytecode_SetOffset(out, offset);
+    _JechBytecode_Emit(out, inst);
+}
+
+int _JechPeephole_Run(Bytecode *bc)
+{
+    Bytecode out;
+    memset(&out, 0, sizeof(out));
+    int removed = 0;
+
+    // Decoded strings point into `bc`, which lives until the end
+    Instruction inst, next;
+    memset(&inst, 0, sizeof(inst));
+    int pc = _JechBytecode_Decode(bc, 0, &inst);
+    int offset = _JechBytecode_OffsetAt(bc, 0);
+    while (pc < bc->length)
+    {
+        int next_offset = _JechBytecode_OffsetAt(bc, pc);
+        memset(&next, 0, sizeof(next));
+        pc = _JechBytecode_Decode(bc, pc, &next);
+
+        switch (rewrite(&inst, offset, &next, next_offset))
+        {
+        case 1:
+            removed++;
+            break;
+        case 2:
+            removed++;
+            inst = next;
+            offset = next_offset;
+            break;
+        default:
+            emit_at(&out, &inst, offset);
+            inst = next;
+            offset = next_offset;
+            break;
+        }
+    }
+    emit_at(&out, &inst, offset);
+
+    _JechBytecode_Free(bc);
+    *bc = out;
+    bc->removed = removed;
+    return removed;
+}
+
+int _JechPeephole_Removed(const Bytecode *bc)
+{
+    int removed = bc->removed;
+    for (int i = 0; i < bc->function_count; i++)
+        removed += _JechPeephole_Removed(bc->functions[i]);
+    return removed;
+}
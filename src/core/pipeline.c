@@ -8,7 +8,12 @@
 #include "core/parser/parser.h"
 #include "core/bytecode.h"
 #include "core/vm.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
+#include "core/optimizer.h"
+#include "core/cache.h"
+#include "core/image.h"
+#include "core/lines.h"
+#include "errors/error.h"
 #include "config.h"
 
 // Debug
@@ -29,59 +34,163 @@ int is_valid_extension(const char *filename)
 }
 
 /**
- * Reads the source file content into a string
- * Returns NULL if the file cannot be read
+ * Loads the source file, mapping it into memory when possible
+ * Exits if the file cannot be read
  */
-char *load_source_file(const char *filename)
+JechSourceFile load_source_file(const char *filename)
 {
-    char *source = read_file_content(filename);
-    if (!source)
+    JechSourceFile file;
+    if (!map_file_content(filename, &file))
     {
         printf("Could not read file: %s\n", filename);
         exit(1);
     }
-    return source;
+    return file;
 }
 
 /**
- * Runs the entire pipeline: lexing, parsing, bytecode compilation, and execution
- * Prints debug information if JECH_DEBUG is enabled
+ * Lexes, parses and compiles `source` into `out`. Lazy function bodies
+ * are enabled by the caller, since they point into `source` until their
+ * first call.
  */
-void run_pipeline(const char *source)
+static void compile_program(const char *source, Bytecode *out)
 {
-    JechTokenList tokens = _JechTokenizer_Lex(source);
+    if (JECH_DEBUG)
+    {
+        JechTokenList tokens = _JechTokenizer_Lex(source);
+        debug_print_tokens(&tokens);
+        _JechTokenizer_Free(&tokens);
+    }
+
+    // Large programs are lexed on the thread pool, then streamed to the
+    // parser from the merged token list
+    JechLexer lexer;
+    JechTokenList tokens;
+    _JechTokenizer_InitParallel(&lexer, source, &tokens);
 
-    int ast_count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &ast_count);
-	if (!roots)
-	{
-		return;
-	}
+    // Statements are parsed straight into the flat AST the compiler reads
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseStream(&ast, &lexer);
+    _JechTokenizer_Free(&tokens);
+    _JechOptimizer_Run(&ast);
 
     if (JECH_DEBUG)
     {
-        debug_print_tokens(&tokens);
-        debug_print_parser(roots, ast_count);
-        debug_print_ast(roots, ast_count);
+        debug_print_parser(&ast);
+        debug_print_ast(&ast);
     }
 
-    Bytecode bytecode = _JechBytecode_CompileAll(roots, ast_count);
+    *out = _JechBytecode_CompileAll(&ast);
+    _JechFlatAST_Free(&ast);
 
     if (JECH_DEBUG)
     {
-        debug_print_bytecode(&bytecode);
+        debug_print_bytecode(out);
     }
+}
 
-    _JechVM_Execute(&bytecode);
+/**
+ * Runs a compiled program and releases it
+ */
+static void execute_program(Bytecode *bytecode)
+{
+    _JechVM_Execute(bytecode);
+    _JechBytecode_Free(bytecode);
 
     if (JECH_DEBUG)
     {
         debug_print_variables();
     }
+    if (JECH_PROFILE)
+    {
+        debug_print_profile();
+    }
+}
+
+/**
+ * Runs the entire pipeline: lexing, parsing, bytecode compilation, and execution
+ * Prints debug information if JECH_DEBUG is enabled
+ */
+void run_pipeline(const char *source)
+{
+    // `source` outlives execution, so function bodies can wait for their
+    // first call to be parsed and compiled
+    int was_lazy = _JechParser_SetLazyBodies(1);
+    _JechVM_SetBodyCompiler(_JechBytecode_CompileBody);
 
-    for (int i = 0; i < ast_count; i++)
+    Bytecode bytecode;
+    compile_program(source, &bytecode);
+    execute_program(&bytecode);
+    _JechParser_SetLazyBodies(was_lazy);
+}
+
+/**
+ * Runs a program file through the bytecode cache: a cached image of the
+ * same text skips straight to execution, otherwise the program is
+ * compiled and its image saved for the next run
+ */
+void run_cached_pipeline(const char *source, size_t length)
+{
+    int was_lazy = _JechParser_SetLazyBodies(1);
+    _JechVM_SetBodyCompiler(_JechBytecode_CompileBody);
+
+    JechCacheEntry entry;
+    if (!JECH_DEBUG && _JechCache_Load(source, length, &entry))
+    {
+        // Runtime errors still locate their offsets in the program text
+        _JechLines_SetSource(source);
+        _JechVM_Execute(&entry.bytecode);
+        _JechCache_Release(&entry);
+        _JechParser_SetLazyBodies(was_lazy);
+        return;
+    }
+
+    // Diagnostics are only printed while compiling; a program that
+    // reported any must not skip them next time
+    int errors = reported_error_count();
+    Bytecode bytecode;
+    compile_program(source, &bytecode);
+    if (!JECH_DEBUG && reported_error_count() == errors)
+    {
+        _JechCache_Store(source, length, &bytecode);
+    }
+    execute_program(&bytecode);
+    _JechParser_SetLazyBodies(was_lazy);
+}
+
+/**
+ * Compiles a program file into a standalone image for build/jech-run.
+ * Every function body is compiled up front, since the image is executed
+ * without its source. Returns 0 if the program reported errors or the
+ * image could not be written.
+ */
+int compile_pipeline(const char *source, size_t length, const char *output)
+{
+    int was_lazy = _JechParser_SetLazyBodies(0);
+    int errors = reported_error_count();
+    Bytecode bytecode;
+    compile_program(source, &bytecode);
+    _JechParser_SetLazyBodies(was_lazy);
+    if (reported_error_count() != errors)
     {
-        _JechAST_Free(roots[i]);
+        _JechBytecode_Free(&bytecode);
+        return 0;
     }
-	free(roots);
-}
\ No newline at end of file
+
+    FILE *out = fopen(output, "wb");
+    if (!out)
+    {
+        printf("Could not write file: %s\n", output);
+        _JechBytecode_Free(&bytecode);
+        return 0;
+    }
+    int written = _JechImage_Write(out, &bytecode, source, length);
+    if (fclose(out) != 0 || !written)
+    {
+        printf("Could not write file: %s\n", output);
+        written = 0;
+    }
+    _JechBytecode_Free(&bytecode);
+    return written;
+}
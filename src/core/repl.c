@@ -10,7 +10,8 @@
 #include "core/parser/parser.h"
 #include "core/bytecode.h"
 #include "core/vm.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
+#include "core/optimizer.h"
 
 #define MAX_INPUT 4096
 #define JECH_VERSION "0.1.0"
@@ -159,34 +160,22 @@ void run_repl()
 			continue;
 		}
 
-		JechTokenList tokens = _JechTokenizer_Lex(buffer);
-		
-		if (tokens.count == 0 || (tokens.count == 1 && tokens.tokens[0].type == TOKEN_EOF))
-		{
-			continue;
-		}
+		JechLexer lexer;
+		_JechTokenizer_Init(&lexer, buffer);
 
-		int ast_count = 0;
-		JechASTNode **roots = _JechParser_ParseAll(&tokens, &ast_count);
-		if (!roots)
-		{
-			continue;
-		}
+		// The AST is only needed until the line is compiled
+		JechFlatAST ast;
+		_JechFlatAST_Init(&ast);
+		_JechParser_ParseStream(&ast, &lexer);
+		_JechOptimizer_Run(&ast);
+		Bytecode bytecode = _JechBytecode_CompileAll(&ast);
+		int statement_count = ast.root_count;
+		_JechFlatAST_Free(&ast);
 
-		if (ast_count > 0)
+		if (statement_count > 0)
 		{
-			Bytecode bytecode = _JechBytecode_CompileAll(roots, ast_count);
 			_JechVM_Execute(&bytecode);
-
-			for (int i = 0; i < ast_count; i++)
-			{
-				_JechAST_Free(roots[i]);
-			}
-			free(roots);
-		}
-		else
-		{
-			free(roots);
 		}
+		_JechBytecode_Free(&bytecode);
 	}
 }
@@ -0,0 +1,310 @@
+#include <stdint.h>
+#include "core/scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+#define JECH_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Whitespace as accepted by isspace() in the C locale
+ */
+static int is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* ---------------------------------------------------------------------------
+ * Scalar fallback
+ * ------------------------------------------------------------------------- */
+
+static const char *skip_spaces_scalar(const char *p)
+{
+	while (is_space(*p))
+		p++;
+	return p;
+}
+
+static const char *find_line_end_scalar(const char *p)
+{
+	while (*p && *p != '\n')
+		p++;
+	return p;
+}
+
+static const char *find_string_stop_scalar(const char *p)
+{
+	while (*p && *p != '"' && *p != '\n')
+		p++;
+	return p;
+}
+
+#ifdef JECH_SCAN_X86
+
+/*
+ * The vector scanners load aligned blocks: an aligned load never crosses a
+ * page boundary, so reading past the NUL terminator (up to the end of its
+ * block) cannot fault. Bytes before `p` in the first block are masked off.
+ */
+
+/* ---------------------------------------------------------------------------
+ * SSE2 (16 bytes per step)
+ * ------------------------------------------------------------------------- */
+
+__attribute__((target("sse2"))) static const char *skip_spaces_sse2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 15);
+	const char *block = p - misalign;
+	unsigned live = (0xFFFFu << misalign) & 0xFFFFu;
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i below_tab = _mm_set1_epi8('\t' - 1);
+	const __m128i above_cr = _mm_set1_epi8('\r' + 1);
+
+	for (;;)
+	{
+		__m128i v = _mm_load_si128((const __m128i *)block);
+		__m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+								  _mm_and_si128(_mm_cmpgt_epi8(v, below_tab), _mm_cmplt_epi8(v, above_cr)));
+		unsigned stop = ~(unsigned)_mm_movemask_epi8(ws) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 16;
+		live = 0xFFFFu;
+	}
+}
+
+__attribute__((target("sse2"))) static const char *find_line_end_sse2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 15);
+	const char *block = p - misalign;
+	unsigned live = (0xFFFFu << misalign) & 0xFFFFu;
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i zero = _mm_setzero_si128();
+
+	for (;;)
+	{
+		__m128i v = _mm_load_si128((const __m128i *)block);
+		__m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, zero));
+		unsigned stop = (unsigned)_mm_movemask_epi8(hit) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 16;
+		live = 0xFFFFu;
+	}
+}
+
+__attribute__((target("sse2"))) static const char *find_string_stop_sse2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 15);
+	const char *block = p - misalign;
+	unsigned live = (0xFFFFu << misalign) & 0xFFFFu;
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i zero = _mm_setzero_si128();
+
+	for (;;)
+	{
+		__m128i v = _mm_load_si128((const __m128i *)block);
+		__m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, newline)),
+								   _mm_cmpeq_epi8(v, zero));
+		unsigned stop = (unsigned)_mm_movemask_epi8(hit) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 16;
+		live = 0xFFFFu;
+	}
+}
+
+/* ---------------------------------------------------------------------------
+ * AVX2 (32 bytes per step)
+ * ------------------------------------------------------------------------- */
+
+__attribute__((target("avx2"))) static const char *skip_spaces_avx2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 31);
+	const char *block = p - misalign;
+	uint32_t live = 0xFFFFFFFFu << misalign;
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i below_tab = _mm256_set1_epi8('\t' - 1);
+	const __m256i above_cr = _mm256_set1_epi8('\r' + 1);
+
+	for (;;)
+	{
+		__m256i v = _mm256_load_si256((const __m256i *)block);
+		__m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+									 _mm256_and_si256(_mm256_cmpgt_epi8(v, below_tab), _mm256_cmpgt_epi8(above_cr, v)));
+		uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(ws) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 32;
+		live = 0xFFFFFFFFu;
+	}
+}
+
+__attribute__((target("avx2"))) static const char *find_line_end_avx2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 31);
+	const char *block = p - misalign;
+	uint32_t live = 0xFFFFFFFFu << misalign;
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (;;)
+	{
+		__m256i v = _mm256_load_si256((const __m256i *)block);
+		__m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, zero));
+		uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 32;
+		live = 0xFFFFFFFFu;
+	}
+}
+
+__attribute__((target("avx2"))) static const char *find_string_stop_avx2(const char *p)
+{
+	unsigned misalign = (unsigned)((uintptr_t)p & 31);
+	const char *block = p - misalign;
+	uint32_t live = 0xFFFFFFFFu << misalign;
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (;;)
+	{
+		__m256i v = _mm256_load_si256((const __m256i *)block);
+		__m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, newline)),
+									  _mm256_cmpeq_epi8(v, zero));
+		uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit) & live;
+		if (stop)
+			return block + __builtin_ctz(stop);
+		block += 32;
+		live = 0xFFFFFFFFu;
+	}
+}
+
+#endif
+
+/* ---------------------------------------------------------------------------
+ * Runtime dispatch
+ * ------------------------------------------------------------------------- */
+
+typedef const char *(*JechScanFn)(const char *p);
+
+static JechScanMode active_mode = JECH_SCAN_AUTO;
+static JechScanFn skip_spaces_impl = skip_spaces_scalar;
+static JechScanFn find_line_end_impl = find_line_end_scalar;
+static JechScanFn find_string_stop_impl = find_string_stop_scalar;
+
+/**
+ * Returns the widest scanner the running CPU supports
+ */
+static JechScanMode detect_mode()
+{
+#ifdef JECH_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return JECH_SCAN_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return JECH_SCAN_SSE2;
+#endif
+	return JECH_SCAN_SCALAR;
+}
+
+/**
+ * Installs the scanner implementation for the given mode
+ */
+JechScanMode _JechScan_SetMode(JechScanMode mode)
+{
+	JechScanMode best = detect_mode();
+	if (mode == JECH_SCAN_AUTO || mode > best)
+		mode = best;
+
+	switch (mode)
+	{
+#ifdef JECH_SCAN_X86
+	case JECH_SCAN_AVX2:
+		skip_spaces_impl = skip_spaces_avx2;
+		find_line_end_impl = find_line_end_avx2;
+		find_string_stop_impl = find_string_stop_avx2;
+		break;
+	case JECH_SCAN_SSE2:
+		skip_spaces_impl = skip_spaces_sse2;
+		find_line_end_impl = find_line_end_sse2;
+		find_string_stop_impl = find_string_stop_sse2;
+		break;
+#endif
+	default:
+		mode = JECH_SCAN_SCALAR;
+		skip_spaces_impl = skip_spaces_scalar;
+		find_line_end_impl = find_line_end_scalar;
+		find_string_stop_impl = find_string_stop_scalar;
+		break;
+	}
+
+	active_mode = mode;
+	return mode;
+}
+
+/**
+ * Installs the AUTO scanners on first use. This writes the shared
+ * implementation pointers, so it must not first happen on a pool worker.
+ */
+static void ensure_mode()
+{
+	if (active_mode == JECH_SCAN_AUTO)
+		_JechScan_SetMode(JECH_SCAN_AUTO);
+}
+
+JechScanMode _JechScan_Mode()
+{
+	ensure_mode();
+	return active_mode;
+}
+
+/**
+ * Skips whitespace; a single separating byte is handled without a call
+ * into the vector code
+ */
+const char *_JechScan_SkipSpaces(const char *p)
+{
+	if (!is_space(p[0]))
+		return p;
+	if (!is_space(p[1]))
+		return p + 1;
+	ensure_mode();
+	return skip_spaces_impl(p + 2);
+}
+
+/**
+ * Finds the end of a line comment
+ */
+const char *_JechScan_FindLineEnd(const char *p)
+{
+	ensure_mode();
+	return find_line_end_impl(p);
+}
+
+/**
+ * Finds the next byte of interest inside a string literal
+ */
+const char *_JechScan_FindStringStop(const char *p)
+{
+	ensure_mode();
+	return find_string_stop_impl(p);
+}
+
+const char *_JechScan_ModeName(JechScanMode mode)
+{
+	switch (mode)
+	{
+	case JECH_SCAN_SCALAR:
+		return "scalar";
+	case JECH_SCAN_SSE2:
+		return "sse2";
+	case JECH_SCAN_AVX2:
+		return "avx2";
+	default:
+		return "auto";
+	}
+}
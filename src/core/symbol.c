@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/symbol.h"
+
+#define JECH_SYMBOL_INITIAL_BUCKETS 256
+
+/**
+ * Interned name storage: names are kept in id order, and an open-addressing
+ * hash table maps hashes to ids
+ */
+typedef struct
+{
+    char **names;
+    uint32_t *hashes;
+    int count;
+    int capacity;
+
+    JechSymbol *buckets; // JECH_NO_SYMBOL marks an empty bucket
+    int bucket_count;
+} JechSymbolTable;
+
+static JechSymbolTable table = {NULL, NULL, 0, 0, NULL, 0};
+
+/**
+ * FNV-1a hash of a name slice
+ */
+uint32_t _JechSymbol_Hash(const char *name, int length)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void out_of_memory()
+{
+    fprintf(stderr, "Symbol table error: malloc failed\n");
+    exit(1);
+}
+
+/**
+ * Rebuilds the bucket array with twice as many buckets
+ */
+static void grow_buckets()
+{
+    int bucket_count = table.bucket_count ? table.bucket_count * 2 : JECH_SYMBOL_INITIAL_BUCKETS;
+    JechSymbol *buckets = malloc(sizeof(JechSymbol) * bucket_count);
+    if (!buckets)
+        out_of_memory();
+    memset(buckets, 0xFF, sizeof(JechSymbol) * bucket_count);
+
+    for (int id = 0; id < table.count; id++)
+    {
+        uint32_t slot = table.hashes[id] & (bucket_count - 1);
+        while (buckets[slot] != JECH_NO_SYMBOL)
+            slot = (slot + 1) & (bucket_count - 1);
+        buckets[slot] = (JechSymbol)id;
+    }
+
+    free(table.buckets);
+    table.buckets = buckets;
+    table.bucket_count = bucket_count;
+}
+
+/**
+ * Returns the id for a name, interning it on first sight
+ */
+JechSymbol _JechSymbol_Intern(const char *name, int length)
+{
+    return _JechSymbol_InternHashed(name, length, _JechSymbol_Hash(name, length));
+}
+
+/**
+ * Interns a name whose hash was computed beforehand
+ */
+JechSymbol _JechSymbol_InternHashed(const char *name, int length, uint32_t hash)
+{
+    // Keep the load factor under 1/2
+    if ((table.count + 1) * 2 > table.bucket_count)
+        grow_buckets();
+
+    uint32_t slot = hash & (table.bucket_count - 1);
+
+    while (table.buckets[slot] != JECH_NO_SYMBOL)
+    {
+        JechSymbol id = table.buckets[slot];
+        if (table.hashes[id] == hash &&
+            strncmp(table.names[id], name, length) == 0 && table.names[id][length] == '\0')
+        {
+            return id;
+        }
+        slot = (slot + 1) & (table.bucket_count - 1);
+    }
+
+    if (table.count >= table.capacity)
+    {
+        int capacity = table.capacity ? table.capacity * 2 : JECH_SYMBOL_INITIAL_BUCKETS;
+        char **names = realloc(table.names, sizeof(char *) * capacity);
+        if (!names)
+            out_of_memory();
+        table.names = names;
+        uint32_t *hashes = realloc(table.hashes, sizeof(uint32_t) * capacity);
+        if (!hashes)
+            out_of_memory();
+        table.hashes = hashes;
+        table.capacity = capacity;
+    }
+
+    char *copy = malloc(length + 1);
+    if (!copy)
+        out_of_memory();
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    JechSymbol id = (JechSymbol)table.count++;
+    table.names[id] = copy;
+    table.hashes[id] = hash;
+    table.buckets[slot] = id;
+    return id;
+}
+
+/**
+ * Returns the name of an interned symbol
+ */
+const char *_JechSymbol_Name(JechSymbol symbol)
+{
+    if (symbol >= (JechSymbol)table.count)
+        return "";
+    return table.names[symbol];
+}
+
+/**
+ * Returns the number of interned symbols
+ */
+int _JechSymbol_Count()
+{
+    return table.count;
+}
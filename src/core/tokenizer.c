@@ -1,16 +1,100 @@
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdlib.h>
 #include "core/tokenizer.h"
+#include "core/scan.h"
+#include "core/lines.h"
 #include "errors/error.h"
+#include "utils/thread_pool.h"
 
-static int push_token(JechTokenList *list, JechToken token)
+#define JECH_INITIAL_TOKENS 256
+
+/**
+ * Sources at least this large are lexed in parallel when more than one
+ * core is available; each chunk gets at least JECH_PARALLEL_LEX_CHUNK bytes
+ */
+#define JECH_PARALLEL_LEX_MIN (1024 * 1024)
+#define JECH_PARALLEL_LEX_CHUNK (256 * 1024)
+
+/**
+ * Character classes driving the lexer's dispatch. Only ASCII bytes are
+ * classified, so lexing does not depend on the current locale.
+ */
+typedef enum
 {
-	if (list->count >= JECH_MAX_TOKENS - 1)
+	CHAR_OTHER = 0,
+	CHAR_END,
+	CHAR_ALPHA,
+	CHAR_DIGIT,
+	CHAR_SINGLE,
+	CHAR_EQUAL,
+	CHAR_QUOTE
+} JechCharClass;
+
+static const unsigned char char_class[256] = {
+	['\0'] = CHAR_END,
+	['a' ... 'z'] = CHAR_ALPHA,
+	['A' ... 'Z'] = CHAR_ALPHA,
+	['0' ... '9'] = CHAR_DIGIT,
+	['+'] = CHAR_SINGLE,
+	['-'] = CHAR_SINGLE,
+	['*'] = CHAR_SINGLE,
+	['/'] = CHAR_SINGLE,
+	['>'] = CHAR_SINGLE,
+	['<'] = CHAR_SINGLE,
+	['('] = CHAR_SINGLE,
+	[')'] = CHAR_SINGLE,
+	['['] = CHAR_SINGLE,
+	[']'] = CHAR_SINGLE,
+	['{'] = CHAR_SINGLE,
+	['}'] = CHAR_SINGLE,
+	[','] = CHAR_SINGLE,
+	['.'] = CHAR_SINGLE,
+	[';'] = CHAR_SINGLE,
+	['='] = CHAR_EQUAL,
+	['"'] = CHAR_QUOTE,
+};
+
+/**
+ * Token type of every CHAR_SINGLE byte
+ */
+static const unsigned char single_char_tokens[256] = {
+	['+'] = TOKEN_PLUS,
+	['-'] = TOKEN_MINUS,
+	['*'] = TOKEN_STAR,
+	['/'] = TOKEN_SLASH,
+	['>'] = TOKEN_GT,
+	['<'] = TOKEN_LT,
+	['('] = TOKEN_LPAREN,
+	[')'] = TOKEN_RPAREN,
+	['['] = TOKEN_LBRACKET,
+	[']'] = TOKEN_RBRACKET,
+	['{'] = TOKEN_LBRACE,
+	['}'] = TOKEN_RBRACE,
+	[','] = TOKEN_COMMA,
+	['.'] = TOKEN_DOT,
+	[';'] = TOKEN_SEMICOLON,
+};
+
+#define CHAR_CLASS(c) (char_class[(unsigned char)(c)])
+#define IS_WORD_CHAR(c) (CHAR_CLASS(c) == CHAR_ALPHA || CHAR_CLASS(c) == CHAR_DIGIT)
+
+/**
+ * Appends a token to the list, doubling its capacity when full
+ */
+int _JechTokenizer_Push(JechTokenList *list, JechToken token)
+{
+	if (list->count >= list->capacity)
 	{
-		report_error(SYNTAX_ERROR, "Too many tokens", token.line, token.column);
-		return 0;
+		int capacity = list->capacity ? list->capacity * 2 : JECH_INITIAL_TOKENS;
+		JechToken *tokens = realloc(list->tokens, sizeof(JechToken) * capacity);
+		if (!tokens)
+		{
+			report_error_at(SYNTAX_ERROR, "Out of memory while lexing", token.offset);
+			return 0;
+		}
+		list->tokens = tokens;
+		list->capacity = capacity;
 	}
 
 	list->tokens[list->count++] = token;
@@ -18,312 +102,588 @@ static int push_token(JechTokenList *list, JechToken token)
 }
 
 /**
- * JECH Language Keyword Mapping
+ * Releases the memory held by a token list
  */
-typedef struct
+void _JechTokenizer_Free(JechTokenList *list)
 {
-	const char *keyword;
-	JechTokenType type;
-} KeywordMap;
-
-KeywordMap keywords[] = {
-	{"say", TOKEN_SAY},
-	{"keep", TOKEN_KEEP},
-	{"when", TOKEN_WHEN},
-	{"else", TOKEN_ELSE},
-	{"map", TOKEN_MAP},
-	{"do", TOKEN_DO},
-	{"return", TOKEN_RETURN},
-	{NULL, TOKEN_UNKNOWN}};
+	free(list->tokens);
+	list->tokens = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
 
 /**
- * Checks if a word matches a language keyword
+ * Recognises JECH keywords (and the true/false literals) by switching on
+ * the word length and first character, then comparing the remaining bytes
  */
-JechTokenType match_keyword(const char *word)
+static JechTokenType match_keyword(const char *word, int length)
 {
-	for (int i = 0; keywords[i].keyword != NULL; i++)
+	switch (length)
 	{
-		if (strcmp(word, keywords[i].keyword) == 0)
+	case 2:
+		if (word[0] == 'd' && word[1] == 'o')
+			return TOKEN_DO;
+		break;
+	case 3:
+		if (word[0] == 's' && word[1] == 'a' && word[2] == 'y')
+			return TOKEN_SAY;
+		if (word[0] == 'm' && word[1] == 'a' && word[2] == 'p')
+			return TOKEN_MAP;
+		break;
+	case 4:
+		switch (word[0])
 		{
-			return keywords[i].type;
+		case 'k':
+			if (memcmp(word + 1, "eep", 3) == 0)
+				return TOKEN_KEEP;
+			break;
+		case 'w':
+			if (memcmp(word + 1, "hen", 3) == 0)
+				return TOKEN_WHEN;
+			break;
+		case 'e':
+			if (memcmp(word + 1, "lse", 3) == 0)
+				return TOKEN_ELSE;
+			break;
+		case 't':
+			if (memcmp(word + 1, "rue", 3) == 0)
+				return TOKEN_BOOL;
+			break;
 		}
+		break;
+	case 5:
+		if (memcmp(word, "false", 5) == 0)
+			return TOKEN_BOOL;
+		break;
+	case 6:
+		if (memcmp(word, "return", 6) == 0)
+			return TOKEN_RETURN;
+		break;
 	}
 	return TOKEN_IDENTIFIER;
 }
 
 /**
- * Creates a token with defined type and value
+ * Creates a token with defined type whose value is a slice of the source
  */
-JechToken create_token(JechTokenType type, const char *value, int line, int column)
+JechToken create_token(JechTokenType type, const char *start, int length, int offset)
 {
 	JechToken token;
 	token.type = type;
-	strncpy(token.value, value, sizeof(token.value) - 1);
-	token.value[sizeof(token.value) - 1] = '\0';
-	token.line = line;
-	token.column = column;
+	token.length = length;
+	token.start = start;
+	token.offset = offset;
+	token.symbol = JECH_NO_SYMBOL;
+	token.number.is_float = 0;
+	token.number.as.i = 0;
 	return token;
 }
 
+/**
+ * Compares the token slice against a NUL-terminated string
+ */
+int _JechToken_Equals(const JechToken *token, const char *text)
+{
+	return strncmp(token->start, text, token->length) == 0 && text[token->length] == '\0';
+}
+
+/**
+ * Copies the token slice into a NUL-terminated buffer
+ */
+int _JechToken_CopyValue(const JechToken *token, char *buffer, int size)
+{
+	int n = token->length < size - 1 ? token->length : size - 1;
+	memcpy(buffer, token->start, n);
+	buffer[n] = '\0';
+	return n;
+}
+
 /**
  * Skip whitespace and comments
  */
 static void skip_whitespace_and_comments(const char **p)
 {
-	while (**p)
+	for (;;)
 	{
-		if (isspace(**p))
-		{
-			(*p)++;
-		}
-		else if (**p == '#' || (**p == '/' && *(*p + 1) == '/'))
-		{
-			while (**p && **p != '\n')
-				(*p)++;
-		}
+		*p = _JechScan_SkipSpaces(*p);
+		if (**p == '#' || (**p == '/' && *(*p + 1) == '/'))
+			*p = _JechScan_FindLineEnd(*p);
 		else
-		{
 			break;
-		}
 	}
 }
 
 /**
- * Reads words or booleans (true/false) and returns a token
+ * Reads keywords, booleans (true/false) or identifiers and returns a token.
+ * Identifiers are interned so the token carries a stable symbol id; a
+ * speculative lexer stores the name's hash instead.
  */
-static JechToken read_word(const char **p, int *line, int *col, int token_col)
+static JechToken read_word(const char **p, int offset, int speculative)
 {
-	char word[64];
-	int i = 0;
-	while (isalnum(**p) && i < 63)
+	const char *start = *p;
+	while (IS_WORD_CHAR(**p))
 	{
-		word[i++] = *(*p)++;
-		(*col)++;
+		(*p)++;
 	}
-	word[i] = '\0';
+	int length = (int)(*p - start);
 
-	if (strcmp(word, "true") == 0 || strcmp(word, "false") == 0)
+	JechToken token = create_token(match_keyword(start, length), start, length, offset);
+	if (token.type == TOKEN_IDENTIFIER)
 	{
-		return create_token(TOKEN_BOOL, word, *line, token_col);
+		token.symbol = speculative ? _JechSymbol_Hash(start, length) : _JechSymbol_Intern(start, length);
 	}
-
-	JechTokenType type = match_keyword(word);
-	return create_token(type, word, *line, token_col);
+	return token;
 }
 
 /**
- * Reads numbers (integers or floats)
+ * Reads numbers: digits, optionally followed by '.' and more digits.
+ * A '.' not followed by a digit is left for the next token, so `1.2.3`
+ * lexes as 1.2, '.', 3 rather than as a single number.
  */
-static JechToken read_number(const char **p, int *line, int *col, int start_col)
+static JechToken read_number(const char **p, int offset)
 {
-	char number[64];
-	int i = 0;
-	while ((isdigit(**p) || **p == '.') && i < 63)
+	const char *start = *p;
+	JechNumber number;
+	number.is_float = 0;
+	number.as.i = 0;
+
+	int as_double = 0;
+	while (CHAR_CLASS(**p) == CHAR_DIGIT)
+	{
+		int digit = **p - '0';
+		if (number.as.i > (INT64_MAX - digit) / 10)
+			as_double = 1;
+		else
+			number.as.i = number.as.i * 10 + digit;
+		(*p)++;
+	}
+
+	if (**p == '.' && CHAR_CLASS(*(*p + 1)) == CHAR_DIGIT)
+	{
+		(*p)++;
+		while (CHAR_CLASS(**p) == CHAR_DIGIT)
+			(*p)++;
+		as_double = 1;
+	}
+
+	int length = (int)(*p - start);
+	if (as_double)
 	{
-		number[i++] = *(*p)++;
-		(*col)++;
+		// Token slices are not NUL-terminated, so strtod gets a copy
+		char small[64];
+		char *text = length < (int)sizeof(small) ? small : malloc(length + 1);
+		if (!text)
+		{
+			report_error_at(SYNTAX_ERROR, "Out of memory while lexing", offset);
+			exit(1);
+		}
+		memcpy(text, start, length);
+		text[length] = '\0';
+		number.is_float = 1;
+		number.as.f = strtod(text, NULL);
+		if (text != small)
+			free(text);
 	}
-	number[i] = '\0';
-	return create_token(TOKEN_NUMBER, number, *line, start_col);
+
+	JechToken token = create_token(TOKEN_NUMBER, start, length, offset);
+	token.number = number;
+	return token;
 }
 
 /**
- * Reads quoted strings
+ * Reads quoted strings; the token slice excludes the quotes
  */
-static JechToken read_string(const char **p, int *line, int *col, int start_col)
+static JechToken read_string(const char **p, int offset, int speculative)
 {
+	const char *quote = *p;
 	(*p)++; // Skip opening quote
-	(*col)++;
-	char buffer[256];
-	int i = 0;
+	const char *start = *p;
 
-	while (**p && **p != '"' && i < 255)
+	// Jump straight to the closing quote or terminator
+	for (;;)
 	{
-		if (**p == '\n')
-		{
-			(*line)++;
-			*col = 1;
-		}
-		else
-		{
-			(*col)++;
-		}
-		buffer[i++] = *(*p)++;
+		*p = _JechScan_FindStringStop(*p);
+		if (**p != '\n')
+			break;
+		(*p)++;
 	}
-	buffer[i] = '\0';
 
 	if (**p == '"')
 	{
+		JechToken token = create_token(TOKEN_STRING, start, (int)(*p - start), offset);
 		(*p)++;
-		(*col)++;
-		return create_token(TOKEN_STRING, buffer, *line, start_col);
+		return token;
+	}
+	else if (speculative)
+	{
+		// Leave the error to whoever merges the speculative tokens
+		*p = quote + 1;
+		return create_token(TOKEN_UNKNOWN, quote, 1, offset);
 	}
 	else
 	{
-		report_error(SYNTAX_ERROR, "Unterminated string literal", *line, start_col);
+		report_error_at(SYNTAX_ERROR, "Unterminated string literal", offset);
 		exit(1);
 	}
 }
 
 /**
- * Parses the source code and returns the list of tokens
+ * Prepares a lexer positioned at the start of the source
  */
-JechTokenList _JechTokenizer_Lex(const char *source)
+void _JechTokenizer_Init(JechLexer *lexer, const char *source)
 {
-	JechTokenList list;
-	list.count = 0;
+	lexer->source = source;
+	lexer->p = source;
+	lexer->speculative = 0;
+	lexer->tokens = NULL;
+	lexer->next = 0;
+	_JechLines_SetSource(source);
+}
 
-	const char *p = source;
-	int line = 1;
-	int col = 1;
+static JechToken replay_token(JechLexer *lexer);
 
-	while (*p)
-	{
-		skip_whitespace_and_comments(&p);
-		int token_col = col;
+/**
+ * Produces the next token from the source
+ */
+JechToken _JechTokenizer_Next(JechLexer *lexer)
+{
+	if (lexer->tokens)
+		return replay_token(lexer);
 
-		if (isalpha(*p))
-		{
-			if (!push_token(&list, read_word(&p, &line, &col, token_col)))
-				break;
-		}
-		else if (isdigit(*p))
+	const char *p = lexer->p;
+	JechToken token;
+
+	skip_whitespace_and_comments(&p);
+	int offset = (int)(p - lexer->source);
+
+	// Comments were consumed above, so '/' here is always division
+	switch (CHAR_CLASS(*p))
+	{
+	case CHAR_ALPHA:
+		token = read_word(&p, offset, lexer->speculative);
+		break;
+	case CHAR_DIGIT:
+		token = read_number(&p, offset);
+		break;
+	case CHAR_SINGLE:
+		token = create_token((JechTokenType)single_char_tokens[(unsigned char)*p], p, 1, offset);
+		p++;
+		break;
+	case CHAR_EQUAL:
+		if (*(p + 1) == '=')
 		{
-			if (!push_token(&list, read_number(&p, &line, &col, token_col)))
-				break;
+			token = create_token(TOKEN_EQEQ, p, 2, offset);
+			p += 2;
 		}
-		else if (*p == '+')
+		else
 		{
-			if (!push_token(&list, create_token(TOKEN_PLUS, "+", line, col)))
-				break;
+			token = create_token(TOKEN_EQUAL, p, 1, offset);
 			p++;
 		}
-		else if (*p == '-')
+		break;
+	case CHAR_QUOTE:
+		token = read_string(&p, offset, lexer->speculative);
+		break;
+	case CHAR_END:
+		token = create_token(TOKEN_EOF, p, 0, offset);
+		break;
+	default:
+	{
+		token = create_token(TOKEN_UNKNOWN, p, 1, offset);
+
+		if (!lexer->speculative)
 		{
-			if (!push_token(&list, create_token(TOKEN_MINUS, "-", line, col)))
-				break;
-			p++;
+			char msg[64];
+			snprintf(msg, sizeof(msg), "Unknown character '%c'", *p);
+			report_syntax_error_at(msg, offset);
 		}
-		else if (*p == '*')
+
+		p++;
+		break;
+	}
+	}
+
+	lexer->p = p;
+	return token;
+}
+
+/**
+ * Lexes the whole source on the calling thread
+ */
+static JechTokenList lex_sequential(const char *source)
+{
+	JechTokenList list = {NULL, 0, 0};
+	JechLexer lexer;
+	_JechTokenizer_Init(&lexer, source);
+
+	JechToken token;
+	do
+	{
+		token = _JechTokenizer_Next(&lexer);
+		if (!_JechTokenizer_Push(&list, token))
+			break;
+	} while (token.type != TOKEN_EOF);
+
+	return list;
+}
+
+/**
+ * Number of pieces to lex `source` in, or 0 if it is better lexed on the
+ * calling thread
+ */
+static int parallel_chunk_count(const char *source)
+{
+	if (strnlen(source, JECH_PARALLEL_LEX_MIN) < JECH_PARALLEL_LEX_MIN)
+		return 0;
+	int threads = thread_pool_size(thread_pool_shared());
+	return threads > 1 ? threads * 4 : 0;
+}
+
+/**
+ * Parses the source code and returns the list of tokens
+ */
+JechTokenList _JechTokenizer_Lex(const char *source)
+{
+	int chunk_count = parallel_chunk_count(source);
+	if (chunk_count)
+		return _JechTokenizer_LexParallel(source, chunk_count);
+	return lex_sequential(source);
+}
+
+/**
+ * A newline-aligned slice of the source lexed speculatively on a worker, as
+ * if it started outside any string. The chunk owns every token that begins
+ * inside [begin, end); `stop` is where the lexer stood after the last one.
+ */
+typedef struct
+{
+	const char *source;
+	const char *begin;
+	const char *end;
+	JechTokenList tokens;
+	const char *stop;
+	int ok;
+} JechLexChunk;
+
+/**
+ * Lexes tokens from `lexer` until one begins at or after `end`, leaving
+ * `stop` just after the last token kept
+ */
+static int lex_until(JechLexer *lexer, const char *end, JechTokenList *tokens, const char **stop)
+{
+	for (;;)
+	{
+		const char *before = lexer->p;
+		JechToken token = _JechTokenizer_Next(lexer);
+		if (token.type == TOKEN_EOF || lexer->source + token.offset >= end)
 		{
-			if (!push_token(&list, create_token(TOKEN_STAR, "*", line, col)))
-				break;
-			p++;
+			*stop = before;
+			return 1;
 		}
-		else if (*p == '/')
+		if (!_JechTokenizer_Push(tokens, token))
+			return 0;
+	}
+}
+
+static void lex_chunk(void *arg)
+{
+	// Not _JechTokenizer_Init: workers must not touch the diagnostic source
+	JechLexChunk *chunk = arg;
+	JechLexer lexer = {chunk->source, chunk->begin, 1, NULL, 0};
+	chunk->ok = lex_until(&lexer, chunk->end, &chunk->tokens, &chunk->stop);
+}
+
+/**
+ * Appends `chunk` to the merged list given the real lexer position `at`
+ * after everything before it. If the previous chunk's last token ran past
+ * the boundary (a string spanning lines) the speculation was wrong: re-lex
+ * from `at` until a token lines up with a speculative one, then adopt the
+ * rest. Offsets are absolute, so adopted tokens need no fixing up.
+ */
+static int merge_chunk(JechTokenList *list, JechLexChunk *chunk, JechLexer *at)
+{
+	const JechToken *spec = chunk->tokens.tokens;
+	int first = 0;
+
+	if (at->p > chunk->begin)
+	{
+		for (;;)
 		{
-			if (*(p + 1) == '/')
+			const char *before = at->p;
+			JechToken token = _JechTokenizer_Next(at);
+			if (token.type == TOKEN_EOF || at->source + token.offset >= chunk->end)
 			{
-				while (*p && *p != '\n')
-				{
-					p++;
-				}
+				// Nothing lined up: the re-lexed tokens replace the chunk
+				at->p = before;
+				return 1;
 			}
-			else
+			if (!_JechTokenizer_Push(list, token))
+				return 0;
+
+			while (first < chunk->tokens.count && spec[first].offset < token.offset)
+				first++;
+
+			// Same start and length leave both lexers at the same place
+			if (first < chunk->tokens.count && spec[first].offset == token.offset &&
+				spec[first].type == token.type && spec[first].length == token.length)
 			{
-				if (!push_token(&list, create_token(TOKEN_SLASH, "/", line, col)))
-					break;
-				p++;
-			}
-		}
-		else if (*p == '=' && *(p + 1) == '=')
-		{
-			if (!push_token(&list, create_token(TOKEN_EQEQ, "==", line, col)))
-				break;
-			p += 2;
-		}
-		else if (*p == '=')
-		{
-			if (!push_token(&list, create_token(TOKEN_EQUAL, "=", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '>')
-		{
-			if (!push_token(&list, create_token(TOKEN_GT, ">", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '<')
-		{
-			if (!push_token(&list, create_token(TOKEN_LT, "<", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '(')
-		{
-			if (!push_token(&list, create_token(TOKEN_LPAREN, "(", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == ')')
-		{
-			if (!push_token(&list, create_token(TOKEN_RPAREN, ")", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '[')
-		{
-			if (!push_token(&list, create_token(TOKEN_LBRACKET, "[", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == ']')
-		{
-			if (!push_token(&list, create_token(TOKEN_RBRACKET, "]", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == ',')
-		{
-			if (!push_token(&list, create_token(TOKEN_COMMA, ",", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '.')
-		{
-			if (!push_token(&list, create_token(TOKEN_DOT, ".", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == ';')
-		{
-			if (!push_token(&list, create_token(TOKEN_SEMICOLON, ";", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '"')
-		{
-			if (!push_token(&list, read_string(&p, &line, &col, token_col)))
+				first++;
 				break;
+			}
 		}
-		else if (*p == '{')
-		{
-			if (!push_token(&list, create_token(TOKEN_LBRACE, "{", line, col)))
-				break;
-			p++;
-		}
-		else if (*p == '}')
+	}
+
+	for (int i = first; i < chunk->tokens.count; i++)
+	{
+		if (!_JechTokenizer_Push(list, spec[i]))
+			return 0;
+	}
+	at->p = chunk->stop;
+	return 1;
+}
+
+/**
+ * Interns a merged token's identifier or reports its error, exactly as the
+ * sequential lexer would have while producing it
+ */
+static void finish_token(JechToken *token)
+{
+	if (token->type == TOKEN_IDENTIFIER)
+	{
+		token->symbol = _JechSymbol_InternHashed(token->start, token->length, token->symbol);
+	}
+	else if (token->type == TOKEN_UNKNOWN)
+	{
+		if (*token->start == '"')
 		{
-			if (!push_token(&list, create_token(TOKEN_RBRACE, "}", line, col)))
-				break;
-			p++;
+			report_error_at(SYNTAX_ERROR, "Unterminated string literal", token->offset);
+			exit(1);
 		}
 
-		else if (*p != '\0')
-		{
-			char unknown[2] = {*p, '\0'};
-			if (!push_token(&list, create_token(TOKEN_UNKNOWN, unknown, line, col)))
-				break;
+		char msg[64];
+		snprintf(msg, sizeof(msg), "Unknown character '%c'", *token->start);
+		report_syntax_error_at(msg, token->offset);
+	}
+}
 
-			char msg[64];
-			snprintf(msg, sizeof(msg), "Unknown character '%c'", *p);
-			report_syntax_error(msg, line, col);
+/**
+ * Hands out the next token lexed up front, finishing it only now so
+ * diagnostics interleave with the parser's as they would when streaming
+ */
+static JechToken replay_token(JechLexer *lexer)
+{
+	JechToken token = lexer->tokens[lexer->next];
+	if (token.type != TOKEN_EOF)
+		lexer->next++;
+	finish_token(&token);
+	return token;
+}
 
-			p++;
-		}
+/**
+ * Splits the source at newlines, lexes the pieces on the shared pool and
+ * stitches them back together in order into `out`, ending with TOKEN_EOF.
+ * The tokens are not finished yet. Returns 0, with `out` empty, if memory
+ * ran out.
+ */
+static int lex_parallel(const char *source, int chunk_count, JechTokenList *out)
+{
+	*out = (JechTokenList){NULL, 0, 0};
+	size_t length = strlen(source);
+	const char *end = source + length;
+
+	size_t chunk_size = length / (chunk_count > 0 ? chunk_count : 1) + 1;
+	if (chunk_size < JECH_PARALLEL_LEX_CHUNK && length >= JECH_PARALLEL_LEX_MIN)
+		chunk_size = JECH_PARALLEL_LEX_CHUNK;
+
+	JechLexChunk *chunks = malloc(sizeof(JechLexChunk) * (length / chunk_size + 1));
+	if (!chunks)
+		return 0;
+
+	// Every chunk but the first starts right after a newline, which is
+	// never inside a comment and usually not inside a string
+	int count = 0;
+	const char *begin = source;
+	while (begin < end || count == 0)
+	{
+		const char *split = begin + chunk_size < end ? begin + chunk_size : end;
+		const char *newline = split < end ? memchr(split, '\n', end - split) : NULL;
+		split = newline ? newline + 1 : end;
+
+		JechLexChunk *chunk = &chunks[count++];
+		chunk->source = source;
+		chunk->begin = begin;
+		chunk->end = split;
+		chunk->tokens = (JechTokenList){NULL, 0, 0};
+		chunk->ok = 0;
+		begin = split;
+	}
+
+	// Workers only read the scanner selection
+	_JechScan_Mode();
+	ThreadPool *pool = thread_pool_shared();
+	for (int i = 0; i < count; i++)
+		thread_pool_submit(pool, lex_chunk, &chunks[i]);
+	thread_pool_wait(pool);
+
+	int total = 1;
+	int ok = 1;
+	for (int i = 0; i < count; i++)
+	{
+		ok = ok && chunks[i].ok;
+		total += chunks[i].tokens.count;
+	}
+
+	JechTokenList list = {NULL, 0, 0};
+	list.tokens = ok ? malloc(sizeof(JechToken) * total) : NULL;
+	list.capacity = list.tokens ? total : 0;
+	ok = ok && list.tokens;
+
+	JechLexer at;
+	_JechTokenizer_Init(&at, source);
+	at.speculative = 1;
+	for (int i = 0; ok && i < count; i++)
+		ok = merge_chunk(&list, &chunks[i], &at);
+
+	for (int i = 0; i < count; i++)
+		_JechTokenizer_Free(&chunks[i].tokens);
+	free(chunks);
+
+	// `total` left room for the EOF token
+	if (ok)
+		ok = _JechTokenizer_Push(&list, create_token(TOKEN_EOF, end, 0, (int)length));
+	if (!ok)
+	{
+		_JechTokenizer_Free(&list);
+		return 0;
 	}
+	*out = list;
+	return 1;
+}
 
-	push_token(&list, create_token(TOKEN_EOF, "", line, col));
+/**
+ * Lexes the source on the shared pool and finishes every token up front
+ */
+JechTokenList _JechTokenizer_LexParallel(const char *source, int chunk_count)
+{
+	JechTokenList list;
+	if (!lex_parallel(source, chunk_count, &list))
+		return lex_sequential(source);
+	for (int i = 0; i < list.count; i++)
+		finish_token(&list.tokens[i]);
 	return list;
 }
+
+/**
+ * Starts a lexer over `source`, lexing it on the pool first when it is
+ * large enough
+ */
+void _JechTokenizer_InitParallel(JechLexer *lexer, const char *source, JechTokenList *tokens)
+{
+	*tokens = (JechTokenList){NULL, 0, 0};
+	int chunk_count = parallel_chunk_count(source);
+	int lexed = chunk_count && lex_parallel(source, chunk_count, tokens);
+
+	_JechTokenizer_Init(lexer, source);
+	if (lexed)
+		lexer->tokens = tokens->tokens;
+}
@@ -3,20 +3,20 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "core/vm.h"
+#include "core/number.h"
 #include "errors/error.h"
+#include "config.h"
 
-#define MAX_VARS 64
 #define MAX_ARRAYS 32
 #define MAX_ARRAY_SIZE 128
-#define MAX_FUNCTIONS 32
-#define MAX_PARAMS 8
 
 /**
- * Variable table for `keep` instruction
+ * A VM variable. Variables are indexed by the symbol of their name, which
+ * _JechBytecode_Link resolves once per chunk, so no access compares names.
  */
 typedef struct {
-    char name[MAX_STRING];
     char value[MAX_STRING];
+    bool defined;
 }
 JechVariable;
 
@@ -25,15 +25,21 @@ JechVariable;
  */
 typedef struct {
     char name[MAX_STRING];
-    char params[MAX_PARAMS][MAX_STRING];
+    JechSymbol params[JECH_MAX_OPERANDS];
     int param_count;
     Bytecode *body_bc;
+    const char *body_source; // lazy body, compiled into body_bc on first call
+    int body_offset;
+    int body_length;
 }
 JechFunction;
 
 static char last_return_value[MAX_STRING] = "";
 static bool has_returned = false;
 
+// Value passed from one instruction to the next (JECH_RESULT_REGISTER)
+static char result_register[MAX_STRING] = "";
+
 /**
  * Array structure
  */
@@ -44,67 +50,116 @@ typedef struct {
 }
 JechArray;
 
-static JechVariable variables[MAX_VARS];
+static JechVariable * variables = NULL;
+static int variable_capacity = 0;
+
+// Defined variables in order of definition; a call drops the ones it added
+static JechSymbol * defined = NULL;
 static int var_count = 0;
+static int defined_capacity = 0;
 
 static JechArray arrays[MAX_ARRAYS];
 static int array_count = 0;
 
-static JechFunction functions[MAX_FUNCTIONS];
+static JechFunction * functions = NULL;
 static int function_count = 0;
+static int function_capacity = 0;
+
+static JechBodyCompiler body_compiler = NULL;
+
+static void out_of_memory() {
+    fprintf(stderr, "Runtime Error: Out of memory\n");
+    exit(1);
+}
 
 /**
- * Sets or updates a variable in the runtime environment
+ * Returns the value of a variable, or NULL if it is not defined
  */
-void _JechVM_SetVariable(const char * name,
+static const char * load(JechSymbol symbol) {
+    if ((int) symbol >= variable_capacity || !variables[symbol].defined) {
+        return NULL;
+    }
+    return variables[symbol].value;
+}
+
+/**
+ * Sets a variable, defining it if needed
+ */
+static void store(JechSymbol symbol,
     const char * value) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            strncpy(variables[i].value, value, MAX_STRING);
-            return;
+    char copy[MAX_STRING];
+    if ((int) symbol >= variable_capacity) {
+        // `value` may point into the table that is about to move
+        strncpy(copy, value, MAX_STRING);
+        value = copy;
+
+        int capacity = variable_capacity ? variable_capacity : 64;
+        while (capacity <= (int) symbol) {
+            capacity *= 2;
+        }
+        JechVariable * grown = realloc(variables, sizeof(JechVariable) * capacity);
+        if (!grown) {
+            out_of_memory();
+        }
+        memset(grown + variable_capacity, 0, sizeof(JechVariable) * (capacity - variable_capacity));
+        variables = grown;
+        variable_capacity = capacity;
+    }
+
+    JechVariable * var = & variables[symbol];
+    if (!var -> defined) {
+        if (var_count >= defined_capacity) {
+            int capacity = defined_capacity ? defined_capacity * 2 : 64;
+            JechSymbol * grown = realloc(defined, sizeof(JechSymbol) * capacity);
+            if (!grown) {
+                out_of_memory();
+            }
+            defined = grown;
+            defined_capacity = capacity;
         }
+        defined[var_count++] = symbol;
+        var -> defined = true;
     }
-    if (var_count < MAX_VARS) {
-        strncpy(variables[var_count].name, name, MAX_STRING);
-        strncpy(variables[var_count].value, value, MAX_STRING);
-        var_count++;
+    if (var -> value != value) {
+        strncpy(var -> value, value, MAX_STRING);
     }
 }
 
 /**
- * Retrieves the value of a variable by name
+ * Undefines the variables defined after the first `count`
  */
-const char * _JechVM_GetVariable(const char * name) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            return variables[i].value;
-        }
+static void drop_variables(int count) {
+    while (var_count > count) {
+        variables[defined[--var_count]].defined = false;
     }
-    return NULL;
+}
+
+static JechSymbol symbol_of(const char * name) {
+    return _JechSymbol_Intern(name, (int) strlen(name));
 }
 
 /**
- * Debug function to print all variables in the VM
+ * Sets or updates a variable in the runtime environment
  */
-void _debug_vm_dump_vars() {
-    extern JechVariable variables[];
-    extern int var_count;
+void _JechVM_SetVariable(const char * name,
+    const char * value) {
+    store(symbol_of(name), value);
+}
 
-    for (int i = 0; i < var_count; i++) {
-        printf("Variable: %s = %s\n", variables[i].name, variables[i].value);
-    }
+/**
+ * Retrieves the value of a variable by name
+ */
+const char * _JechVM_GetVariable(const char * name) {
+    return load(symbol_of(name));
 }
 
 /**
- * Checks if a variable exists in the runtime environment
+ * Debug function to print all variables in the VM
  */
-bool variable_exists(const char * name) {
+void _debug_vm_dump_vars() {
     for (int i = 0; i < var_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            return true;
-        }
+        printf("Variable: %s = %s\n", _JechSymbol_Name(defined[i]), variables[defined[i]].value);
     }
-    return false;
 }
 
 /**
@@ -189,12 +244,29 @@ static void print_array(const char * name) {
 /**
  * Clears all variables, arrays, and functions from the VM runtime environment
  */
+/**
+ * Evaluates `left op right` for ==, < and >. Operands compare as strings
+ * when `as_strings` is set, otherwise as the given numbers.
+ */
+static bool compare_values(const char * left_val,
+    const char * right_val, double left, double right, JechTokenType op, bool as_strings) {
+    if (as_strings) {
+        int cmp = strcmp(left_val, right_val);
+        return op == TOKEN_EQEQ ? cmp == 0 : op == TOKEN_GT ? cmp > 0 : cmp < 0;
+    }
+    return op == TOKEN_EQEQ ? left == right : op == TOKEN_GT ? left > right : left < right;
+}
+
 void _JechVM_ClearState() {
-    var_count = 0;
+    drop_variables(0);
     array_count = 0;
     function_count = 0;
 }
 
+void _JechVM_SetBodyCompiler(JechBodyCompiler compiler) {
+    body_compiler = compiler;
+}
+
 /**
  * Returns the last return value from a function call
  */
@@ -202,46 +274,183 @@ const char * _JechVM_GetLastReturn() {
     return last_return_value;
 }
 
+// Filled in by JECH_PROFILE builds
+static JechVMProfile profile;
+
+JechVMProfile * _JechVM_Profile() {
+    return & profile;
+}
+
+/**
+ * Symbol of the variable a call's result is kept from
+ */
+static JechSymbol last_return_symbol() {
+    static JechSymbol symbol = JECH_NO_SYMBOL;
+    if (symbol == JECH_NO_SYMBOL) {
+        symbol = symbol_of("__last_return__");
+    }
+    return symbol;
+}
+
+// The VM variable bound to a slot of the running chunk
+#define VAR(slot) (bc -> links[(slot)])
+
+/**
+ * Value of an operand slot, or NULL if undefined. Every operand may be
+ * the result register: the peephole pass routes temporaries through it
+ * and a loaded image is only verified to stay in bounds.
+ */
+static const char * read_slot(const Bytecode * bc, uint32_t slot) {
+    return slot == JECH_RESULT_SLOT ? result_register : load(VAR(slot));
+}
+
+/**
+ * Value of an identifier operand; exits reporting its name if undefined
+ */
+static const char * require_slot(const Bytecode * bc, uint32_t slot) {
+    const char * value = read_slot(bc, slot);
+    if (!value) {
+        fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", _JechBytecode_SlotName(bc, slot));
+        exit(1);
+    }
+    return value;
+}
+
+/**
+ * Says a branch value of a `when`
+ */
+static void say_value(const Bytecode * bc, JechTokenType type, uint32_t slot,
+    const JechConstant * constant) {
+    if (type == TOKEN_IDENTIFIER) {
+        const char * value = read_slot(bc, slot);
+        if (value)
+            printf("%s\n", value);
+        else
+            fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", _JechBytecode_SlotName(bc, slot));
+    } else {
+        printf("%s\n", _JechBytecode_Text(bc, constant));
+    }
+}
+
 /**
- * Executes the bytecode generated by the compiler
+ * Reads the then and else values that end a `when` and says the one
+ * `is_true` selects
+ */
+static void say_branch(const Bytecode * bc, int * pc, bool is_true) {
+    uint32_t then_slot = 0, else_slot = 0;
+    const JechConstant * then_constant = NULL, * else_constant = NULL;
+    JechTokenType then_type = _JechBytecode_ReadValue(bc, pc, & then_slot, & then_constant);
+    bool has_else = _JechBytecode_ReadVarint(bc, pc) != 0;
+    if (is_true) {
+        say_value(bc, then_type, then_slot, then_constant);
+    }
+    if (has_else) {
+        JechTokenType else_type = _JechBytecode_ReadValue(bc, pc, & else_slot, & else_constant);
+        if (!is_true) {
+            say_value(bc, else_type, else_slot, else_constant);
+        }
+    }
+}
+
+/**
+ * Delivers the result of an OP_BIN_OP to its destination, reading the
+ * branch values that follow a JECH_TO_WHEN
+ */
+static void deliver(const Bytecode * bc, int * pc, JechDestination dest, bool stored, uint32_t target,
+    const char * value) {
+    if (stored) {
+        if (target == JECH_RESULT_SLOT) {
+            strncpy(result_register, value, MAX_STRING);
+        } else {
+            store(VAR(target), value);
+        }
+    }
+
+    switch (dest) {
+    case JECH_TO_SAY:
+        printf("%s\n", value);
+        break;
+    case JECH_TO_RETURN:
+        strncpy(last_return_value, value, MAX_STRING);
+        has_returned = true;
+        break;
+    case JECH_TO_WHEN:
+        say_branch(bc, pc, strcmp(value, "true") == 0);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Whether a variable's value reads as a string in a concatenation
+ */
+static bool looks_like_string(const char * value) {
+    return strlen(value) > 0 &&
+        (value[0] == '"' || value[0] == '\'' ||
+            (atof(value) == 0.0 && strcmp(value, "0") != 0 && strcmp(value, "0.00") != 0));
+}
+
+/**
+ * Executes the bytecode generated by the compiler. Each case reads the
+ * operands of its own instruction, so names are only looked up to report
+ * an error.
  */
 void _JechVM_Execute(const Bytecode * bc) {
-    for (int i = 0; i < bc -> count; i++) {
+    int pc = 0;
+#if JECH_PROFILE
+    int previous = -1;
+#endif
+    while (pc < bc -> length) {
         if (has_returned) return;
-        Instruction inst = bc -> instructions[i];
-
-        switch (inst.op) {
+        int at = pc;
+        OpCode op = (OpCode) bc -> code[pc++];
+#if JECH_PROFILE
+        profile.dispatches++;
+        if (previous >= 0 && op < JECH_OPCODE_COUNT) profile.pairs[previous][op]++;
+        previous = op < JECH_OPCODE_COUNT ? (int) op : -1;
+#endif
+
+        switch (op) {
         case OP_ARRAY_NEW:
-            create_array(inst.name);
+            create_array(_JechBytecode_ReadString(bc, & pc));
             break;
-        case OP_ARRAY_PUSH:
-            array_push(inst.name, inst.operand);
+        case OP_ARRAY_PUSH: {
+            const char * name = _JechBytecode_ReadString(bc, & pc);
+            const char * value = _JechBytecode_ReadString(bc, & pc);
+            array_push(name, value);
             break;
+        }
         case OP_MAP: {
+            const char * name = _JechBytecode_ReadString(bc, & pc);
+            const char * source = _JechBytecode_ReadString(bc, & pc);
+            JechTokenType map_op = (JechTokenType) _JechBytecode_ReadVarint(bc, & pc);
+            const JechConstant * operation = _JechBytecode_ReadConstant(bc, & pc);
+
             // Get source array
-            JechArray * src = find_array(inst.operand);
+            JechArray * src = find_array(source);
             if (!src) {
-                fprintf(stderr, "Runtime Error: Array '%s' not found for map operation\n", inst.operand);
+                fprintf(stderr, "Runtime Error: Array '%s' not found for map operation\n", source);
                 exit(1);
             }
 
             // Check if in-place operation (source == destination)
-            bool in_place = (strcmp(inst.name, inst.operand) == 0);
+            bool in_place = (strcmp(name, source) == 0);
 
             // Create result array only if not in-place
             if (!in_place) {
-                create_array(inst.name);
+                create_array(name);
             }
 
-            // Get operation value
-            double op_value = atof(inst.operand_right);
+            // Operation value (always a number literal, decoded by the lexer)
+            double op_value = _JechNumber_AsDouble(&operation -> number);
 
             // Apply operation to each element
             for (int i = 0; i < src -> size; i++) {
                 double elem_value = atof(src -> elements[i]);
                 double new_value = 0;
 
-                switch (inst.bin_op) {
+                switch (map_op) {
                 case TOKEN_PLUS:
                     new_value = elem_value + op_value;
                     break;
@@ -271,115 +480,131 @@ void _JechVM_Execute(const Bytecode * bc) {
                     strncpy(src -> elements[i], result_str, MAX_STRING);
                 } else {
                     // Push to new array
-                    array_push(inst.name, result_str);
+                    array_push(name, result_str);
                 }
             }
             break;
         }
         case OP_SAY_INDEX: {
-            int index = atoi(inst.operand);
-            const char * value = array_get(inst.name, index);
+            const char * name = _JechBytecode_ReadString(bc, & pc);
+            int index = atoi(_JechBytecode_ReadString(bc, & pc));
+            const char * value = array_get(name, index);
             printf("%s\n", value);
             break;
         }
-        case OP_SAY:
-            if (inst.token_type == TOKEN_IDENTIFIER) {
-                const char * value = _JechVM_GetVariable(inst.operand);
+        case OP_SAY: {
+            uint32_t slot = 0;
+            const JechConstant * constant = NULL;
+            if (_JechBytecode_ReadValue(bc, & pc, & slot, & constant) == TOKEN_IDENTIFIER) {
+                const char * value = read_slot(bc, slot);
                 if (value) {
                     printf("%s\n", value);
                 } else {
-                    JechArray * arr = find_array(inst.operand);
+                    // Arrays are not variables; they are found by name
+                    const char * name = _JechBytecode_SlotName(bc, slot);
+                    JechArray * arr = find_array(name);
                     if (arr) {
-                        print_array(inst.operand);
+                        print_array(name);
                     } else {
-                        fprintf(stderr, "Runtime error: undefined variable '%s'\n", inst.operand);
+                        fprintf(stderr, "Runtime error: undefined variable '%s'\n", name);
                     }
                 }
             } else {
-                printf("%s\n", inst.operand);
+                printf("%s\n", _JechBytecode_Text(bc, constant));
             }
             break;
+        }
         case OP_KEEP: {
-            if (_JechVM_GetVariable(inst.name) != NULL) {
-                report_runtime_error("Variable already declared", inst.line, inst.column);
+            uint32_t target = _JechBytecode_ReadSlot(bc, & pc);
+            uint32_t slot = 0;
+            const JechConstant * constant = NULL;
+            JechTokenType type = _JechBytecode_ReadValue(bc, & pc, & slot, & constant);
+            if (load(VAR(target)) != NULL) {
+                report_runtime_error_at("Variable already declared", _JechBytecode_OffsetAt(bc, at));
                 exit(1);
             }
-            const char * keep_val = inst.operand;
-            if (inst.token_type == TOKEN_IDENTIFIER && strcmp(inst.operand, "__last_return__") == 0) {
+            const char * keep_val;
+            if (type == TOKEN_IDENTIFIER && slot != JECH_RESULT_SLOT && VAR(slot) == last_return_symbol()) {
                 keep_val = last_return_value;
-            } else if (inst.token_type == TOKEN_IDENTIFIER) {
-                const char * resolved = _JechVM_GetVariable(inst.operand);
-                if (resolved) {
-                    keep_val = resolved;
+            } else if (type == TOKEN_IDENTIFIER) {
+                // An undefined name is kept as its own text
+                keep_val = read_slot(bc, slot);
+                if (!keep_val) {
+                    keep_val = _JechBytecode_SlotName(bc, slot);
                 }
+            } else {
+                keep_val = _JechBytecode_Text(bc, constant);
             }
-            _JechVM_SetVariable(inst.name, keep_val);
+            store(VAR(target), keep_val);
             break;
         }
-        case OP_ASSIGN:
-            if (variable_exists(inst.name)) {
-                _JechVM_SetVariable(inst.name, inst.operand);
+        case OP_ASSIGN: {
+            uint32_t target = _JechBytecode_ReadSlot(bc, & pc);
+            uint32_t slot = 0;
+            const JechConstant * constant = NULL;
+            JechTokenType type = _JechBytecode_ReadValue(bc, & pc, & slot, & constant);
+            if (load(VAR(target))) {
+                const char * assign_val = type == TOKEN_IDENTIFIER
+                    ? require_slot(bc, slot) : _JechBytecode_Text(bc, constant);
+                store(VAR(target), assign_val);
             } else {
-                report_runtime_error("Cannot assign to undeclared variable", 0, 0);
+                report_runtime_error_at("Cannot assign to undeclared variable", _JechBytecode_OffsetAt(bc, at));
                 exit(1);
             }
             break;
+        }
         case OP_BIN_OP: {
-            // Get left operand value
-            const char * left_val = NULL;
-            if (inst.token_type == TOKEN_IDENTIFIER) {
-                left_val = _JechVM_GetVariable(inst.operand);
-                if (!left_val) {
-                    fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.operand);
-                    exit(1);
-                }
-            } else {
-                left_val = inst.operand;
-            }
-
-            // Get right operand value
-            const char * right_val = NULL;
-            if (inst.cmp_operand_type == TOKEN_IDENTIFIER) {
-                right_val = _JechVM_GetVariable(inst.operand_right);
-                if (!right_val) {
-                    fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.operand_right);
-                    exit(1);
-                }
-            } else {
-                right_val = inst.operand_right;
-            }
-
-            // Check if this is string concatenation (+ operator with at least one string)
-            // For variables, we need to check if their content looks like a string
-            bool left_is_string = (inst.token_type == TOKEN_STRING);
-            bool right_is_string = (inst.cmp_operand_type == TOKEN_STRING);
-            
-            // If operands are variables, check their content to determine if they're strings
-            if (inst.token_type == TOKEN_IDENTIFIER && left_val) {
-                // Check if variable content looks like a string (contains quotes or is not a number)
-                left_is_string = (strlen(left_val) > 0 && 
-                                 (left_val[0] == '"' || left_val[0] == '\'' || 
-                                  (atof(left_val) == 0.0 && strcmp(left_val, "0") != 0 && strcmp(left_val, "0.00") != 0)));
-            }
-            
-            if (inst.cmp_operand_type == TOKEN_IDENTIFIER && right_val) {
-                right_is_string = (strlen(right_val) > 0 && 
-                                  (right_val[0] == '"' || right_val[0] == '\'' || 
-                                   (atof(right_val) == 0.0 && strcmp(right_val, "0") != 0 && strcmp(right_val, "0.00") != 0)));
-            }
-            
-            if (inst.bin_op == TOKEN_PLUS && (left_is_string || right_is_string)) {
+            // Direct forms store the result only when flagged
+            JechDestination dest = (JechDestination) _JechBytecode_ReadVarint(bc, & pc);
+            bool stored = dest == JECH_TO_DEFAULT || _JechBytecode_ReadVarint(bc, & pc);
+            uint32_t target = stored ? _JechBytecode_ReadSlot(bc, & pc) : JECH_RESULT_SLOT;
+            JechTokenType bin_op = (JechTokenType) _JechBytecode_ReadVarint(bc, & pc);
+            uint32_t left_slot = 0, right_slot = 0;
+            const JechConstant * left_constant = NULL, * right_constant = NULL;
+            JechTokenType left_type = _JechBytecode_ReadValue(bc, & pc, & left_slot, & left_constant);
+            JechTokenType right_type = _JechBytecode_ReadValue(bc, & pc, & right_slot, & right_constant);
+
+            // Get operand values
+            const char * left_val = left_type == TOKEN_IDENTIFIER
+                ? require_slot(bc, left_slot) : _JechBytecode_Text(bc, left_constant);
+            const char * right_val = right_type == TOKEN_IDENTIFIER
+                ? require_slot(bc, right_slot) : _JechBytecode_Text(bc, right_constant);
+
+            // Check if this is string concatenation (+ operator with at least one string);
+            // a variable is a string when its content looks like one
+            bool left_is_string = left_type == TOKEN_STRING ||
+                (left_type == TOKEN_IDENTIFIER && looks_like_string(left_val));
+            bool right_is_string = right_type == TOKEN_STRING ||
+                (right_type == TOKEN_IDENTIFIER && looks_like_string(right_val));
+
+            // Literal numbers were decoded by the lexer
+            double left = left_type == TOKEN_NUMBER
+                ? _JechNumber_AsDouble(&left_constant -> number) : 0;
+            double right = right_type == TOKEN_NUMBER
+                ? _JechNumber_AsDouble(&right_constant -> number) : 0;
+
+            if (bin_op == TOKEN_EQEQ || bin_op == TOKEN_LT || bin_op == TOKEN_GT) {
+                // Comparison: strings and bools compare as text, as does == on variables
+                bool as_strings = left_type == TOKEN_STRING || right_type == TOKEN_STRING ||
+                    left_type == TOKEN_BOOL || right_type == TOKEN_BOOL ||
+                    (bin_op == TOKEN_EQEQ &&
+                        left_type == TOKEN_IDENTIFIER && right_type == TOKEN_IDENTIFIER);
+                if (left_type != TOKEN_NUMBER) left = atof(left_val);
+                if (right_type != TOKEN_NUMBER) right = atof(right_val);
+                bool is_true = compare_values(left_val, right_val, left, right, bin_op, as_strings);
+                deliver(bc, & pc, dest, stored, target, is_true ? "true" : "false");
+            } else if (bin_op == TOKEN_PLUS && (left_is_string || right_is_string)) {
                 // String concatenation
                 char result_str[MAX_STRING];
                 snprintf(result_str, sizeof(result_str), "%s%s", left_val, right_val);
-                _JechVM_SetVariable(inst.name, result_str);
+                deliver(bc, & pc, dest, stored, target, result_str);
             } else {
                 // Numeric operation
-                double left = atof(left_val);
-                double right = atof(right_val);
+                if (left_type != TOKEN_NUMBER) left = atof(left_val);
+                if (right_type != TOKEN_NUMBER) right = atof(right_val);
                 double result = 0;
 
-                switch (inst.bin_op) {
+                switch (bin_op) {
                 case TOKEN_PLUS:
                     result = left + right;
                     break;
@@ -403,156 +628,97 @@ void _JechVM_Execute(const Bytecode * bc) {
 
                 char result_str[MAX_STRING];
                 snprintf(result_str, sizeof(result_str), "%.2f", result);
-                _JechVM_SetVariable(inst.name, result_str);
+                deliver(bc, & pc, dest, stored, target, result_str);
             }
             break;
         }
         case OP_WHEN: {
             // Binary condition: when (x > 10) or when (x == "hello") { ... } else { ... }
-            const char * left_val = _JechVM_GetVariable(inst.name);
-            if (!left_val) {
-                fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.name);
-                exit(1);
-            }
+            JechTokenType bin_op = (JechTokenType) _JechBytecode_ReadVarint(bc, & pc);
+            const char * left_val = require_slot(bc, _JechBytecode_ReadSlot(bc, & pc));
 
             // Get right operand value (could be literal or variable)
-            const char * right_val = inst.operand;
-            if (inst.cmp_operand_type == TOKEN_IDENTIFIER) {
-                right_val = _JechVM_GetVariable(inst.operand);
-                if (!right_val) {
-                    fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.operand);
-                    exit(1);
-                }
-            }
-
-            bool is_true = false;
-
-            // String comparison for == with strings
-            if (inst.cmp_operand_type == TOKEN_STRING ||
-                (inst.cmp_operand_type == TOKEN_IDENTIFIER && inst.bin_op == TOKEN_EQEQ)) {
-                // Use string comparison for == operator
-                if (inst.bin_op == TOKEN_EQEQ) {
-                    is_true = (strcmp(left_val, right_val) == 0);
-                } else if (inst.bin_op == TOKEN_GT) {
-                    is_true = (strcmp(left_val, right_val) > 0);
-                } else if (inst.bin_op == TOKEN_LT) {
-                    is_true = (strcmp(left_val, right_val) < 0);
-                }
-            } else {
-                // Numeric comparison
-                double left = atof(left_val);
-                double right = atof(right_val);
-
-                switch (inst.bin_op) {
-                case TOKEN_GT:
-                    is_true = (left > right);
-                    break;
-                case TOKEN_LT:
-                    is_true = (left < right);
-                    break;
-                case TOKEN_EQEQ:
-                    is_true = (left == right);
-                    break;
-                default:
-                    fprintf(stderr, "Runtime Error: Unsupported operator in when.\n");
-                    exit(1);
-                }
-            }
-
-            if (is_true) {
-                if (inst.token_type == TOKEN_IDENTIFIER) {
-                    const char * say_val = _JechVM_GetVariable(inst.operand_right);
-                    if (say_val)
-                        printf("%s\n", say_val);
-                    else
-                        fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.operand_right);
-                } else {
-                    printf("%s\n", inst.operand_right);
-                }
-            } else if (inst.has_else) {
-                if (inst.else_token_type == TOKEN_IDENTIFIER) {
-                    const char * say_val = _JechVM_GetVariable(inst.else_operand);
-                    if (say_val)
-                        printf("%s\n", say_val);
-                    else
-                        fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.else_operand);
-                } else {
-                    printf("%s\n", inst.else_operand);
-                }
-            }
+            uint32_t right_slot = 0;
+            const JechConstant * right_constant = NULL;
+            JechTokenType right_type = _JechBytecode_ReadValue(bc, & pc, & right_slot, & right_constant);
+            const char * right_val = right_type == TOKEN_IDENTIFIER
+                ? require_slot(bc, right_slot) : _JechBytecode_Text(bc, right_constant);
+
+            // String comparison with string literals and for == between variables;
+            // a literal number on the right was decoded by the lexer
+            bool as_strings = right_type == TOKEN_STRING ||
+                (right_type == TOKEN_IDENTIFIER && bin_op == TOKEN_EQEQ);
+            double right = right_type == TOKEN_NUMBER
+                ? _JechNumber_AsDouble(&right_constant -> number) : atof(right_val);
+            bool is_true = compare_values(left_val, right_val, atof(left_val), right, bin_op, as_strings);
+            say_branch(bc, & pc, is_true);
             break;
         }
         case OP_WHEN_BOOL: {
             // Boolean/identifier condition: when (name) { ... } else { ... }
-            bool is_true = false;
-
-            if (inst.bin_op == TOKEN_BOOL) {
+            bool is_true;
+            if ((JechTokenType) _JechBytecode_ReadVarint(bc, & pc) == TOKEN_BOOL) {
                 // Literal true/false
-                is_true = strcmp(inst.name, "true") == 0;
+                is_true = strcmp(_JechBytecode_ReadString(bc, & pc), "true") == 0;
             } else {
                 // Identifier - get variable value at runtime
-                const char * var_val = _JechVM_GetVariable(inst.name);
-                if (!var_val) {
-                    fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.name);
-                    exit(1);
-                }
-                is_true = strcmp(var_val, "true") == 0;
-            }
-
-            if (is_true) {
-                if (inst.token_type == TOKEN_IDENTIFIER) {
-                    const char * say_val = _JechVM_GetVariable(inst.operand);
-                    if (say_val)
-                        printf("%s\n", say_val);
-                    else
-                        fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.operand);
-                } else {
-                    printf("%s\n", inst.operand);
-                }
-            } else if (inst.has_else) {
-                if (inst.else_token_type == TOKEN_IDENTIFIER) {
-                    const char * say_val = _JechVM_GetVariable(inst.else_operand);
-                    if (say_val)
-                        printf("%s\n", say_val);
-                    else
-                        fprintf(stderr, "Runtime Error: Undefined variable '%s'\n", inst.else_operand);
-                } else {
-                    printf("%s\n", inst.else_operand);
-                }
+                is_true = strcmp(require_slot(bc, _JechBytecode_ReadSlot(bc, & pc)), "true") == 0;
             }
+            say_branch(bc, & pc, is_true);
             break;
         }
         case OP_FUNCTION_DECL: {
-            if (function_count >= MAX_FUNCTIONS) {
-                fprintf(stderr, "Runtime Error: Too many functions\n");
-                exit(1);
+            if (function_count >= function_capacity) {
+                int capacity = function_capacity ? function_capacity * 2 : 32;
+                JechFunction * grown = realloc(functions, sizeof(JechFunction) * capacity);
+                if (!grown) {
+                    out_of_memory();
+                }
+                functions = grown;
+                function_capacity = capacity;
             }
-            strncpy(functions[function_count].name, inst.name, MAX_STRING);
-            functions[function_count].param_count = inst.param_count;
-            for (int j = 0; j < inst.param_count; j++) {
-                strncpy(functions[function_count].params[j], inst.params[j], MAX_STRING);
+            JechFunction * func = & functions[function_count];
+            strncpy(func -> name, _JechBytecode_ReadString(bc, & pc), MAX_STRING);
+            func -> param_count = (int) _JechBytecode_ReadVarint(bc, & pc);
+            for (int j = 0; j < func -> param_count; j++) {
+                func -> params[j] = VAR(_JechBytecode_ReadSlot(bc, & pc));
+            }
+
+            // Body: 0 none, 1 compiled (function index), 2 lazy (source span)
+            func -> body_bc = NULL;
+            func -> body_source = NULL;
+            func -> body_offset = 0;
+            func -> body_length = 0;
+            uint32_t body = _JechBytecode_ReadVarint(bc, & pc);
+            if (body == 1) {
+                func -> body_bc = bc -> functions[_JechBytecode_ReadVarint(bc, & pc)];
+            } else if (body == 2) {
+                func -> body_source = bc -> source;
+                func -> body_offset = (int) _JechBytecode_ReadVarint(bc, & pc);
+                func -> body_length = (int) _JechBytecode_ReadVarint(bc, & pc);
             }
-            functions[function_count].body_bc = inst.body_bc;
             function_count++;
             break;
         }
         case OP_FUNCTION_CALL: {
+            const char * name = _JechBytecode_ReadString(bc, & pc);
+            int arg_count = (int) _JechBytecode_ReadVarint(bc, & pc);
             JechFunction * func = NULL;
             for (int j = 0; j < function_count; j++) {
-                if (strcmp(functions[j].name, inst.name) == 0) {
+                if (strcmp(functions[j].name, name) == 0) {
                     func = & functions[j];
                     break;
                 }
             }
             if (!func) {
-                fprintf(stderr, "Runtime Error: Function '%s' not defined\n", inst.name);
+                fprintf(stderr, "Runtime Error: Function '%s' not defined\n", name);
                 exit(1);
             }
 
             // Check argument count matches parameter count
-            if (inst.arg_count != func -> param_count) {
+            if (arg_count != func -> param_count) {
                 fprintf(stderr, "Runtime Error: Function '%s' expects %d arguments but got %d\n",
-                    inst.name, func -> param_count, inst.arg_count);
+                    name, func -> param_count, arg_count);
                 exit(1);
             }
 
@@ -561,14 +727,32 @@ void _JechVM_Execute(const Bytecode * bc) {
 
             // Bind parameters to arguments
             for (int j = 0; j < func -> param_count; j++) {
-                const char * arg_value = inst.args[j];
-                if (inst.arg_types[j] == TOKEN_IDENTIFIER) {
-                    const char * resolved = _JechVM_GetVariable(inst.args[j]);
-                    if (resolved) {
-                        arg_value = resolved;
+                uint32_t slot = 0;
+                const JechConstant * constant = NULL;
+                const char * arg_value;
+                if (_JechBytecode_ReadValue(bc, & pc, & slot, & constant) == TOKEN_IDENTIFIER) {
+                    // An undefined name is passed as its own text
+                    arg_value = read_slot(bc, slot);
+                    if (!arg_value) {
+                        arg_value = _JechBytecode_SlotName(bc, slot);
                     }
+                } else {
+                    arg_value = _JechBytecode_Text(bc, constant);
                 }
-                _JechVM_SetVariable(func -> params[j], arg_value);
+                store(func -> params[j], arg_value);
+            }
+            JechDestination dest = (JechDestination) _JechBytecode_ReadVarint(bc, & pc);
+            uint32_t kept = dest == JECH_TO_KEEP ? _JechBytecode_ReadSlot(bc, & pc) : 0;
+
+            // A lazy body is compiled once, on its first call
+            if (!func -> body_bc && func -> body_source) {
+                if (!body_compiler) {
+                    fprintf(stderr, "Runtime Error: Function '%s' was not compiled\n", name);
+                    exit(1);
+                }
+                func -> body_bc = body_compiler(func -> body_source,
+                    func -> body_offset, func -> body_length);
+                func -> body_source = NULL;
             }
 
             // Execute the function body
@@ -580,16 +764,30 @@ void _JechVM_Execute(const Bytecode * bc) {
             }
 
             // Clean up temporary variables (restore scope)
-            var_count = saved_var_count;
+            drop_variables(saved_var_count);
+
+            // keep result = func(args); fused by the peephole pass
+            if (dest == JECH_TO_KEEP) {
+                if (load(VAR(kept)) != NULL) {
+                    report_runtime_error_at("Variable already declared", _JechBytecode_OffsetAt(bc, at));
+                    exit(1);
+                }
+                store(VAR(kept), last_return_value);
+            }
             break;
         }
         case OP_RETURN: {
-            const char * ret_val = inst.operand;
-            if (inst.token_type == TOKEN_IDENTIFIER) {
-                const char * resolved = _JechVM_GetVariable(inst.operand);
-                if (resolved) {
-                    ret_val = resolved;
+            uint32_t slot = 0;
+            const JechConstant * constant = NULL;
+            const char * ret_val;
+            if (_JechBytecode_ReadValue(bc, & pc, & slot, & constant) == TOKEN_IDENTIFIER) {
+                // An undefined name is returned as its own text
+                ret_val = read_slot(bc, slot);
+                if (!ret_val) {
+                    ret_val = _JechBytecode_SlotName(bc, slot);
                 }
+            } else {
+                ret_val = _JechBytecode_Text(bc, constant);
             }
             strncpy(last_return_value, ret_val, MAX_STRING);
             has_returned = true;
@@ -598,8 +796,8 @@ void _JechVM_Execute(const Bytecode * bc) {
         case OP_END:
             return;
         default:
-            fprintf(stderr, "VM error: unknown opcode %d\n", inst.op);
+            fprintf(stderr, "VM error: unknown opcode %d\n", op);
             return;
         }
     }
-}
\ No newline at end of file
+}
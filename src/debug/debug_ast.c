@@ -1,13 +1,13 @@
 #include <stdio.h>
-#include "core/ast.h"
+#include "core/flat_ast.h"
 #include "debug/debug_ast.h"
 
-void debug_print_ast(JechASTNode **roots, int count)
+void debug_print_ast(const JechFlatAST *ast)
 {
     printf("\n--- AST Tree ---\n");
-    for (int i = 0; i < count; i++)
+    for (int i = 0; i < ast->root_count; i++)
     {
-        _JechAST_Print(roots[i], 0);
+        _JechFlatAST_Print(ast, ast->roots[i], 0);
     }
     printf("\n");
 }
@@ -1,14 +1,18 @@
 #include <stdio.h>
+#include <string.h>
 #include "core/bytecode.h"
+#include "core/peephole.h"
 #include "debug/debug_bytecode.h"
 #include "utils/token_utils.h"
 
 void debug_print_bytecode(const Bytecode *bc)
 {
     printf("\n--- Bytecode ---\n");
-    for (int i = 0; i < bc->count; i++)
+    for (int pc = 0; pc < bc->length;)
     {
-        Instruction inst = bc->instructions[i];
+        Instruction inst;
+        memset(&inst, 0, sizeof(inst));
+        pc = _JechBytecode_Decode(bc, pc, &inst);
         const char *op_name = "";
         switch (inst.op)
         {
@@ -41,7 +45,12 @@ void debug_print_bytecode(const Bytecode *bc)
         }
         else if (inst.op == OP_BIN_OP)
         {
-            printf(" %s = %s %c %s", inst.name, inst.operand, 
+            printf(" %s = %s %c %s",
+                   inst.dest == JECH_TO_SAY      ? "(say)"
+                   : inst.dest == JECH_TO_RETURN ? "(return)"
+                   : inst.dest == JECH_TO_WHEN   ? "(when)"
+                                                 : inst.name,
+                   inst.operand, 
                    inst.bin_op == TOKEN_PLUS ? '+' : 
                    inst.bin_op == TOKEN_MINUS ? '-' : 
                    inst.bin_op == TOKEN_STAR ? '*' : '/', 
@@ -50,5 +59,6 @@ void debug_print_bytecode(const Bytecode *bc)
 
         printf(" [type: %s]\n", token_type_to_str(inst.token_type));
     }
+    printf("Peephole: %d instructions removed\n", _JechPeephole_Removed(bc));
     printf("\n");
 }
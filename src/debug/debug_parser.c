@@ -1,29 +1,31 @@
 #include <stdio.h>
 #include "debug/debug_parser.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
 
-void debug_print_parser(JechASTNode **roots, int count)
+void debug_print_parser(const JechFlatAST *ast)
 {
     printf("\n--- Parser Output (AST Roots) ---\n");
 
-    for (int i = 0; i < count; i++)
+    for (int i = 0; i < ast->root_count; i++)
     {
-        JechASTNode *node = roots[i];
+        JechNodeId node = ast->roots[i];
+        const char *name = _JechFlatAST_Name(ast, node);
+        const char *value = _JechFlatAST_Value(ast, node);
 
-        const char *kind = (node->type == JECH_AST_SAY) ? "say" : (node->type == JECH_AST_KEEP) ? "keep"
-                                                                                                : "unknown";
+        const char *kind = (ast->type[node] == JECH_AST_SAY) ? "say" : (ast->type[node] == JECH_AST_KEEP) ? "keep"
+                                                                                                        : "unknown";
 
-        if (node->type == JECH_AST_SAY)
+        if (ast->type[node] == JECH_AST_SAY)
         {
-            printf("Instruction: %s(\"%s\")\n", kind, node->value);
+            printf("Instruction: %s(\"%s\")\n", kind, value);
         }
-        else if (node->type == JECH_AST_KEEP)
+        else if (ast->type[node] == JECH_AST_KEEP)
         {
-            printf("Instruction: %s %s = \"%s\"\n", kind, node->name, node->value);
+            printf("Instruction: %s %s = \"%s\"\n", kind, name, value);
         }
         else
         {
-            printf("Instruction: unknown → name=%s, value=%s\n", node->name, node->value);
+            printf("Instruction: unknown → name=%s, value=%s\n", name, value);
         }
     }
 
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "core/tokenizer.h"
+#include "core/lines.h"
 #include "debug/debug_tokenizer.h"
 #include "utils/token_utils.h"
 
@@ -8,7 +9,9 @@ void debug_print_tokens(const JechTokenList *list)
     printf("\n--- Tokens ---\n");
     for (int i = 0; i < list->count; i++)
     {
-        printf("Token: Type=%s, Value=\"%s\"\n", token_type_to_str(list->tokens[i].type), list->tokens[i].value);
+        int line, column;
+        _JechLines_Locate(list->tokens[i].offset, &line, &column);
+        printf("Token: Type=%s, Value=\"%.*s\" (%d:%d)\n", token_type_to_str(list->tokens[i].type), list->tokens[i].length, list->tokens[i].start, line, column);
     }
     printf("\n");
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "core/vm.h"
 #include "debug/debug_vm.h"
 
@@ -10,3 +11,43 @@ void debug_print_variables()
     _debug_vm_dump_vars();
     printf("\n");
 }
+
+static const char *OPCODE_NAMES[JECH_OPCODE_COUNT] = {
+    "OP_SAY", "OP_SAY_INDEX", "OP_ARRAY_NEW", "OP_ARRAY_PUSH", "OP_KEEP",
+    "OP_ASSIGN", "OP_INDEX_GET", "OP_BIN_OP", "OP_WHEN", "OP_WHEN_BOOL",
+    "OP_MAP", "OP_FUNCTION_DECL", "OP_FUNCTION_CALL", "OP_RETURN", "OP_END",
+};
+
+typedef struct
+{
+    int first;
+    int second;
+    unsigned long long count;
+} OpcodePair;
+
+static int by_count(const void *a, const void *b)
+{
+    unsigned long long x = ((const OpcodePair *)a)->count, y = ((const OpcodePair *)b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void debug_print_profile()
+{
+    const JechVMProfile *profile = _JechVM_Profile();
+    OpcodePair pairs[JECH_OPCODE_COUNT * JECH_OPCODE_COUNT];
+    int count = 0;
+    for (int first = 0; first < JECH_OPCODE_COUNT; first++)
+    {
+        for (int second = 0; second < JECH_OPCODE_COUNT; second++)
+        {
+            if (profile->pairs[first][second] > 0)
+                pairs[count++] = (OpcodePair){first, second, profile->pairs[first][second]};
+        }
+    }
+    qsort(pairs, count, sizeof(OpcodePair), by_count);
+
+    fprintf(stderr, "\n--- VM Profile ---\n");
+    fprintf(stderr, "Dispatches: %llu\n", profile->dispatches);
+    for (int i = 0; i < count; i++)
+        fprintf(stderr, "%10llu  %s -> %s\n", pairs[i].count, OPCODE_NAMES[pairs[i].first], OPCODE_NAMES[pairs[i].second]);
+}
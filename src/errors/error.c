@@ -1,7 +1,19 @@
+#include <stdlib.h>
+#include <string.h>
 #include "errors/error.h"
+#include "core/lines.h"
+
+static int error_count = 0;
+static JechDiagnostics *captured = NULL;
+
+int reported_error_count()
+{
+    return error_count;
+}
 
 void print_error_header(JechErrorType type)
 {
+    error_count++;
     switch (type)
     {
     case SYNTAX_ERROR:
@@ -33,3 +45,65 @@ void report_runtime_error(const char *message, int line, int column)
     print_error_header(ERROR_RUNTIME);
     fprintf(stderr, "at line %d, col %d: %s\n", line, column, message);
 }
+
+JechDiagnostics *capture_diagnostics(JechDiagnostics *list)
+{
+    JechDiagnostics *previous = captured;
+    captured = list;
+    return previous;
+}
+
+/**
+ * Appends a report to the capture list; returns 0 if out of memory
+ */
+static int hold(JechErrorType type, const char *message, int offset)
+{
+    if (captured->count == captured->capacity)
+    {
+        int capacity = captured->capacity ? captured->capacity * 2 : 2;
+        JechDiagnostic *items = realloc(captured->items, sizeof(JechDiagnostic) * capacity);
+        if (!items)
+            return 0;
+        captured->items = items;
+        captured->capacity = capacity;
+    }
+    JechDiagnostic *d = &captured->items[captured->count++];
+    d->type = type;
+    strncpy(d->message, message, sizeof(d->message) - 1);
+    d->message[sizeof(d->message) - 1] = '\0';
+    d->offset = offset;
+    return 1;
+}
+
+void report_diagnostics(const JechDiagnostics *list, int shift)
+{
+    for (int i = 0; i < list->count; i++)
+        report_error_at(list->items[i].type, list->items[i].message, list->items[i].offset + shift);
+}
+
+void free_diagnostics(JechDiagnostics *list)
+{
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
+
+void report_error_at(JechErrorType type, const char *message, int offset)
+{
+    // Printed anyway if it cannot be held
+    if (captured && hold(type, message, offset))
+        return;
+
+    int line, column;
+    _JechLines_Locate(offset, &line, &column);
+    report_error(type, message, line, column);
+}
+
+void report_syntax_error_at(const char *message, int offset)
+{
+    report_error_at(SYNTAX_ERROR, message, offset);
+}
+
+void report_runtime_error_at(const char *message, int offset)
+{
+    report_error_at(ERROR_RUNTIME, message, offset);
+}
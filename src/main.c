@@ -13,6 +13,20 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
+	// jech --compile program.jc program.jcb: build an image for jech-run
+	if (strcmp(argv[1], "--compile") == 0)
+	{
+		if (argc != 4 || !is_valid_extension(argv[2]))
+		{
+			printf("Usage: jech --compile <file.jc> <output.jcb>\n");
+			return 1;
+		}
+		JechSourceFile source = load_source_file(argv[2]);
+		int compiled = compile_pipeline(source.data, source.length, argv[3]);
+		unmap_file_content(&source);
+		return compiled ? 0 : 1;
+	}
+
 	const char *filename = argv[1];
 
 	if (!is_valid_extension(filename))
@@ -21,10 +35,10 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	char *source = load_source_file(filename);
+	JechSourceFile source = load_source_file(filename);
 
-	run_pipeline(source);
+	run_cached_pipeline(source.data, source.length);
 
-	free(source);
+	unmap_file_content(&source);
 	return 0;
 }
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "core/image.h"
+#include "core/vm.h"
+#include "utils/read_file.h"
+
+/**
+ * Execute-only runtime: runs bytecode images written by
+ * `jech --compile`. It links the VM and the image loader but no lexer,
+ * parser or compiler, so it cannot run source files.
+ */
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		printf("Usage: jech-run <file.jcb>\n");
+		return 1;
+	}
+
+	JechSourceFile image;
+	if (!map_file_content(argv[1], &image))
+	{
+		printf("Could not read file: %s\n", argv[1]);
+		return 1;
+	}
+
+	Bytecode bytecode;
+	if (!_JechImage_Load(image.data, image.length, NULL, 0, &bytecode))
+	{
+		printf("Error: %s is not a jech bytecode image for this version.\n", argv[1]);
+		unmap_file_content(&image);
+		return 1;
+	}
+
+	_JechVM_Execute(&bytecode);
+	_JechBytecode_Free(&bytecode);
+	unmap_file_content(&image);
+	return 0;
+}
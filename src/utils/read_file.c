@@ -1,6 +1,53 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "utils/read_file.h"
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define JECH_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Reads a stream to the end into a NUL-terminated heap buffer and closes
+ * it. Pipes and special files have no usable size, so the buffer grows.
+ */
+static char *read_stream_content(FILE *file)
+{
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t n;
+    while ((n = fread(buffer + length, 1, capacity - length - 1, file)) > 0)
+    {
+        length += n;
+        if (capacity - length == 1)
+        {
+            char *grown = realloc(buffer, capacity * 2);
+            if (!grown)
+            {
+                free(buffer);
+                fclose(file);
+                return NULL;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+    }
+    buffer[length] = '\0';
+    fclose(file);
+
+    return buffer;
+}
 
 char *read_file_content(const char *filename)
 {
@@ -8,17 +55,94 @@ char *read_file_content(const char *filename)
     if (!file)
         return NULL;
 
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    rewind(file);
+    return read_stream_content(file);
+}
 
-    char *buffer = malloc(length + 1);
+/**
+ * Takes ownership of a heap buffer holding the file contents
+ */
+static int adopt_buffer(char *buffer, JechSourceFile *file)
+{
     if (!buffer)
-        return NULL;
+        return 0;
 
-    fread(buffer, 1, length, file);
-    buffer[length] = '\0';
-    fclose(file);
+    file->data = buffer;
+    file->length = strlen(buffer);
+    file->mapped = 0;
+    file->map_length = 0;
+    return 1;
+}
 
-    return buffer;
-}
\ No newline at end of file
+#ifdef JECH_HAVE_MMAP
+/**
+ * Maps `size` bytes of `fd` followed by at least one zero byte. A file
+ * whose size is an exact multiple of the page size gets no zero tail from
+ * the kernel, so an anonymous zero page is reserved behind the mapping.
+ */
+static int map_with_terminator(int fd, size_t size, JechSourceFile *file)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_length = (size / page + 1) * page;
+
+    void *base = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return 0;
+
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, map_length);
+        return 0;
+    }
+
+    file->data = base;
+    file->length = size;
+    file->mapped = 1;
+    file->map_length = map_length;
+    return 1;
+}
+#endif
+
+int map_file_content(const char *filename, JechSourceFile *file)
+{
+#ifdef JECH_HAVE_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        if (map_with_terminator(fd, (size_t)st.st_size, file))
+        {
+            close(fd);
+            return 1;
+        }
+    }
+
+    // Not mappable: read from the descriptor already open, since reopening
+    // a pipe would block waiting for a new writer
+    FILE *stream = fdopen(fd, "r");
+    if (!stream)
+    {
+        close(fd);
+        return 0;
+    }
+    return adopt_buffer(read_stream_content(stream), file);
+#else
+    return adopt_buffer(read_file_content(filename), file);
+#endif
+}
+
+void unmap_file_content(JechSourceFile *file)
+{
+#ifdef JECH_HAVE_MMAP
+    if (file->mapped)
+    {
+        munmap((void *)file->data, file->map_length);
+        file->data = NULL;
+        return;
+    }
+#endif
+    free((void *)file->data);
+    file->data = NULL;
+}
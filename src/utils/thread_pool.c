@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils/thread_pool.h"
+
+#if !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define JECH_HAVE_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define THREAD_POOL_MAX_WORKERS 64
+#define THREAD_POOL_INITIAL_JOBS 64
+
+typedef struct
+{
+    ThreadPoolTask task;
+    void *arg;
+} ThreadPoolJob;
+
+struct ThreadPool
+{
+    int size;
+#ifdef JECH_HAVE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t all_done;
+
+    // Ring buffer of queued jobs
+    ThreadPoolJob *jobs;
+    int capacity;
+    int head;
+    int queued;
+    int running;
+#endif
+};
+
+int thread_pool_default_size()
+{
+#ifdef JECH_HAVE_THREADS
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return cpus > THREAD_POOL_MAX_WORKERS ? THREAD_POOL_MAX_WORKERS : (int)cpus;
+#else
+    return 1;
+#endif
+}
+
+#ifdef JECH_HAVE_THREADS
+static ThreadPool shared_pool;
+static ThreadPool *shared = NULL;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+static void *worker_main(void *data)
+{
+    ThreadPool *pool = data;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->queued == 0)
+            pthread_cond_wait(&pool->has_work, &pool->lock);
+
+        ThreadPoolJob job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->queued--;
+        pool->running++;
+        pthread_mutex_unlock(&pool->lock);
+
+        job.task(job.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running--;
+        if (pool->queued == 0 && pool->running == 0)
+            pthread_cond_broadcast(&pool->all_done);
+    }
+    return NULL;
+}
+
+/**
+ * Starts the shared pool's workers; they live until the process exits
+ */
+static void create_shared_pool()
+{
+    ThreadPool *pool = &shared_pool;
+    pool->capacity = THREAD_POOL_INITIAL_JOBS;
+    pool->jobs = malloc(sizeof(ThreadPoolJob) * pool->capacity);
+    if (!pool->jobs)
+        return;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    pool->head = 0;
+    pool->queued = 0;
+    pool->running = 0;
+
+    int size = thread_pool_default_size();
+    for (pool->size = 0; pool->size < size; pool->size++)
+    {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, worker_main, pool) != 0)
+            break;
+        pthread_detach(worker);
+    }
+
+    if (pool->size > 0)
+        shared = pool;
+}
+#endif
+
+ThreadPool *thread_pool_shared()
+{
+#ifdef JECH_HAVE_THREADS
+    pthread_once(&shared_once, create_shared_pool);
+    return shared;
+#else
+    return NULL;
+#endif
+}
+
+int thread_pool_size(const ThreadPool *pool)
+{
+    return pool ? pool->size : 1;
+}
+
+void thread_pool_submit(ThreadPool *pool, ThreadPoolTask task, void *arg)
+{
+#ifdef JECH_HAVE_THREADS
+    if (pool)
+    {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->queued == pool->capacity)
+        {
+            // Unroll the ring into a buffer twice the size
+            ThreadPoolJob *jobs = malloc(sizeof(ThreadPoolJob) * pool->capacity * 2);
+            if (!jobs)
+            {
+                pthread_mutex_unlock(&pool->lock);
+                task(arg);
+                return;
+            }
+            for (int i = 0; i < pool->queued; i++)
+                jobs[i] = pool->jobs[(pool->head + i) % pool->capacity];
+            free(pool->jobs);
+            pool->jobs = jobs;
+            pool->head = 0;
+            pool->capacity *= 2;
+        }
+
+        int tail = (pool->head + pool->queued) % pool->capacity;
+        pool->jobs[tail].task = task;
+        pool->jobs[tail].arg = arg;
+        pool->queued++;
+        pthread_cond_signal(&pool->has_work);
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+#endif
+    task(arg);
+}
+
+void thread_pool_wait(ThreadPool *pool)
+{
+#ifdef JECH_HAVE_THREADS
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued > 0 || pool->running > 0)
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
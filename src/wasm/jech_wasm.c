@@ -8,13 +8,58 @@
 #include "core/tokenizer.h"
 #include "core/parser/parser.h"
 #include "core/bytecode.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
+#include "core/optimizer.h"
+#include "core/document.h"
 
 #define OUTPUT_BUFFER_SIZE 16384
 
 static char output_buffer[OUTPUT_BUFFER_SIZE];
 static int output_pos = 0;
 
+// The playground re-runs the whole buffer after every change, so the
+// previous source is kept as a document and only the edited span is
+// re-lexed and re-parsed
+static JechDocument document;
+static int document_ready = 0;
+
+/**
+ * Brings the document in line with `source` by applying the single edit
+ * that spans everything between their common prefix and suffix
+ */
+static int sync_document(const char *source) {
+    if (!document_ready) {
+        _JechDocument_Free(&document);
+        document_ready = _JechDocument_Init(&document, source);
+        return document_ready;
+    }
+
+    int old_length = document.length;
+    int new_length = (int)strlen(source);
+    int prefix = 0;
+    while (prefix < old_length && prefix < new_length && document.text[prefix] == source[prefix]) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < old_length - prefix && suffix < new_length - prefix &&
+           document.text[old_length - 1 - suffix] == source[new_length - 1 - suffix]) {
+        suffix++;
+    }
+
+    if (prefix == old_length && prefix == new_length) {
+        return 1;
+    }
+    if (_JechDocument_Edit(&document, prefix, old_length - prefix - suffix,
+                           source + prefix, new_length - prefix - suffix)) {
+        return 1;
+    }
+
+    // A failed edit can leave the document half-updated; start over
+    _JechDocument_Free(&document);
+    document_ready = _JechDocument_Init(&document, source);
+    return document_ready;
+}
+
 /**
  * Função para adicionar texto ao buffer de saída
  * Esta será chamada pelo JavaScript via EM_JS
@@ -55,33 +100,44 @@ const char* jech_execute(const char *source) {
         return output_buffer;
     }
     
-    // Tokenize
-    JechTokenList tokens = _JechTokenizer_Lex(source);
-    
-    if (tokens.count == 0 || (tokens.count == 1 && tokens.tokens[0].type == TOKEN_EOF)) {
+    // Re-lex and re-parse only what changed since the previous run
+    if (!sync_document(source)) {
+        strcpy(output_buffer, "Error: Out of memory");
+        return output_buffer;
+    }
+
+    if (document.tokens.tokens[0].type == TOKEN_EOF) {
         strcpy(output_buffer, "");
         return output_buffer;
     }
     
-    // Parse
-    int ast_count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &ast_count);
+    // Statements parsed on an earlier run keep their errors, so the whole
+    // buffer's errors are printed every time, like the command line does
+    _JechDocument_Report(&document);
+
+    int part_count = 0;
+    int failed = 0;
+    JechFlatAST **parts = _JechDocument_Parts(&document, &part_count, &failed);
     
-    if (ast_count == 0) {
+    if (!parts || failed || part_count == 0) {
+        free(parts);
         strcpy(output_buffer, "Error: Failed to parse code");
         return output_buffer;
     }
     
-    // Compile to bytecode
-    Bytecode bytecode = _JechBytecode_CompileAll(roots, ast_count);
+    // Compile to bytecode; folding rewrites nodes in place, which the
+    // document can keep since the result is the same on every run
+    for (int i = 0; i < part_count; i++) {
+        _JechOptimizer_Run(parts[i]);
+    }
+    Bytecode bytecode = _JechBytecode_CompileParts(parts, part_count);
     
     // Execute
     _JechVM_Execute(&bytecode);
+    _JechBytecode_Free(&bytecode);
     
-    // Cleanup
-    for (int i = 0; i < ast_count; i++) {
-        _JechAST_Free(roots[i]);
-    }
+    // The nodes stay with the document for the next run
+    free(parts);
     
     return output_buffer;
 }
@@ -1,17 +1,27 @@
 #include "test_framework.h"
 #include "core/pipeline.h"
 #include "core/vm.h"
+#include "core/cache.h"
+#include "core/image.h"
+#include "core/lines.h"
+#include "utils/read_file.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
-static char *capture_pipeline_output(const char *source)
+static char *capture_output_of(const char *source, int cached)
 {
     FILE *original_stdout = stdout;
     char *buffer = malloc(2048);
     FILE *stream = fmemopen(buffer, 2048, "w");
     stdout = stream;
     
-    run_pipeline(source);
+    if (cached)
+        run_cached_pipeline(source, strlen(source));
+    else
+        run_pipeline(source);
     
     fflush(stream);
     fclose(stream);
@@ -20,6 +30,11 @@ static char *capture_pipeline_output(const char *source)
     return buffer;
 }
 
+static char *capture_pipeline_output(const char *source)
+{
+    return capture_output_of(source, 0);
+}
+
 TEST(test_integration_hello_world)
 {
     _JechVM_ClearState();
@@ -83,6 +98,303 @@ TEST(test_integration_reassignment)
     free(output);
 }
 
+TEST(test_integration_long_names_and_literals)
+{
+    _JechVM_ClearState();
+    char name[301];
+    char literal[301];
+    memset(name, 'v', 300);
+    name[300] = '\0';
+    memset(literal, 'x', 300);
+    literal[300] = '\0';
+
+    char source[1024];
+    snprintf(source, sizeof(source), "keep %s = 1; say(%s); say(\"%s\");", name, name, literal);
+    char expected[512];
+    snprintf(expected, sizeof(expected), "1\n%s\n", literal);
+
+    char *output = capture_pipeline_output(source);
+    ASSERT_STR_EQ(output, expected, "Names and literals should not be cut short");
+    free(output);
+}
+
+TEST(test_integration_expressions)
+{
+    _JechVM_ClearState();
+    const char *source =
+        "keep a = 2; keep b = 3; keep c = 4;"
+        "keep r = a * b + c; say(r);"
+        "say((a + b) * c);"
+        "r = r - a * (b - 1); say(r);"
+        "say(\"x\" + \"y\" + \"z\");"
+        "when (a * 2 > b) { say(\"big\"); } else { say(\"small\"); }";
+    char *output = capture_pipeline_output(source);
+    ASSERT_STR_EQ(output, "10.00\n20.00\n6.00\nxyz\nbig\n", "Should evaluate nested expressions");
+    free(output);
+}
+
+TEST(test_integration_constant_folding)
+{
+    // Folded code must print what the unfolded code would
+    _JechVM_ClearState();
+    const char *source =
+        "keep a = 2; say(2 + 3 * 4); say(\"n=\" + 1 + 2); say(a * (1 + 2));"
+        "when (2 > 1) { say(\"big\"); } else { say(\"small\"); }"
+        "when (false) { say(\"never\"); }";
+    char *output = capture_pipeline_output(source);
+    ASSERT_STR_EQ(output, "14.00\nn=12\n6.00\nbig\n", "Folded statements should behave as before");
+    free(output);
+}
+
+TEST(test_integration_lazy_function_bodies)
+{
+    // Bodies compile on their first call; `unused` is never compiled
+    _JechVM_ClearState();
+    const char *source =
+        "do unused(x) { say(x); }"
+        "do twice(x) { keep y = x * 2; return y; }"
+        "keep a = twice(3); say(a);"
+        "keep b = twice(a); say(b);";
+    char *output = capture_pipeline_output(source);
+    ASSERT_STR_EQ(output, "6.00\n12.00\n", "Lazy bodies should run like eager ones");
+    free(output);
+}
+
+TEST(test_integration_large_function_library)
+{
+    // A library of helpers is far larger than the VM's first table
+    _JechVM_ClearState();
+    int functions = 500;
+    char *source = malloc(functions * 48 + 64);
+    char *cursor = source;
+    for (int i = 0; i < functions; i++)
+        cursor += sprintf(cursor, "do f%d(x) { return x + %d; }", i, i);
+    strcpy(cursor, "keep a = f0(1); say(a); keep b = f499(1); say(b);");
+
+    char *output = capture_pipeline_output(source);
+    ASSERT_STR_EQ(output, "1.00\n500.00\n", "Every declared function should be callable");
+    free(output);
+    free(source);
+}
+
+TEST(test_integration_mapped_source_file)
+{
+    // 4096 bytes: a page-sized file must still come back NUL-terminated
+    char path[] = "/tmp/jech_mapped_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "Should create a temporary file");
+    FILE *file = fdopen(fd, "w");
+    const char *program = "say(\"mapped\");";
+    size_t padding = 4096 - strlen(program);
+    for (size_t i = 0; i < padding; i++)
+        fputc(' ', file);
+    fputs(program, file);
+    fclose(file);
+
+    _JechVM_ClearState();
+    JechSourceFile source = load_source_file(path);
+    ASSERT_EQ((int)source.length, 4096, "Whole file should be loaded");
+    ASSERT_EQ(source.data[source.length], '\0', "Source should be NUL-terminated");
+
+    char *output = capture_pipeline_output(source.data);
+    ASSERT_STR_EQ(output, "mapped\n", "Mapped source should run");
+    free(output);
+
+    unmap_file_content(&source);
+    remove(path);
+}
+
+TEST(test_integration_bytecode_cache)
+{
+    char dir[] = "/tmp/jech_cache_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL, "Should create a cache directory");
+    setenv("JECH_CACHE_DIR", dir, 1);
+
+    const char *source =
+        "do unused(x) { say(x); }"
+        "do twice(x) { keep y = x * 2; return y; }"
+        "keep a = twice(3); say(a); say(\"cached\");";
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%016llx.jcb", dir,
+             (unsigned long long)_JechImage_Hash(source, strlen(source)));
+
+    _JechVM_ClearState();
+    char *output = capture_output_of(source, 1);
+    ASSERT_STR_EQ(output, "6.00\ncached\n", "First run should compile and execute");
+    free(output);
+    ASSERT(access(path, R_OK) == 0, "First run should write the image");
+
+    JechCacheEntry entry;
+    ASSERT(_JechCache_Load(source, strlen(source), &entry), "Image should load for the same text");
+    ASSERT(entry.bytecode.borrowed, "Loaded code should point into the mapped image");
+    _JechCache_Release(&entry);
+    ASSERT(!_JechCache_Load("say(1);", 7, &entry), "Other text should miss");
+
+    // A colliding hash must not run another program: plant this text's
+    // image under the name of another text of the same length
+    char other_path[256];
+    const char *other = "say(2);";
+    snprintf(other_path, sizeof(other_path), "%s/%016llx.jcb", dir,
+             (unsigned long long)_JechImage_Hash(other, strlen(other)));
+    _JechVM_ClearState();
+    output = capture_output_of("say(1);", 1);
+    free(output);
+    char one_path[256];
+    snprintf(one_path, sizeof(one_path), "%s/%016llx.jcb", dir,
+             (unsigned long long)_JechImage_Hash("say(1);", 7));
+    ASSERT(rename(one_path, other_path) == 0, "Should plant the image");
+    ASSERT(!_JechCache_Load(other, strlen(other), &entry), "An image of other text should miss");
+    remove(other_path);
+
+    _JechVM_ClearState();
+    output = capture_output_of(source, 1);
+    ASSERT_STR_EQ(output, "6.00\ncached\n", "Cached run should behave the same");
+    free(output);
+
+    remove(path);
+    rmdir(dir);
+    unsetenv("JECH_CACHE_DIR");
+}
+
+TEST(test_integration_standalone_image)
+{
+    char path[] = "/tmp/jech_image_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "Should create a temporary file");
+    close(fd);
+
+    const char *source = "do twice(x) { keep y = x * 2; return y; } keep a = twice(4); say(a);";
+    ASSERT(compile_pipeline(source, strlen(source), path), "Program should compile to an image");
+
+    JechSourceFile image;
+    ASSERT(map_file_content(path, &image), "Image should be readable");
+    Bytecode bc;
+    ASSERT(_JechImage_Load(image.data, image.length, NULL, 0, &bc), "Image should load without its source");
+    ASSERT(bc.source == NULL && bc.function_count == 1, "Bodies should be compiled into the image");
+
+    _JechVM_ClearState();
+    FILE *original_stdout = stdout;
+    char buffer[64];
+    FILE *stream = fmemopen(buffer, sizeof(buffer), "w");
+    stdout = stream;
+    _JechVM_Execute(&bc);
+    fflush(stream);
+    fclose(stream);
+    stdout = original_stdout;
+    ASSERT_STR_EQ(buffer, "8.00\n", "Image should run without the compiler");
+
+    _JechBytecode_Free(&bc);
+    unmap_file_content(&image);
+    _JechLines_SetSource(NULL);
+    remove(path);
+}
+
+TEST(test_integration_corrupt_image_rejected)
+{
+    char path[] = "/tmp/jech_image_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "Should create a temporary file");
+    close(fd);
+
+    const char *source = "do twice(x) { keep y = x * 2; return y; } keep a = twice(4); say(a + 1);";
+    ASSERT(compile_pipeline(source, strlen(source), path), "Program should compile to an image");
+    JechSourceFile image;
+    ASSERT(map_file_content(path, &image), "Image should be readable");
+
+    // Copies sized exactly, so a read past the end is a real overrun
+    int truncated_loads = 0;
+    for (size_t length = 0; length < image.length; length++)
+    {
+        char *copy = malloc(length + 1);
+        memcpy(copy, image.data, length);
+        Bytecode bc;
+        if (_JechImage_Load(copy, length, NULL, 0, &bc))
+        {
+            truncated_loads++;
+            _JechBytecode_Free(&bc);
+        }
+        free(copy);
+    }
+    ASSERT_EQ(truncated_loads, 0, "Truncated images should be rejected");
+
+    // Single corrupted bytes: loading may succeed when only a constant's
+    // text changes, but must never read outside the image
+    int rejected = 0;
+    char *copy = malloc(image.length);
+    for (size_t i = sizeof(JechImageHeader); i < image.length; i++)
+    {
+        memcpy(copy, image.data, image.length);
+        copy[i] ^= 0xFF;
+        Bytecode bc;
+        if (_JechImage_Load(copy, image.length, NULL, 0, &bc))
+            _JechBytecode_Free(&bc);
+        else
+            rejected++;
+    }
+    free(copy);
+    ASSERT(rejected > 0, "Corrupted operands should be rejected");
+
+    unmap_file_content(&image);
+    _JechLines_SetSource(NULL);
+    remove(path);
+}
+
+/**
+ * Runs build/jech-run on `path` and returns its exit status; a crash shows
+ * up as the shell's 128 + signal
+ */
+static int run_image_file(const char *path)
+{
+    char command[256];
+    snprintf(command, sizeof(command), "./build/jech-run %s >/dev/null 2>&1", path);
+    int status = system(command);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void write_bytes(const char *path, const char *data, size_t length)
+{
+    FILE *file = fopen(path, "wb");
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+TEST(test_integration_runtime_rejects_bad_image)
+{
+    ASSERT(access("build/jech-run", X_OK) == 0, "build/jech-run should be built");
+
+    char path[] = "/tmp/jech_image_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "Should create a temporary file");
+    close(fd);
+
+    const char *source = "do twice(x) { keep y = x * 2; return y; } keep a = twice(4); say(a);";
+    ASSERT(compile_pipeline(source, strlen(source), path), "Program should compile to an image");
+    ASSERT_EQ(run_image_file(path), 0, "An intact image should run");
+
+    JechSourceFile image;
+    ASSERT(map_file_content(path, &image), "Image should be readable");
+    char *copy = malloc(image.length);
+    memcpy(copy, image.data, image.length);
+    size_t length = image.length;
+    unmap_file_content(&image);
+
+    write_bytes(path, copy, length / 2);
+    ASSERT_EQ(run_image_file(path), 1, "A truncated image should fail cleanly");
+
+    // The image ends with the body's OP_END and its padding; the byte
+    // before it is the last operand of the body's final instruction
+    size_t end = length;
+    while (end > 0 && copy[end - 1] == 0)
+        end--;
+    ASSERT(end >= 2 && copy[end - 1] == OP_END, "Image should end with OP_END");
+    copy[end - 2] = 0x7F;
+    write_bytes(path, copy, length);
+    ASSERT_EQ(run_image_file(path), 1, "An image with a bad operand should fail cleanly");
+
+    free(copy);
+    remove(path);
+}
+
 int run_integration_tests()
 {
     TEST_SUITE_BEGIN("Integration Tests (End-to-End)");
@@ -94,6 +406,16 @@ int run_integration_tests()
     RUN_TEST(test_integration_empty_array);
     RUN_TEST(test_integration_variable_and_array_together);
     RUN_TEST(test_integration_reassignment);
+    RUN_TEST(test_integration_long_names_and_literals);
+    RUN_TEST(test_integration_expressions);
+    RUN_TEST(test_integration_constant_folding);
+    RUN_TEST(test_integration_lazy_function_bodies);
+    RUN_TEST(test_integration_large_function_library);
+    RUN_TEST(test_integration_mapped_source_file);
+    RUN_TEST(test_integration_bytecode_cache);
+    RUN_TEST(test_integration_standalone_image);
+    RUN_TEST(test_integration_corrupt_image_rejected);
+    RUN_TEST(test_integration_runtime_rejects_bad_image);
     
     TEST_SUITE_END();
 }
@@ -1,21 +1,24 @@
 #include "test_framework.h"
 #include "core/tokenizer.h"
 #include "core/parser/parser.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
+#include "core/document.h"
+#include "core/optimizer.h"
 
 TEST(test_parser_say_statement)
 {
     const char *source = "say(\"Hello\");";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 1, "Should parse 1 statement");
-    ASSERT_EQ(roots[0]->type, JECH_AST_SAY, "Should be SAY node");
-    ASSERT_STR_EQ(roots[0]->value, "Hello", "Value should be 'Hello'");
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 statement");
+    ASSERT_EQ(ast.type[ast.roots[0]], JECH_AST_SAY, "Should be SAY node");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.roots[0]), "Hello", "Value should be 'Hello'");
     
-    _JechAST_Free(roots[0]);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_parser_keep_statement)
@@ -23,15 +26,16 @@ TEST(test_parser_keep_statement)
     const char *source = "keep x = 42;";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 1, "Should parse 1 statement");
-    ASSERT_EQ(roots[0]->type, JECH_AST_KEEP, "Should be KEEP node");
-    ASSERT_STR_EQ(roots[0]->name, "x", "Variable name should be 'x'");
-    ASSERT_STR_EQ(roots[0]->value, "42", "Value should be '42'");
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 statement");
+    ASSERT_EQ(ast.type[ast.roots[0]], JECH_AST_KEEP, "Should be KEEP node");
+    ASSERT_STR_EQ(_JechFlatAST_Name(&ast, ast.roots[0]), "x", "Variable name should be 'x'");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.roots[0]), "42", "Value should be '42'");
     
-    _JechAST_Free(roots[0]);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_parser_array_literal)
@@ -39,16 +43,18 @@ TEST(test_parser_array_literal)
     const char *source = "keep arr = [1, 2, 3];";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 1, "Should parse 1 statement");
-    ASSERT_EQ(roots[0]->type, JECH_AST_KEEP, "Should be KEEP node");
-    ASSERT_STR_EQ(roots[0]->name, "arr", "Variable name should be 'arr'");
-    ASSERT(roots[0]->left != NULL, "Should have array literal child");
-    ASSERT_EQ(roots[0]->left->type, JECH_AST_ARRAY_LITERAL, "Child should be ARRAY_LITERAL");
+    JechNodeId keep = ast.roots[0];
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 statement");
+    ASSERT_EQ(ast.type[keep], JECH_AST_KEEP, "Should be KEEP node");
+    ASSERT_STR_EQ(_JechFlatAST_Name(&ast, keep), "arr", "Variable name should be 'arr'");
+    ASSERT(ast.left[keep] != JECH_NO_NODE, "Should have array literal child");
+    ASSERT_EQ(ast.type[ast.left[keep]], JECH_AST_ARRAY_LITERAL, "Child should be ARRAY_LITERAL");
     
-    _JechAST_Free(roots[0]);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_parser_array_indexing)
@@ -56,16 +62,18 @@ TEST(test_parser_array_indexing)
     const char *source = "say(arr[0]);";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 1, "Should parse 1 statement");
-    ASSERT_EQ(roots[0]->type, JECH_AST_SAY_INDEX, "Should be SAY_INDEX node");
-    ASSERT_STR_EQ(roots[0]->value, "arr", "Array name should be 'arr'");
-    ASSERT(roots[0]->left != NULL, "Should have index child");
-    ASSERT_STR_EQ(roots[0]->left->value, "0", "Index should be '0'");
+    JechNodeId say = ast.roots[0];
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 statement");
+    ASSERT_EQ(ast.type[say], JECH_AST_SAY_INDEX, "Should be SAY_INDEX node");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, say), "arr", "Array name should be 'arr'");
+    ASSERT(ast.left[say] != JECH_NO_NODE, "Should have index child");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.left[say]), "0", "Index should be '0'");
     
-    _JechAST_Free(roots[0]);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_parser_assignment)
@@ -73,15 +81,44 @@ TEST(test_parser_assignment)
     const char *source = "x = 100;";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 1, "Should parse 1 statement");
-    ASSERT_EQ(roots[0]->type, JECH_AST_ASSIGN, "Should be ASSIGN node");
-    ASSERT_STR_EQ(roots[0]->name, "x", "Variable name should be 'x'");
-    ASSERT_STR_EQ(roots[0]->value, "100", "Value should be '100'");
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 statement");
+    ASSERT_EQ(ast.type[ast.roots[0]], JECH_AST_ASSIGN, "Should be ASSIGN node");
+    ASSERT_STR_EQ(_JechFlatAST_Name(&ast, ast.roots[0]), "x", "Variable name should be 'x'");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.roots[0]), "100", "Value should be '100'");
     
-    _JechAST_Free(roots[0]);
+    _JechFlatAST_Free(&ast);
+}
+
+TEST(test_parser_expression_precedence)
+{
+    const char *source = "keep r = a + b * (c - 1); when (a * 2 > b) { say(a); }";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+
+    ASSERT_EQ(ast.root_count, 2, "Should parse 2 statements");
+
+    // a + (b * (c - 1))
+    JechNodeId sum = ast.left[ast.roots[0]];
+    ASSERT(sum != JECH_NO_NODE && ast.type[sum] == JECH_AST_BIN_OP, "Value should be an operator tree");
+    ASSERT_EQ(ast.op[sum], TOKEN_PLUS, "Root operator should be '+'");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.left[sum]), "a", "Left operand should be 'a'");
+    ASSERT_EQ(ast.op[ast.right[sum]], TOKEN_STAR, "'*' should bind tighter than '+'");
+    ASSERT_EQ(ast.op[ast.right[ast.right[sum]]], TOKEN_MINUS, "Parentheses should group 'c - 1'");
+
+    // (a * 2) > b
+    JechNodeId condition = ast.left[ast.roots[1]];
+    ASSERT_EQ(ast.op[condition], TOKEN_GT, "Comparison should bind loosest");
+    ASSERT_EQ(ast.op[ast.left[condition]], TOKEN_STAR, "Left of '>' should be 'a * 2'");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.right[condition]), "b", "Right of '>' should be 'b'");
+
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_parser_multiple_statements)
@@ -89,17 +126,416 @@ TEST(test_parser_multiple_statements)
     const char *source = "keep x = 10; say(x); x = 20;";
     JechTokenList tokens = _JechTokenizer_Lex(source);
     
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
     
-    ASSERT_EQ(count, 3, "Should parse 3 statements");
-    ASSERT_EQ(roots[0]->type, JECH_AST_KEEP, "First should be KEEP");
-    ASSERT_EQ(roots[1]->type, JECH_AST_SAY, "Second should be SAY");
-    ASSERT_EQ(roots[2]->type, JECH_AST_ASSIGN, "Third should be ASSIGN");
+    ASSERT_EQ(ast.root_count, 3, "Should parse 3 statements");
+    ASSERT_EQ(ast.type[ast.roots[0]], JECH_AST_KEEP, "First should be KEEP");
+    ASSERT_EQ(ast.type[ast.roots[1]], JECH_AST_SAY, "Second should be SAY");
+    ASSERT_EQ(ast.type[ast.roots[2]], JECH_AST_ASSIGN, "Third should be ASSIGN");
     
-    for (int i = 0; i < count; i++) {
-        _JechAST_Free(roots[i]);
+    _JechFlatAST_Free(&ast);
+}
+
+TEST(test_parser_stream_statements)
+{
+    const char *source = "do greet(name) { say(name); } keep x = 10; when (x > 5) { say(x); } else { say(\"no\"); } greet(\"A\");";
+    JechLexer lexer;
+    _JechTokenizer_Init(&lexer, source);
+
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseStream(&ast, &lexer);
+
+    const JechNodeId *roots = ast.roots;
+    ASSERT_EQ(ast.root_count, 4, "Should parse 4 statements from the stream");
+    ASSERT_EQ(ast.type[roots[0]], JECH_AST_FUNCTION_DECL, "First should be FUNCTION_DECL");
+    ASSERT_EQ(ast.type[roots[1]], JECH_AST_KEEP, "Second should be KEEP");
+    ASSERT_EQ(ast.type[roots[2]], JECH_AST_WHEN, "Third should be WHEN");
+    ASSERT(ast.extra[roots[2]] != JECH_NO_NODE, "WHEN should keep its else branch");
+    ASSERT_EQ(ast.type[roots[3]], JECH_AST_FUNCTION_CALL, "Fourth should be FUNCTION_CALL");
+
+    _JechFlatAST_Free(&ast);
+}
+
+TEST(test_parser_nested_function_bodies)
+{
+    // Bodies are parsed in place, so nesting depth costs no token copies
+    int depth = 2000;
+    const char *open = "do f(a) { ";
+    const char *inner = "x = a; ";
+    int open_length = (int)strlen(open);
+    int inner_length = (int)strlen(inner);
+    char *source = malloc(depth * (open_length + 2) + inner_length + 1);
+    char *p = source;
+    for (int i = 0; i < depth; i++, p += open_length)
+        memcpy(p, open, open_length);
+    memcpy(p, inner, inner_length);
+    p += inner_length;
+    for (int i = 0; i < depth; i++, p += 2)
+        memcpy(p, "} ", 2);
+    *p = '\0';
+
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    ASSERT_EQ(ast.root_count, 1, "Should parse 1 top-level declaration");
+
+    JechNodeId node = ast.roots[0];
+    int levels = 0;
+    int body_count = 0;
+    const JechNodeId *body;
+    while (ast.type[node] == JECH_AST_FUNCTION_DECL &&
+           (body = _JechFlatAST_Body(&ast, node, &body_count)) != NULL && body_count == 1)
+    {
+        node = body[0];
+        levels++;
+    }
+    ASSERT_EQ(levels, depth, "Every nested body should be parsed");
+    ASSERT_EQ(ast.type[node], JECH_AST_ASSIGN, "Innermost statement should be the assignment");
+    ASSERT_STR_EQ(_JechFlatAST_Name(&ast, node), "x", "Innermost assignment should target 'x'");
+
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+    free(source);
+}
+
+TEST(test_parser_lazy_function_bodies)
+{
+    const char *source = "do f(a) { say(a); return a; } say(1);";
+    int was_lazy = _JechParser_SetLazyBodies(1);
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    _JechParser_SetLazyBodies(was_lazy);
+    ASSERT_EQ(ast.root_count, 2, "Declaration and call site should both parse");
+    ASSERT(ast.flags[ast.roots[0]] & JECH_AST_LAZY, "Body should be left unparsed");
+
+    int offset = 0, length = 0, body_count = 0;
+    ASSERT(_JechFlatAST_LazyBody(&ast, ast.roots[0], &offset, &length), "Declaration should be lazy");
+    ASSERT(_JechFlatAST_Body(&ast, ast.roots[0], &body_count) == NULL, "Lazy body should have no nodes");
+    ASSERT(ast.source == source, "Lazy bodies should point into the program text");
+    ASSERT(length == 19 && strncmp(source + offset, " say(a); return a; ", length) == 0, "Span should cover the text between the braces");
+
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_parser_constant_folding)
+{
+    const char *source =
+        "say(2 + 3 * 4); keep s = \"a\" + \"b\"; x = a * (1 + 2);"
+        "when (1 > 2) { say(1); }"
+        "when (true) { say(\"t\"); } else { say(\"f\"); }"
+        "when (a > 1 + 1) { say(a); }"
+        "do f() { when (false) { say(1); } return 1 + 1; }";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    ASSERT_EQ(ast.root_count, 7, "Should parse 7 statements");
+
+    _JechOptimizer_Run(&ast);
+    const JechNodeId *roots = ast.roots;
+    ASSERT_EQ(ast.root_count, 6, "A 'when' that never runs should be dropped");
+    ASSERT(ast.left[roots[0]] == JECH_NO_NODE, "Literal arithmetic should fold away");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, roots[0]), "14.00", "Folded value should match the VM's result");
+    ASSERT_EQ(ast.token_type[roots[1]], TOKEN_STRING, "Concatenation should fold to a string");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, roots[1]), "ab", "Concatenation should be folded");
+    ASSERT_EQ(ast.type[ast.left[roots[2]]], JECH_AST_BIN_OP, "Expressions with variables should stay");
+    ASSERT_EQ(ast.type[ast.right[ast.left[roots[2]]]], JECH_AST_NUMBER_LITERAL, "Their constant operands should fold");
+    ASSERT_EQ(ast.type[roots[3]], JECH_AST_SAY, "A 'when (true)' should become its then branch");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, roots[3]), "t", "The then branch should be kept");
+    ASSERT_EQ(ast.type[ast.right[ast.left[roots[4]]]], JECH_AST_BIN_OP, "Operands of comparisons should not be folded");
+
+    int body_count = 0;
+    const JechNodeId *body = _JechFlatAST_Body(&ast, roots[5], &body_count);
+    ASSERT_EQ(body_count, 1, "Function bodies should be optimised too");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, body[0]), "2.00", "The body's return value should fold");
+
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_parser_nodes_are_appended)
+{
+    const char *source = "keep greeting = \"hello\"; say(greeting + \" world\");";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    ASSERT_EQ(ast.root_count, 2, "Should parse 2 statements");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.roots[0]), "hello", "String value should be kept");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.right[ast.left[ast.roots[1]]]), " world", "Operand should be kept");
+    ASSERT_EQ(ast.count, 5, "Each value, operator and statement should be one node");
+
+    // A second parse appends to the same columns
+    int count = ast.count;
+    _JechParser_ParseAll(&ast, &tokens);
+    ASSERT_EQ(ast.root_count, 4, "Roots should accumulate");
+    ASSERT_EQ(ast.count, 2 * count, "Nodes should accumulate");
+    ASSERT(ast.roots[2] >= (JechNodeId)count, "New statements should use new nodes");
+
+    _JechFlatAST_Free(&ast);
+    ASSERT(ast.count == 0 && ast.roots == NULL, "Free should release every node at once");
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_parser_flat_ast_layout)
+{
+    const char *source = "keep r = a + b * 2; do f(x) { say(x); return x; } when (r > 1) { say(r); } else { say(0); }";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+
+    ASSERT_EQ(ast.root_count, 3, "Should keep 3 roots");
+
+    // Built bottom-up: a, b, 2, *, +, keep
+    JechNodeId keep = ast.roots[0];
+    ASSERT_EQ(keep, 5, "The statement should follow its value");
+    ASSERT_EQ(ast.type[keep], JECH_AST_KEEP, "Node 5 should be KEEP");
+    JechNodeId sum = ast.left[keep];
+    ASSERT_EQ(ast.op[sum], TOKEN_PLUS, "KEEP value should be '+'");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.left[sum]), "a", "Left of '+' should be 'a'");
+    ASSERT_EQ(ast.op[ast.right[sum]], TOKEN_STAR, "Right of '+' should be '*'");
+    ASSERT_EQ((int)_JechFlatAST_Number(&ast, 2).as.i, 2, "Number literal should be decoded");
+    ASSERT_EQ(ast.offset[keep], 0, "Statements should record their source offset");
+
+    for (int i = 0; i < ast.count; i++)
+    {
+        ASSERT(ast.left[i] == JECH_NO_NODE || ast.left[i] < (JechNodeId)i, "Values should precede the nodes using them");
+        ASSERT(ast.extra[i] == JECH_NO_NODE || ast.type[i] == JECH_AST_FUNCTION_DECL || ast.extra[i] < (JechNodeId)i, "Else branches should precede their WHEN");
     }
+
+    int body_count = 0;
+    const JechNodeId *body = _JechFlatAST_Body(&ast, ast.roots[1], &body_count);
+    ASSERT_EQ(body_count, 2, "Function body should hold 2 statements");
+    ASSERT_EQ(ast.type[body[0]], JECH_AST_SAY, "Body should start with SAY");
+    ASSERT_EQ(ast.type[body[1]], JECH_AST_RETURN, "Body should end with RETURN");
+
+    JechNodeId when = ast.roots[2];
+    ASSERT_EQ(ast.type[when], JECH_AST_WHEN, "Third root should be WHEN");
+    ASSERT_STR_EQ(_JechFlatAST_Value(&ast, ast.extra[when]), "0", "WHEN should keep its else branch");
+
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_parser_many_top_level_statements)
+{
+    // Far beyond the old fixed limit of 128 roots
+    int statements = 100000;
+    const char *line = "x = x + 1;\n";
+    int line_length = (int)strlen(line);
+    char *source = malloc(statements * line_length + 1);
+    for (int i = 0; i < statements; i++)
+        memcpy(source + i * line_length, line, line_length);
+    source[statements * line_length] = '\0';
+
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    ASSERT_EQ(ast.root_count, statements, "Every statement should be parsed");
+    ASSERT_EQ(ast.type[ast.roots[statements - 1]], JECH_AST_ASSIGN, "Last statement should be parsed intact");
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+
+    JechLexer lexer;
+    _JechTokenizer_Init(&lexer, source);
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseStream(&ast, &lexer);
+    ASSERT_EQ(ast.root_count, statements, "Every streamed statement should be parsed");
+    _JechFlatAST_Free(&ast);
+
+    free(source);
+}
+
+/**
+ * Checks that an edited document matches one built from scratch
+ */
+static int document_matches_fresh(const JechDocument *doc)
+{
+    JechDocument fresh;
+    _JechDocument_Init(&fresh, doc->text);
+
+    int same = doc->tokens.count == fresh.tokens.count &&
+               doc->statement_count == fresh.statement_count;
+    for (int i = 0; same && i < doc->tokens.count; i++)
+    {
+        const JechToken *a = &doc->tokens.tokens[i];
+        const JechToken *b = &fresh.tokens.tokens[i];
+        same = a->type == b->type && a->length == b->length &&
+               a->start - doc->text == b->start - fresh.text &&
+               a->offset == b->offset;
+    }
+    for (int i = 0; same && i < doc->statement_count; i++)
+    {
+        const JechDocStatement *a = &doc->statements[i];
+        const JechDocStatement *b = &fresh.statements[i];
+        same = a->first_token == b->first_token && a->token_count == b->token_count &&
+               a->ast.root_count == b->ast.root_count && a->ok == b->ok &&
+               a->diagnostics.count == b->diagnostics.count;
+        for (int j = 0; same && j < a->ast.root_count; j++)
+            same = a->ast.type[a->ast.roots[j]] == b->ast.type[b->ast.roots[j]] &&
+                   a->ast.value[a->ast.roots[j]] == b->ast.value[b->ast.roots[j]];
+    }
+
+    _JechDocument_Free(&fresh);
+    return same;
+}
+
+TEST(test_parser_document_edits)
+{
+    JechDocument doc;
+    ASSERT(_JechDocument_Init(&doc, "keep x = 10; say(x); when (x > 5) { say(x); }"), "Document should load");
+    ASSERT_EQ(doc.statement_count, 3, "Should start with 3 statements");
+
+    // Change a literal in place
+    ASSERT(_JechDocument_Edit(&doc, 9, 2, "42", 2), "Edit should apply");
+    ASSERT_STR_EQ(doc.text, "keep x = 42; say(x); when (x > 5) { say(x); }", "Text should be spliced");
+    ASSERT(document_matches_fresh(&doc), "Literal edit should match a full re-parse");
+    ASSERT_EQ(doc.reparsed_statements, 1, "Only the edited statement should be re-parsed");
+
+    // Split one statement into two
+    ASSERT(_JechDocument_Edit(&doc, 12, 0, " keep y = 1;", 12), "Insertion should apply");
+    ASSERT(document_matches_fresh(&doc), "Insertion should match a full re-parse");
+    ASSERT_EQ(doc.statement_count, 4, "Inserted statement should be added");
+
+    // Delete a ';' so two statements merge into one window
+    ASSERT(_JechDocument_Edit(&doc, 23, 1, "", 0), "Deletion should apply");
+    ASSERT(document_matches_fresh(&doc), "Deletion should match a full re-parse");
+
+    // Add an else branch to the block
+    ASSERT(_JechDocument_Edit(&doc, doc.length, 0, " else { say(0); }", 17), "Append should apply");
+    ASSERT(document_matches_fresh(&doc), "Else branch should match a full re-parse");
+
+    // Comment out the start of the program, then uncomment it
+    ASSERT(_JechDocument_Edit(&doc, 0, 0, "# ", 2), "Comment should apply");
+    ASSERT(document_matches_fresh(&doc), "Commenting should match a full re-parse");
+    ASSERT(_JechDocument_Edit(&doc, 0, 2, "", 0), "Uncomment should apply");
+    ASSERT(document_matches_fresh(&doc), "Uncommenting should match a full re-parse");
+
+    ASSERT(!_JechDocument_Edit(&doc, doc.length, 1, "", 0), "Out-of-range edit should be rejected");
+
+    _JechDocument_Free(&doc);
+}
+
+TEST(test_parser_document_edit_is_local)
+{
+    int statements = 5000;
+    const char *line = "keep v = 1;\n";
+    int line_length = (int)strlen(line);
+    char *source = malloc(statements * line_length + 1);
+    for (int i = 0; i < statements; i++)
+        memcpy(source + i * line_length, line, line_length);
+    source[statements * line_length] = '\0';
+
+    JechDocument doc;
+    ASSERT(_JechDocument_Init(&doc, source), "Document should load");
+    ASSERT_EQ(doc.statement_count, statements, "Every statement should be parsed");
+
+    int offset = (statements / 2) * line_length + 9;
+    ASSERT(_JechDocument_Edit(&doc, offset, 1, "2345", 4), "Edit should apply");
+    ASSERT(doc.relexed_tokens <= 3, "Only tokens around the edit should be re-lexed");
+    ASSERT_EQ(doc.reparsed_statements, 1, "Only one statement should be re-parsed");
+    const JechFlatAST *edited = &doc.statements[statements / 2].ast;
+    ASSERT_STR_EQ(_JechFlatAST_Value(edited, edited->roots[0]), "2345", "Edited statement should be updated");
+    ASSERT(document_matches_fresh(&doc), "Edit should match a full re-parse");
+
+    int count = 0;
+    int failed = 0;
+    JechFlatAST **parts = _JechDocument_Parts(&doc, &count, &failed);
+    ASSERT_EQ(count, statements, "Parts should cover every statement");
+    ASSERT(!failed, "No statement should fail");
+    ASSERT(parts[statements / 2] == edited, "Parts should be the statements' own ASTs");
+    free(parts);
+
+    _JechDocument_Free(&doc);
+    free(source);
+}
+
+/**
+ * Runs _JechDocument_Report and returns what it printed
+ */
+static char *document_report(const JechDocument *doc)
+{
+    FILE *original_stderr = stderr;
+    char *buffer = calloc(1, 1024);
+    FILE *stream = fmemopen(buffer, 1024, "w");
+    stderr = stream;
+
+    _JechDocument_Report(doc);
+
+    fflush(stream);
+    fclose(stream);
+    stderr = original_stderr;
+    return buffer;
+}
+
+TEST(test_parser_document_errors)
+{
+    JechDocument doc;
+    ASSERT(_JechDocument_Init(&doc, "keep x = 1;\nsay(x;\nkeep y = 2;"), "Document should load");
+
+    int count = 0;
+    int failed = 0;
+    JechFlatAST **parts = _JechDocument_Parts(&doc, &count, &failed);
+    ASSERT(failed, "The broken statement should be reported as failed");
+    ASSERT_EQ(count, 1, "Parts should stop before the broken statement");
+    free(parts);
+
+    char *first = document_report(&doc);
+    ASSERT(strstr(first, "line 2") != NULL, "The error should be reported");
+    char *again = document_report(&doc);
+    ASSERT_STR_EQ(again, first, "The error should be reported on every run");
+
+    // An edit above moves the broken statement without re-parsing it
+    ASSERT(_JechDocument_Edit(&doc, 0, 0, "keep a = 0;\n", 12), "Edit should apply");
+    ASSERT(!doc.statements[2].ok, "The broken statement should still fail");
+    char *moved = document_report(&doc);
+    ASSERT(strstr(moved, "line 3") != NULL, "The error should follow its statement");
+
+    // Fixing it clears the error
+    ASSERT(_JechDocument_Edit(&doc, 29, 0, ")", 1), "Fix should apply");
+    parts = _JechDocument_Parts(&doc, &count, &failed);
+    ASSERT(!failed, "The fixed statement should parse");
+    ASSERT_EQ(count, 4, "Every statement should be a part");
+    free(parts);
+    char *fixed = document_report(&doc);
+    ASSERT_STR_EQ(fixed, "", "Nothing should be reported once fixed");
+
+    free(first);
+    free(again);
+    free(moved);
+    free(fixed);
+    _JechDocument_Free(&doc);
+}
+
+TEST(test_parser_literals_are_not_interned)
+{
+    JechDocument doc;
+    ASSERT(_JechDocument_Init(&doc, "keep s = \"a\"; say(s + 1.5);"), "Document should load");
+
+    // Each edit brings new literal text; only the name `s` is a symbol
+    int symbols = _JechSymbol_Count();
+    char text[32];
+    int replaced = 3;
+    for (int i = 0; i < 100; i++)
+    {
+        int length = snprintf(text, sizeof(text), "\"literal %d\"", i);
+        ASSERT(_JechDocument_Edit(&doc, 9, replaced, text, length), "Edit should apply");
+        replaced = length;
+    }
+    const JechFlatAST *edited = &doc.statements[0].ast;
+    ASSERT_STR_EQ(_JechFlatAST_Value(edited, edited->roots[0]), "literal 99", "Last edit should be kept");
+    ASSERT_EQ(_JechSymbol_Count(), symbols, "String literals should not be interned");
+
+    _JechDocument_Free(&doc);
 }
 
 int run_parser_tests()
@@ -111,7 +547,19 @@ int run_parser_tests()
     RUN_TEST(test_parser_array_literal);
     RUN_TEST(test_parser_array_indexing);
     RUN_TEST(test_parser_assignment);
+    RUN_TEST(test_parser_expression_precedence);
     RUN_TEST(test_parser_multiple_statements);
+    RUN_TEST(test_parser_stream_statements);
+    RUN_TEST(test_parser_nested_function_bodies);
+    RUN_TEST(test_parser_lazy_function_bodies);
+    RUN_TEST(test_parser_constant_folding);
+    RUN_TEST(test_parser_nodes_are_appended);
+    RUN_TEST(test_parser_flat_ast_layout);
+    RUN_TEST(test_parser_many_top_level_statements);
+    RUN_TEST(test_parser_document_edits);
+    RUN_TEST(test_parser_document_edit_is_local);
+    RUN_TEST(test_parser_document_errors);
+    RUN_TEST(test_parser_literals_are_not_interned);
     
     TEST_SUITE_END();
 }
@@ -1,5 +1,7 @@
 #include "test_framework.h"
 #include "core/tokenizer.h"
+#include "core/scan.h"
+#include "core/lines.h"
 
 TEST(test_tokenizer_say_string)
 {
@@ -10,7 +12,7 @@ TEST(test_tokenizer_say_string)
     ASSERT_EQ(list.tokens[0].type, TOKEN_SAY, "First token should be SAY");
     ASSERT_EQ(list.tokens[1].type, TOKEN_LPAREN, "Second token should be LPAREN");
     ASSERT_EQ(list.tokens[2].type, TOKEN_STRING, "Third token should be STRING");
-    ASSERT_STR_EQ(list.tokens[2].value, "Hello", "String value should be 'Hello'");
+    ASSERT(_JechToken_Equals(&list.tokens[2], "Hello"), "String value should be 'Hello'");
     ASSERT_EQ(list.tokens[3].type, TOKEN_RPAREN, "Fourth token should be RPAREN");
     ASSERT_EQ(list.tokens[4].type, TOKEN_SEMICOLON, "Fifth token should be SEMICOLON");
 }
@@ -23,10 +25,10 @@ TEST(test_tokenizer_keep_number)
     ASSERT_EQ(list.count, 6, "Token count should be 6");
     ASSERT_EQ(list.tokens[0].type, TOKEN_KEEP, "First token should be KEEP");
     ASSERT_EQ(list.tokens[1].type, TOKEN_IDENTIFIER, "Second token should be IDENTIFIER");
-    ASSERT_STR_EQ(list.tokens[1].value, "x", "Identifier should be 'x'");
+    ASSERT(_JechToken_Equals(&list.tokens[1], "x"), "Identifier should be 'x'");
     ASSERT_EQ(list.tokens[2].type, TOKEN_EQUAL, "Third token should be EQUAL");
     ASSERT_EQ(list.tokens[3].type, TOKEN_NUMBER, "Fourth token should be NUMBER");
-    ASSERT_STR_EQ(list.tokens[3].value, "42", "Number should be '42'");
+    ASSERT(_JechToken_Equals(&list.tokens[3], "42"), "Number should be '42'");
 }
 
 TEST(test_tokenizer_array_literal)
@@ -49,10 +51,10 @@ TEST(test_tokenizer_array_indexing)
     JechTokenList list = _JechTokenizer_Lex(source);
 
     ASSERT_EQ(list.tokens[0].type, TOKEN_IDENTIFIER, "First token should be IDENTIFIER");
-    ASSERT_STR_EQ(list.tokens[0].value, "arr", "Identifier should be 'arr'");
+    ASSERT(_JechToken_Equals(&list.tokens[0], "arr"), "Identifier should be 'arr'");
     ASSERT_EQ(list.tokens[1].type, TOKEN_LBRACKET, "Second token should be LBRACKET");
     ASSERT_EQ(list.tokens[2].type, TOKEN_NUMBER, "Third token should be NUMBER");
-    ASSERT_STR_EQ(list.tokens[2].value, "0", "Index should be '0'");
+    ASSERT(_JechToken_Equals(&list.tokens[2], "0"), "Index should be '0'");
     ASSERT_EQ(list.tokens[3].type, TOKEN_RBRACKET, "Fourth token should be RBRACKET");
 }
 
@@ -68,6 +70,285 @@ TEST(test_tokenizer_when_condition)
     ASSERT_EQ(list.tokens[4].type, TOKEN_NUMBER, "Fifth token should be NUMBER");
 }
 
+TEST(test_tokenizer_long_string_slice)
+{
+    char source[1024];
+    source[0] = '"';
+    memset(source + 1, 'a', 600);
+    strcpy(source + 601, "\";");
+    JechTokenList list = _JechTokenizer_Lex(source);
+
+    ASSERT_EQ(list.tokens[0].type, TOKEN_STRING, "First token should be STRING");
+    ASSERT_EQ(list.tokens[0].length, 600, "String slice should not be truncated");
+    ASSERT(list.tokens[0].start == source + 1, "String slice should point into the source");
+}
+
+TEST(test_tokenizer_no_token_cap)
+{
+    int statements = 1000;
+    char *source = malloc(statements * 6 + 1);
+    for (int i = 0; i < statements; i++) {
+        memcpy(source + i * 6, "x = 1;", 6);
+    }
+    source[statements * 6] = '\0';
+
+    JechTokenList list = _JechTokenizer_Lex(source);
+    int count = list.count;
+    JechTokenType last = list.tokens[list.count - 1].type;
+    _JechTokenizer_Free(&list);
+    free(source);
+
+    ASSERT_EQ(count, statements * 4 + 1, "All tokens should be kept past the old 2048 cap");
+    ASSERT_EQ(last, TOKEN_EOF, "Last token should be EOF");
+}
+
+TEST(test_tokenizer_streaming_next)
+{
+    JechLexer lexer;
+    _JechTokenizer_Init(&lexer, "keep x = 42;");
+
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_KEEP, "First token should be KEEP");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_IDENTIFIER, "Second token should be IDENTIFIER");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_EQUAL, "Third token should be EQUAL");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_NUMBER, "Fourth token should be NUMBER");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_SEMICOLON, "Fifth token should be SEMICOLON");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_EOF, "Sixth token should be EOF");
+    ASSERT_EQ(_JechTokenizer_Next(&lexer).type, TOKEN_EOF, "Lexer should keep returning EOF");
+}
+
+TEST(test_tokenizer_keywords_and_symbols)
+{
+    const char *source = "do done say sayx map keep when else true false return returns x x";
+    JechTokenList list = _JechTokenizer_Lex(source);
+
+    ASSERT_EQ(list.tokens[0].type, TOKEN_DO, "'do' should be a keyword");
+    ASSERT_EQ(list.tokens[1].type, TOKEN_IDENTIFIER, "'done' should be an identifier");
+    ASSERT_EQ(list.tokens[2].type, TOKEN_SAY, "'say' should be a keyword");
+    ASSERT_EQ(list.tokens[3].type, TOKEN_IDENTIFIER, "'sayx' should be an identifier");
+    ASSERT_EQ(list.tokens[4].type, TOKEN_MAP, "'map' should be a keyword");
+    ASSERT_EQ(list.tokens[5].type, TOKEN_KEEP, "'keep' should be a keyword");
+    ASSERT_EQ(list.tokens[6].type, TOKEN_WHEN, "'when' should be a keyword");
+    ASSERT_EQ(list.tokens[7].type, TOKEN_ELSE, "'else' should be a keyword");
+    ASSERT_EQ(list.tokens[8].type, TOKEN_BOOL, "'true' should be a boolean");
+    ASSERT_EQ(list.tokens[9].type, TOKEN_BOOL, "'false' should be a boolean");
+    ASSERT_EQ(list.tokens[10].type, TOKEN_RETURN, "'return' should be a keyword");
+    ASSERT_EQ(list.tokens[11].type, TOKEN_IDENTIFIER, "'returns' should be an identifier");
+
+    ASSERT(list.tokens[0].symbol == JECH_NO_SYMBOL, "Keywords should not carry a symbol");
+    ASSERT(list.tokens[12].symbol != JECH_NO_SYMBOL, "Identifiers should carry a symbol");
+    ASSERT_EQ(list.tokens[12].symbol, list.tokens[13].symbol, "Equal names should share a symbol");
+    ASSERT(list.tokens[1].symbol != list.tokens[12].symbol, "Different names should have different symbols");
+    ASSERT_STR_EQ(_JechSymbol_Name(list.tokens[12].symbol), "x", "Symbol name should round-trip");
+
+    _JechTokenizer_Free(&list);
+}
+
+TEST(test_tokenizer_scan_modes_agree)
+{
+    // Runs of whitespace, comments and strings crossing 16/32-byte blocks
+    const char *source =
+        "                                         \t\t\n\n   # a long comment that spans more than one vector block\n"
+        "keep s = \"a string literal long enough to cover several vector blocks\";\n"
+        "// another comment\n   say(s);";
+    JechScanMode modes[] = {JECH_SCAN_SCALAR, JECH_SCAN_SSE2, JECH_SCAN_AVX2};
+
+    _JechScan_SetMode(JECH_SCAN_SCALAR);
+    JechTokenList expected = _JechTokenizer_Lex(source);
+    ASSERT_EQ(expected.count, 11, "Token count should be 11");
+
+    for (int m = 1; m < 3; m++)
+    {
+        _JechScan_SetMode(modes[m]);
+        JechTokenList list = _JechTokenizer_Lex(source);
+        ASSERT_EQ(list.count, expected.count, "Every scanner should produce the same tokens");
+        for (int i = 0; i < list.count; i++)
+        {
+            ASSERT(list.tokens[i].start == expected.tokens[i].start, "Token slices should match");
+            ASSERT_EQ(list.tokens[i].length, expected.tokens[i].length, "Token lengths should match");
+            ASSERT_EQ(list.tokens[i].offset, expected.tokens[i].offset, "Token offsets should match");
+        }
+        _JechTokenizer_Free(&list);
+    }
+
+    _JechScan_SetMode(JECH_SCAN_AUTO);
+    _JechTokenizer_Free(&expected);
+}
+
+TEST(test_tokenizer_single_char_tokens)
+{
+    const char *source = "+-*/><()[]{},.;= ==";
+    JechTokenType expected[] = {
+        TOKEN_PLUS, TOKEN_MINUS, TOKEN_STAR, TOKEN_SLASH, TOKEN_GT, TOKEN_LT,
+        TOKEN_LPAREN, TOKEN_RPAREN, TOKEN_LBRACKET, TOKEN_RBRACKET,
+        TOKEN_LBRACE, TOKEN_RBRACE, TOKEN_COMMA, TOKEN_DOT, TOKEN_SEMICOLON,
+        TOKEN_EQUAL, TOKEN_EQEQ, TOKEN_EOF};
+    JechTokenList list = _JechTokenizer_Lex(source);
+
+    ASSERT_EQ(list.count, 18, "Token count should be 18");
+    for (int i = 0; i < list.count; i++)
+    {
+        ASSERT_EQ(list.tokens[i].type, expected[i], "Operator should map to its token type");
+    }
+    ASSERT_EQ(list.tokens[16].length, 2, "'==' should be a two-byte token");
+
+    _JechTokenizer_Free(&list);
+}
+
+TEST(test_tokenizer_non_ascii_is_not_a_letter)
+{
+    // Bytes >= 0x80 must never be classified as letters, whatever the locale
+    const char *source = "ab\xC3\xA9";
+    JechTokenList list = _JechTokenizer_Lex(source);
+
+    ASSERT_EQ(list.tokens[0].type, TOKEN_IDENTIFIER, "ASCII prefix should be an identifier");
+    ASSERT_EQ(list.tokens[0].length, 2, "Identifier should stop before non-ASCII bytes");
+    ASSERT_EQ(list.tokens[1].type, TOKEN_UNKNOWN, "Non-ASCII byte should be unknown");
+
+    _JechTokenizer_Free(&list);
+}
+
+TEST(test_tokenizer_number_values)
+{
+    const char *source = "42 3.5 1.2.3 9223372036854775807 99999999999999999999 7.";
+    JechTokenList list = _JechTokenizer_Lex(source);
+
+    ASSERT_EQ(list.tokens[0].type, TOKEN_NUMBER, "42 should be a number");
+    ASSERT_EQ(list.tokens[0].number.is_float, 0, "42 should be an integer");
+    ASSERT(list.tokens[0].number.as.i == 42, "42 should be decoded");
+
+    ASSERT_EQ(list.tokens[1].number.is_float, 1, "3.5 should be a float");
+    ASSERT(list.tokens[1].number.as.f == 3.5, "3.5 should be decoded");
+
+    // 1.2.3 is 1.2, '.', 3
+    ASSERT_EQ(list.tokens[2].type, TOKEN_NUMBER, "1.2 should be a number");
+    ASSERT_EQ(list.tokens[2].length, 3, "1.2 should stop at the second dot");
+    ASSERT_EQ(list.tokens[3].type, TOKEN_DOT, "Second dot should be its own token");
+    ASSERT_EQ(list.tokens[4].type, TOKEN_NUMBER, "3 should be a number");
+    ASSERT(list.tokens[4].number.as.i == 3, "3 should be decoded");
+
+    ASSERT_EQ(list.tokens[5].number.is_float, 0, "INT64_MAX should stay an integer");
+    ASSERT(list.tokens[5].number.as.i == INT64_MAX, "INT64_MAX should be exact");
+    ASSERT_EQ(list.tokens[6].number.is_float, 1, "Out-of-range integers should become doubles");
+    ASSERT(list.tokens[6].number.as.f > 9.9e19, "Out-of-range integer should keep its magnitude");
+
+    // A trailing '.' without digits is not part of the number
+    ASSERT_EQ(list.tokens[7].length, 1, "7. should lex the digits only");
+    ASSERT_EQ(list.tokens[8].type, TOKEN_DOT, "Trailing dot should be its own token");
+
+    _JechTokenizer_Free(&list);
+}
+
+TEST(test_tokenizer_parallel_matches_sequential)
+{
+    // Multi-line strings and quotes inside comments make some chunk
+    // boundaries fall inside strings, forcing the merge to re-lex
+    const char *unit =
+        "keep a = 12;  # a \"quote\" in a comment\n"
+        "say(\"first line\n  second line\n third\");\n"
+        "do f(x) { return x * 2.5; }\n"
+        "// comment with \" one quote\n"
+        "b = a + 1; say(\"\n\n\"); when (b > 3) { say(b); } else { say(a); }\n";
+    int unit_length = (int)strlen(unit);
+    int copies = 200;
+    char *source = malloc(unit_length * copies + 1);
+    ASSERT(source != NULL, "Source allocation should succeed");
+    for (int i = 0; i < copies; i++)
+        memcpy(source + i * unit_length, unit, unit_length);
+    source[unit_length * copies] = '\0';
+
+    JechTokenList expected = _JechTokenizer_Lex(source);
+    int chunk_counts[] = {1, 2, 7, 64, 500};
+    for (int c = 0; c < 5; c++)
+    {
+        JechTokenList list = _JechTokenizer_LexParallel(source, chunk_counts[c]);
+        ASSERT_EQ(list.count, expected.count, "Parallel lexing should produce the same number of tokens");
+        for (int i = 0; i < list.count; i++)
+        {
+            ASSERT_EQ(list.tokens[i].type, expected.tokens[i].type, "Token types should match");
+            ASSERT(list.tokens[i].start == expected.tokens[i].start, "Token slices should match");
+            ASSERT_EQ(list.tokens[i].length, expected.tokens[i].length, "Token lengths should match");
+            ASSERT_EQ(list.tokens[i].offset, expected.tokens[i].offset, "Token offsets should match");
+            ASSERT(list.tokens[i].symbol == expected.tokens[i].symbol, "Token symbols should match");
+        }
+        _JechTokenizer_Free(&list);
+    }
+
+    _JechTokenizer_Free(&expected);
+    free(source);
+}
+
+TEST(test_tokenizer_parallel_replay_matches_stream)
+{
+    // Large enough for the pipeline to lex it on the pool and replay it
+    const char *unit =
+        "keep a = 12;  # a \"quote\" in a comment\n"
+        "say(\"first line\n  second line\");\n"
+        "b = a + 1; when (b > 3) { say(b); } else { say(a); }\n";
+    int unit_length = (int)strlen(unit);
+    int copies = (2 * 1024 * 1024) / unit_length;
+    char *source = malloc(unit_length * copies + 1);
+    ASSERT(source != NULL, "Source allocation should succeed");
+    for (int i = 0; i < copies; i++)
+        memcpy(source + i * unit_length, unit, unit_length);
+    source[unit_length * copies] = '\0';
+
+    JechLexer stream, replay;
+    JechTokenList tokens;
+    _JechTokenizer_InitParallel(&replay, source, &tokens);
+    _JechTokenizer_Init(&stream, source);
+
+    int count = 0, mismatches = 0;
+    JechToken expected, token;
+    do
+    {
+        expected = _JechTokenizer_Next(&stream);
+        token = _JechTokenizer_Next(&replay);
+        if (token.type != expected.type || token.start != expected.start ||
+            token.length != expected.length || token.symbol != expected.symbol)
+            mismatches++;
+        count++;
+    } while (expected.type != TOKEN_EOF && token.type != TOKEN_EOF);
+
+    ASSERT_EQ(mismatches, 0, "Replayed tokens should match the streaming lexer's");
+    ASSERT(count > copies * 20, "Every token should be handed out");
+    ASSERT_EQ(_JechTokenizer_Next(&replay).type, TOKEN_EOF, "Replay should keep returning EOF");
+
+    _JechTokenizer_Free(&tokens);
+    free(source);
+}
+
+TEST(test_tokenizer_offsets_and_line_index)
+{
+    const char *source = "keep a = 1;\n\nsay(\"x\ny\");\n  b = a;";
+    JechTokenList list = _JechTokenizer_Lex(source);
+    JechLineIndex index;
+    ASSERT(_JechLineIndex_Build(&index, source), "Line index should build");
+    ASSERT_EQ(index.count, 5, "Source should have 5 lines");
+
+    int line, column;
+    ASSERT_EQ(list.tokens[1].offset, 5, "Identifier offset should be its byte offset");
+    _JechLineIndex_Locate(&index, list.tokens[1].offset, &line, &column);
+    ASSERT_EQ(line, 1, "'a' should be on line 1");
+    ASSERT_EQ(column, 6, "'a' should be in column 6");
+
+    // A string is located at its opening quote
+    ASSERT_EQ(list.tokens[7].type, TOKEN_STRING, "Token 7 should be the string");
+    _JechLineIndex_Locate(&index, list.tokens[7].offset, &line, &column);
+    ASSERT_EQ(line, 3, "String should start on line 3");
+    ASSERT_EQ(column, 5, "String should start at its quote");
+
+    // Tokens after a multi-line string
+    _JechLineIndex_Locate(&index, list.tokens[10].offset, &line, &column);
+    ASSERT_EQ(line, 5, "'b' should be on line 5");
+    ASSERT_EQ(column, 3, "'b' should be in column 3");
+
+    _JechLineIndex_Locate(&index, -1, &line, &column);
+    ASSERT_EQ(line, 0, "Offsets outside the text should not resolve");
+
+    _JechLineIndex_Free(&index);
+    _JechTokenizer_Free(&list);
+}
+
 int run_tokenizer_tests()
 {
     TEST_SUITE_BEGIN("Tokenizer Tests");
@@ -77,6 +358,17 @@ int run_tokenizer_tests()
     RUN_TEST(test_tokenizer_array_literal);
     RUN_TEST(test_tokenizer_array_indexing);
     RUN_TEST(test_tokenizer_when_condition);
+    RUN_TEST(test_tokenizer_long_string_slice);
+    RUN_TEST(test_tokenizer_no_token_cap);
+    RUN_TEST(test_tokenizer_streaming_next);
+    RUN_TEST(test_tokenizer_keywords_and_symbols);
+    RUN_TEST(test_tokenizer_scan_modes_agree);
+    RUN_TEST(test_tokenizer_single_char_tokens);
+    RUN_TEST(test_tokenizer_non_ascii_is_not_a_letter);
+    RUN_TEST(test_tokenizer_number_values);
+    RUN_TEST(test_tokenizer_parallel_matches_sequential);
+    RUN_TEST(test_tokenizer_parallel_replay_matches_stream);
+    RUN_TEST(test_tokenizer_offsets_and_line_index);
     
     TEST_SUITE_END();
 }
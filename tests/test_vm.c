@@ -2,10 +2,14 @@
 #include "core/tokenizer.h"
 #include "core/parser/parser.h"
 #include "core/bytecode.h"
+#include "core/peephole.h"
 #include "core/vm.h"
-#include "core/ast.h"
+#include "core/flat_ast.h"
+#include "core/document.h"
+#include "core/optimizer.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static char *capture_output(void (*func)(const Bytecode*), const Bytecode *bc)
 {
@@ -23,21 +27,35 @@ static char *capture_output(void (*func)(const Bytecode*), const Bytecode *bc)
     return buffer;
 }
 
+/**
+ * Decodes the instruction at `index` in the chunk
+ */
+static Instruction instruction_at(const Bytecode *bc, int index)
+{
+    Instruction inst;
+    int pc = 0;
+    for (int i = 0; i <= index; i++)
+        pc = _JechBytecode_Decode(bc, pc, &inst);
+    return inst;
+}
+
 TEST(test_vm_variable_keep_and_say)
 {
     _JechVM_ClearState();
     
     const char *source = "keep x = 42; say(x);";
     JechTokenList tokens = _JechTokenizer_Lex(source);
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
-    Bytecode bc = _JechBytecode_CompileAll(roots, count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
     
     char *output = capture_output(_JechVM_Execute, &bc);
     ASSERT_STR_EQ(output, "42\n", "Should output '42'");
     
     free(output);
-    for (int i = 0; i < count; i++) _JechAST_Free(roots[i]);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_vm_variable_assignment)
@@ -46,15 +64,17 @@ TEST(test_vm_variable_assignment)
     
     const char *source = "keep x = 10; x = 20; say(x);";
     JechTokenList tokens = _JechTokenizer_Lex(source);
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
-    Bytecode bc = _JechBytecode_CompileAll(roots, count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
     
     char *output = capture_output(_JechVM_Execute, &bc);
     ASSERT_STR_EQ(output, "20\n", "Should output '20' after reassignment");
     
     free(output);
-    for (int i = 0; i < count; i++) _JechAST_Free(roots[i]);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_vm_array_creation_and_access)
@@ -63,15 +83,17 @@ TEST(test_vm_array_creation_and_access)
     
     const char *source = "keep arr = [1, 2, 3]; say(arr[0]); say(arr[2]);";
     JechTokenList tokens = _JechTokenizer_Lex(source);
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
-    Bytecode bc = _JechBytecode_CompileAll(roots, count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
     
     char *output = capture_output(_JechVM_Execute, &bc);
     ASSERT_STR_EQ(output, "1\n3\n", "Should output '1' and '3'");
     
     free(output);
-    for (int i = 0; i < count; i++) _JechAST_Free(roots[i]);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_vm_array_with_strings)
@@ -80,15 +102,17 @@ TEST(test_vm_array_with_strings)
     
     const char *source = "keep names = [\"Alice\", \"Bob\"]; say(names[0]);";
     JechTokenList tokens = _JechTokenizer_Lex(source);
-    int count = 0;
-    JechASTNode **roots = _JechParser_ParseAll(&tokens, &count);
-    Bytecode bc = _JechBytecode_CompileAll(roots, count);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
     
     char *output = capture_output(_JechVM_Execute, &bc);
     ASSERT_STR_EQ(output, "Alice\n", "Should output 'Alice'");
     
     free(output);
-    for (int i = 0; i < count; i++) _JechAST_Free(roots[i]);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
 }
 
 TEST(test_vm_clear_state)
@@ -102,6 +126,339 @@ TEST(test_vm_clear_state)
     ASSERT(_JechVM_GetVariable("test") == NULL, "Variable should be cleared");
 }
 
+TEST(test_vm_arithmetic_with_literals)
+{
+    _JechVM_ClearState();
+
+    const char *source = "keep x = 10; x = x + 2.5; say(x); keep y = 3 * 4; say(y); when (y > 11.5) { say(\"big\"); }";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    Instruction add = instruction_at(&bc, 1);
+    ASSERT_EQ(add.token_type, TOKEN_IDENTIFIER, "Left operand should be typed as identifier");
+    ASSERT_EQ(add.cmp_operand_type, TOKEN_NUMBER, "Right operand should be typed as number");
+    ASSERT(add.operand_right_number.as.f == 2.5, "Literal should reach the bytecode decoded");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "12.50\n12.00\nbig\n", "Should compute with decoded literals");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_function_bodies_compile)
+{
+    _JechVM_ClearState();
+
+    // Many bodies, one of them nested
+    char source[2048] = "";
+    char function[64];
+    for (int i = 0; i < 20; i++)
+    {
+        snprintf(function, sizeof(function), "do f%d(x) { say(x); return %d; } ", i, i);
+        strcat(source, function);
+    }
+    strcat(source, "do outer() { do inner() { return 99; } keep v = inner(); say(v); } ");
+    strcat(source, "keep r = f7(1); say(r); outer();");
+
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    for (int i = 0; i < 20; i++)
+    {
+        const Bytecode *body = instruction_at(&bc, i).body_bc;
+        ASSERT(body != NULL && body->count == 3, "Each body should compile to say, return, end");
+        ASSERT_EQ(atoi(instruction_at(body, 1).operand), i, "Each declaration should get its own body");
+    }
+    const Bytecode *outer = instruction_at(&bc, 20).body_bc;
+    ASSERT(instruction_at(outer, 0).body_bc != NULL, "Nested bodies should be compiled too");
+
+    // Compiling the bodies on the pool gives the same chunk
+    Bytecode parallel = _JechBytecode_CompileAllParallel(&ast);
+    ASSERT_EQ(parallel.count, bc.count, "Parallel compile should emit as many instructions");
+    ASSERT(parallel.length == bc.length && memcmp(parallel.code, bc.code, bc.length) == 0,
+           "Parallel compile should emit the same code");
+    for (int i = 0; i < 21; i++)
+    {
+        const Bytecode *body = instruction_at(&parallel, i).body_bc;
+        const Bytecode *expected = instruction_at(&bc, i).body_bc;
+        ASSERT(body != NULL && body->length == expected->length &&
+                   memcmp(body->code, expected->code, body->length) == 0,
+               "Parallel compile should emit the same bodies");
+    }
+    ASSERT(instruction_at(instruction_at(&parallel, 20).body_bc, 0).body_bc != NULL,
+           "Parallel compile should fill in nested bodies");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "1\n7\n99\n", "Every body should run as declared");
+    _JechVM_ClearState();
+    char *parallel_output = capture_output(_JechVM_Execute, &parallel);
+    ASSERT_STR_EQ(parallel_output, output, "Parallel bytecode should run the same");
+
+    free(output);
+    free(parallel_output);
+    _JechBytecode_Free(&parallel);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_compact_bytecode)
+{
+    _JechVM_ClearState();
+
+    const char *source = "keep greeting = \"hi\"; say(greeting); say(greeting); keep n = 2 * 21; say(n);";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    ASSERT_EQ(bc.count, 5, "Should emit 4 instructions and OP_END; say(n) joins the multiplication");
+    ASSERT(_JechBytecode_Size(&bc) < 512, "A small program should take a few hundred bytes");
+    ASSERT_EQ(bc.constant_count, 5, "Repeated strings should share one constant");
+    Instruction mul = instruction_at(&bc, 3);
+    ASSERT_EQ(mul.op, OP_BIN_OP, "Fourth instruction should be the multiplication");
+    ASSERT_STR_EQ(mul.name, "n", "Result should be stored in 'n'");
+    ASSERT_EQ(mul.dest, JECH_TO_SAY, "Result should then be said");
+    ASSERT_EQ((int)mul.operand_right_number.as.i, 21, "Number constants should keep their decoded value");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "hi\nhi\n42.00\n", "Encoded program should run");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_million_instructions)
+{
+    _JechVM_ClearState();
+
+    // keep, then enough increments that the chunk holds 1M instructions;
+    // say(x) joins the last one
+    const int increments = 999999;
+    const char *step = "x = x + 1; ";
+    size_t step_length = strlen(step);
+    char *source = malloc(64 + step_length * increments);
+    char *cursor = source + sprintf(source, "keep x = 0; ");
+    for (int i = 0; i < increments; i++)
+    {
+        memcpy(cursor, step, step_length);
+        cursor += step_length;
+    }
+    strcpy(cursor, "say(x);");
+
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    ASSERT_EQ(bc.count, 1000001, "Should emit 1M instructions and OP_END");
+    ASSERT(bc.capacity >= bc.length, "Code should fit its buffer");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "999999.00\n", "Every instruction should run");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+    free(source);
+}
+
+TEST(test_vm_variable_slots)
+{
+    _JechVM_ClearState();
+
+    // `local` is defined by each call and dropped when it returns
+    const char *source = "keep a = 1; keep b = a; a = b + a; do f(p) { keep local = p; say(local); } "
+                         "f(a); f(b); say(a);";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    ASSERT_EQ(bc.slot_count, 3, "Top level should use one slot per name: a, b and the parameter p");
+    Instruction keep_b = instruction_at(&bc, 1);
+    Instruction add = instruction_at(&bc, 2);
+    ASSERT_EQ(keep_b.operand_slot, instruction_at(&bc, 0).slot, "Reads of 'a' should use the slot 'a' was kept in");
+    ASSERT_EQ(add.slot, add.operand_right_slot, "Both uses of 'a' should share a slot");
+    ASSERT(bc.links != NULL && bc.links[add.slot] == _JechSymbol_Intern("a", 1), "Slots should be linked to VM variables");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "2.00\n1\n2.00\n", "Slot-indexed variables should behave like named ones");
+    ASSERT(_JechVM_GetVariable("local") == NULL, "Function locals should be dropped after the call");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_peephole)
+{
+    _JechVM_ClearState();
+
+    const char *source = "keep a = 3; keep b = 4; say(a * 2 + b); do sq(n) { return n * n; } "
+                         "keep s = sq(b); keep c = 1; c = 5; c = 7; say(c); say(s);";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    // say fused into its expression, keep into the call, `c = 5` dropped
+    ASSERT_EQ(bc.removed, 3, "Top level should lose three instructions");
+    ASSERT_EQ(_JechPeephole_Removed(&bc), 4, "The body's return should be fused as well");
+    Instruction mul = instruction_at(&bc, 2);
+    Instruction add = instruction_at(&bc, 3);
+    ASSERT_EQ(mul.slot, JECH_RESULT_SLOT, "The temporary should go through the result register");
+    ASSERT_EQ(add.operand_slot, JECH_RESULT_SLOT, "The sum should read the result register");
+    ASSERT_EQ(add.dest, JECH_TO_SAY, "The sum should be said directly");
+    ASSERT_EQ(instruction_at(&bc, 5).dest, JECH_TO_KEEP, "The call should keep its own result");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "10.00\n7\n16.00\n", "Rewritten program should behave like the original");
+    ASSERT(_JechVM_GetVariable("__t0") == NULL, "Dead temporaries should never be stored");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_superinstructions)
+{
+    _JechVM_ClearState();
+
+    const char *source = "keep x = 1; x = x + 1; say(x); keep ok = x > 1; when (ok) { say(ok); } "
+                         "when (x * 2 > 3) { say(\"big\"); } else { say(\"small\"); }";
+    JechTokenList tokens = _JechTokenizer_Lex(source);
+    JechFlatAST ast;
+    _JechFlatAST_Init(&ast);
+    _JechParser_ParseAll(&ast, &tokens);
+    Bytecode bc = _JechBytecode_CompileAll(&ast);
+
+    // binop then say, binop then branch twice, one dispatch each
+    ASSERT_EQ(bc.count, 6, "Should emit 5 instructions and OP_END");
+    Instruction add = instruction_at(&bc, 1);
+    Instruction keep_ok = instruction_at(&bc, 2);
+    Instruction compare = instruction_at(&bc, 4);
+    ASSERT(add.dest == JECH_TO_SAY && strcmp(add.name, "x") == 0, "x = x + 1 should store x, then say it");
+    ASSERT(keep_ok.dest == JECH_TO_WHEN && strcmp(keep_ok.name, "ok") == 0, "The comparison kept in 'ok' should branch");
+    ASSERT(compare.dest == JECH_TO_WHEN && compare.name == NULL, "A compared temporary should not be stored");
+    ASSERT(compare.has_else, "The else branch should be carried over");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "2.00\ntrue\nbig\n", "Fused instructions should behave like the pairs they replace");
+    ASSERT_STR_EQ(_JechVM_GetVariable("x"), "2.00", "Stored results should stay visible");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    _JechFlatAST_Free(&ast);
+    _JechTokenizer_Free(&tokens);
+}
+
+TEST(test_vm_document_parts)
+{
+    _JechVM_ClearState();
+
+    // A document keeps one AST per statement; they compile as one program
+    JechDocument doc;
+    ASSERT(_JechDocument_Init(&doc, "keep x = 1 + 1; say(x); when (x > 1) { say(\"big\"); }"), "Document should load");
+    ASSERT(_JechDocument_Edit(&doc, 9, 1, "4", 1), "Edit should apply");
+
+    int count = 0;
+    int failed = 0;
+    JechFlatAST **parts = _JechDocument_Parts(&doc, &count, &failed);
+    ASSERT_EQ(count, 3, "Each statement should be its own part");
+    ASSERT(!failed, "Every statement should parse");
+    for (int i = 0; i < count; i++)
+        _JechOptimizer_Run(parts[i]);
+    Bytecode bc = _JechBytecode_CompileParts(parts, count);
+    ASSERT_EQ(bc.slot_count, 1, "Parts should share the program's slots");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "5.00\nbig\n", "Parts should run in order");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+    free(parts);
+    _JechDocument_Free(&doc);
+}
+
+TEST(test_vm_operands_read_result_register)
+{
+    _JechVM_ClearState();
+
+    // Hand-built: the peephole pass only routes into binary operations,
+    // but a loaded image may name the result register in any operand
+    Bytecode bc;
+    memset(&bc, 0, sizeof(bc));
+    Instruction inst;
+
+    memset(&inst, 0, sizeof(inst));
+    inst.op = OP_BIN_OP;
+    inst.name = JECH_RESULT_REGISTER;
+    inst.bin_op = TOKEN_STAR;
+    inst.operand = "2";
+    inst.token_type = TOKEN_NUMBER;
+    inst.operand_number.as.i = 2;
+    inst.operand_right = "21";
+    inst.cmp_operand_type = TOKEN_NUMBER;
+    inst.operand_right_number.as.i = 21;
+    _JechBytecode_Emit(&bc, &inst);
+
+    memset(&inst, 0, sizeof(inst));
+    inst.op = OP_SAY;
+    inst.operand = JECH_RESULT_REGISTER;
+    inst.token_type = TOKEN_IDENTIFIER;
+    _JechBytecode_Emit(&bc, &inst);
+
+    inst.op = OP_KEEP;
+    inst.name = "k";
+    _JechBytecode_Emit(&bc, &inst);
+
+    inst.op = OP_ASSIGN;
+    _JechBytecode_Emit(&bc, &inst);
+
+    memset(&inst, 0, sizeof(inst));
+    inst.op = OP_WHEN;
+    inst.name = JECH_RESULT_REGISTER;
+    inst.bin_op = TOKEN_EQEQ;
+    inst.operand = "k";
+    inst.cmp_operand_type = TOKEN_IDENTIFIER;
+    inst.operand_right = JECH_RESULT_REGISTER;
+    inst.token_type = TOKEN_IDENTIFIER;
+    _JechBytecode_Emit(&bc, &inst);
+
+    memset(&inst, 0, sizeof(inst));
+    inst.op = OP_END;
+    _JechBytecode_Emit(&bc, &inst);
+    _JechBytecode_Finish(&bc);
+    _JechBytecode_Link(&bc);
+    ASSERT(_JechBytecode_Verify(&bc, 0), "Result register operands should verify");
+
+    char *output = capture_output(_JechVM_Execute, &bc);
+    ASSERT_STR_EQ(output, "42.00\n42.00\n", "Every operand should read the result register");
+    ASSERT_STR_EQ(_JechVM_GetVariable("k"), "42.00", "keep and assign should read the result register");
+
+    free(output);
+    _JechBytecode_Free(&bc);
+}
+
 int run_vm_tests()
 {
     TEST_SUITE_BEGIN("VM Tests");
@@ -111,6 +468,15 @@ int run_vm_tests()
     RUN_TEST(test_vm_array_creation_and_access);
     RUN_TEST(test_vm_array_with_strings);
     RUN_TEST(test_vm_clear_state);
+    RUN_TEST(test_vm_arithmetic_with_literals);
+    RUN_TEST(test_vm_function_bodies_compile);
+    RUN_TEST(test_vm_compact_bytecode);
+    RUN_TEST(test_vm_million_instructions);
+    RUN_TEST(test_vm_variable_slots);
+    RUN_TEST(test_vm_peephole);
+    RUN_TEST(test_vm_superinstructions);
+    RUN_TEST(test_vm_document_parts);
+    RUN_TEST(test_vm_operands_read_result_register);
     
     TEST_SUITE_END();
 }